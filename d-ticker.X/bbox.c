@@ -0,0 +1,201 @@
+#include <xc.h>
+#include "d-ticker.h"
+#include "uart_debug.h"
+
+/*
+ Black box recorder. The last few clock edges, reset edges, restarts, 
+ rollovers and trigs are kept in RAM so that after a problem we can see 
+ exactly what the clock engine did.
+ 
+ Each entry is 2 bytes: the event in the top 3 bits and a 13 bit ms 
+ timestamp, which wraps every 8.192 seconds. The ISR logs into one ring 
+ and the main loop (trigs) into another, so neither needs to disable 
+ interrupts. Trig numbers are not kept, they can be counted from the 
+ last restart or rollover.
+ 
+ bbox_dump() freezes both rings and sends them merged in time order as 
+ event frames (see uart_debug.c), between TRACE_DUMP frames. The ms in 
+ these frames are the 13 bit timestamps. Unless this
+ is a UART_DEBUG build the UART is switched on just for the dump, so it 
+ comes out of the clock output jack and no trigs are output meanwhile. 
+ That is why ui.c only dumps in these builds if the button was held at 
+ power up.
+ */
+
+enum {
+    BBOX_ISR_SIZE = 32,         // entries logged by ISR, must be power of 2
+    BBOX_MAIN_SIZE = 16,        // entries logged by main loop, power of 2
+    BBOX_MS_MASK = 0x1F,        // ms bits in the high byte of an entry
+    BBOX_EVENT_MASK = 0xE0,
+    BBOX_IDLE = 0,              // dump states
+    BBOX_SEND_ENTRIES,
+    BBOX_SEND_END,
+    BBOX_WAIT_UART
+};
+
+typedef struct {
+    byte hi;                    // event | ms bits 8..12
+    byte lo;                    // ms bits 0..7
+} BBOX_ENTRY;
+
+ISR_NEAR volatile byte bbox_frozen;         // stop logging while dumping
+
+// written by ISR only
+ISR_BANK struct {
+    volatile unsigned int ms;   // incremented each ms
+    byte head;
+    byte full;                  // has head been round the whole ring
+} bbox_isr;
+BBOX_ENTRY bbox_isr_ring[BBOX_ISR_SIZE];
+
+// main loop state
+struct {
+    BBOX_ENTRY ring[BBOX_MAIN_SIZE];
+    byte head;
+    byte full;
+    byte dumping;               // BBOX_xxx dump state
+    byte isr_pos;               // next entry of each ring to dump
+    byte isr_end;
+    byte main_pos;
+    byte main_end;
+    unsigned int dump_ms;       // bbox_isr.ms when dump started
+    byte stop_uart;             // switch the UART off after the dump
+} bbox;
+
+////////////////////////////////////////////////////////////////////////////////
+void bbox_init() {
+    bbox_isr.ms = 0;
+    bbox_frozen = 0;
+    bbox_isr.head = 0;
+    bbox_isr.full = 0;
+    bbox.head = 0;
+    bbox.full = 0;
+    bbox.dumping = BBOX_IDLE;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// called every ms by interrupt
+inline void bbox_ms_isr() {
+    ++bbox_isr.ms;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// log an event (BBOX_xxx) from interrupt context
+inline void bbox_log_isr(byte event) {
+    if(!bbox_frozen) {
+        BBOX_ENTRY *entry = &bbox_isr_ring[bbox_isr.head & (BBOX_ISR_SIZE-1)];
+        entry->hi = event | ((byte)(bbox_isr.ms>>8) & BBOX_MS_MASK);
+        entry->lo = (byte)bbox_isr.ms;
+        if(++bbox_isr.head == BBOX_ISR_SIZE) {
+            bbox_isr.full = 1;
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// log an event (BBOX_xxx) from the main loop
+void bbox_log(byte event) {
+    if(!bbox_frozen) {
+        unsigned int ms;
+        do {
+            ms = bbox_isr.ms;
+        } while(ms != bbox_isr.ms);
+        BBOX_ENTRY *entry = &bbox.ring[bbox.head & (BBOX_MAIN_SIZE-1)];
+        entry->hi = event | ((byte)(ms>>8) & BBOX_MS_MASK);
+        entry->lo = (byte)ms;
+        if(++bbox.head == BBOX_MAIN_SIZE) {
+            bbox.full = 1;
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Start dumping the black box. Does nothing if a dump is running
+void bbox_dump() {
+    if(bbox.dumping) {
+        return;
+    }
+    bbox_frozen = 1;
+    bbox.dumping = BBOX_SEND_ENTRIES;
+    bbox.dump_ms = bbox_isr.ms & 0x1FFF;
+    
+    // the ISR no longer writes the ring. Dump all of each ring, or as much 
+    // as has been logged if it has not filled yet
+    bbox.isr_end = bbox_isr.head;
+    bbox.isr_pos = bbox_isr.full ? bbox_isr.head - BBOX_ISR_SIZE : 0;
+    bbox.main_end = bbox.head;
+    bbox.main_pos = bbox.full ? bbox.head - BBOX_MAIN_SIZE : 0;
+    
+#ifdef UART_DEBUG
+    bbox.stop_uart = 0;
+#else
+    uart_init();
+    bbox.stop_uart = 1;
+#endif
+    uart_send_frame(TRACE_DUMP, bbox.dump_ms, 0, 1);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// how many ms before the dump started an entry was logged
+static unsigned int entry_age(BBOX_ENTRY *entry) {
+    unsigned int ms = ((unsigned int)(entry->hi & BBOX_MS_MASK) << 8) | entry->lo;
+    return (bbox.dump_ms - ms) & 0x1FFF;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static byte send_entry(BBOX_ENTRY *entry) {
+    static const byte trace_type[] = { 
+        TRACE_CLOCK, TRACE_RESET, TRACE_RESET, TRACE_RESTART, TRACE_ROLLOVER, 
+        TRACE_TRIG 
+    };
+    byte event = entry->hi & BBOX_EVENT_MASK;
+    return uart_send_frame(trace_type[event >> 5], 
+        ((unsigned int)(entry->hi & BBOX_MS_MASK) << 8) | entry->lo, 0,
+        event == BBOX_RESET_ON);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Called regularly to send the next entries of a dump when there is room 
+// on the UART, oldest first. When all have been sent, wait for the UART
+// to finish then unfreeze
+void bbox_run() {
+    if(bbox.dumping == BBOX_IDLE) {
+        return;
+    }
+    while(bbox.dumping == BBOX_SEND_ENTRIES) {
+        byte has_isr = (bbox.isr_pos != bbox.isr_end);
+        byte has_main = (bbox.main_pos != bbox.main_end);
+        if(!has_isr && !has_main) {
+            bbox.dumping = BBOX_SEND_END;
+            break;
+        }
+        BBOX_ENTRY *isr_entry = &bbox_isr_ring[bbox.isr_pos & (BBOX_ISR_SIZE-1)];
+        BBOX_ENTRY *main_entry = &bbox.ring[bbox.main_pos & (BBOX_MAIN_SIZE-1)];
+        if(has_isr && (!has_main || entry_age(isr_entry) >= entry_age(main_entry))) {
+            if(!send_entry(isr_entry)) {
+                return;
+            }
+            ++bbox.isr_pos;
+        }
+        else {
+            if(!send_entry(main_entry)) {
+                return;
+            }
+            ++bbox.main_pos;
+        }
+    }
+    if(bbox.dumping == BBOX_SEND_END) {
+        if(!uart_send_frame(TRACE_DUMP, bbox.dump_ms, 0, 0)) {
+            return;
+        }
+        bbox.dumping = BBOX_WAIT_UART;
+    }
+    if(bbox.stop_uart) {
+        if(!uart_tx_idle()) {
+            return;
+        }
+        uart_stop();
+    }
+    bbox.dumping = BBOX_IDLE;
+    bbox_frozen = 0;
+}
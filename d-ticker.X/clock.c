@@ -1,34 +1,84 @@
 #include <xc.h>
 #include "d-ticker.h"
+#include "tempo.h"
 
 #define P_CLOCKLED LATAbits.LATA1
 
-const double MAX_TICKS = 65535.0;
 const int LEADING_CLOCK_TIMEOUT_MS = 5;    
 const int MIN_EXT_PERIOD_MS = 10;
 const int MAX_EXT_PERIOD_MS = 3000;
-struct {
-    int bpm;                            // total number of pulses in the pattern
-    double cur_ticks;
-    double ticks_at_next_step;
-    double ticks_per_step;
-    double ticks_per_ms;
+
+// range of the tempo table, MIN_BPM is for index 0
+const int BPM_OPTIONS = 256;            // BPM goes up in steps of 2
+const byte MAX_STEPS_SHIFT = 6;         // 2 to 64 steps per bar
+const byte MAX_BARS_SHIFT = 3;          // 1 to 8 bars
+
+// The clock phase is in ticks which run from 0 to 2^32 over one cycle of 
+// the pattern, wrapping back to 0. Trig positions are the top POS_BITS
+ISR_BANK struct {
+    volatile phase_t cur_ticks;
+    phase_t ticks_at_next_step;
+    volatile phase_t ticks_per_step;
+    volatile phase_t ticks_per_ms;
     unsigned int ms_since_ext_clock;
     unsigned int ms_leading_clock_timeout;
-    byte pending_restart;       // restart at the next clock pulse
-    byte is_external_clock;
-    byte is_rollover;
-    byte is_restart;
 } clk;
 
+/*
+ The clock state is shared with the main loop without disabling interrupts:
+ 
+ - The ISR bumps the generation whenever it changes the position. The main 
+   loop copies the position and retries if the generation changed meanwhile.
+ - Restarts and rollovers are counted by the ISR. The main loop keeps its
+   own copy of each count and sees an event when they differ.
+ - New rate settings are written by the main loop into clk_main and picked 
+   up by the ISR on the next ms tick. pending_rate is cleared while they are
+   being written so the ISR never copies a half written value.
+ - The fields used by both are volatile, so that the compiler reads them 
+   each time round the loops above and keeps the stores in order.
+*/
+ISR_NEAR struct {
+    volatile byte pending_restart;  // restart at the next clock pulse
+    volatile byte is_external_clock;
+    volatile byte pending_rate;     // new rate settings are waiting in clk_main
+    volatile byte generation;       // bumped by ISR when position changes
+    volatile byte restart_count;
+    volatile byte rollover_count;
+} clk_flags;
+
+// state owned by the main loop
+struct {
+    volatile phase_t ticks_per_step;    // new rate settings for the ISR
+    volatile phase_t ticks_per_ms;
+    byte bpm_index;             // index into bpm_phase_per_ms[]
+    byte steps_shift;           // steps per bar is 1 << steps_shift
+    byte bars_shift;            // bars in the pattern is 1 << bars_shift
+    volatile byte select_internal;  // switch to internal clock with new rate
+    byte restart_seen;
+    byte rollover_seen;
+} clk_main;
+
 
 
 
 //////////////////////////////////////////////////////////
-static void recalc() {
-    // calculate the tick increment per ms
-    double ms_per_step = ((60.0 * 1000.0)/clk.bpm);    
-    clk.ticks_per_ms = clk.ticks_per_step / ms_per_step;    
+static void recalc(byte select_internal) {
+    // stop the ISR picking up the settings while they are written. If the 
+    // last settings were not picked up yet, keep their clock selection
+    byte was_pending = clk_flags.pending_rate;
+    clk_flags.pending_rate = 0;
+    if(was_pending) {
+        select_internal |= clk_main.select_internal;
+    }
+    clk_main.select_internal = select_internal;
+    
+    // the pattern is 1 << shift steps long (at least 2). The table is 
+    // built by host/gen_tempo.c so there is no division here
+    byte shift = clk_main.steps_shift + clk_main.bars_shift;
+    clk_main.ticks_per_step = 0x80000000UL >> (shift - 1);
+    clk_main.ticks_per_ms = (bpm_phase_per_ms[clk_main.bpm_index] + 
+        (1UL << (shift - 1))) >> shift;
+    clk_flags.pending_rate = 1;
 }
 
 /*
@@ -55,35 +105,40 @@ static void recalc() {
 //////////////////////////////////////////////////////////
 // called by interrupt when a rising ext clock edge is received 
 inline void clk_ext_pulse_isr() {
+    ++clk_flags.generation;
+    TRACE_EVENT_ISR(TRACE_CLOCK, 0);
+    bbox_log_isr(BBOX_CLOCK);
+    stats_ext_clock_isr();
     
     // currently on internal clock?
-    if(!clk.is_external_clock) {
+    if(!clk_flags.is_external_clock) {
         // select external clock and flag a restart
-        clk.is_external_clock = 1;
-        clk.pending_restart = 1;
+        clk_flags.is_external_clock = 1;
+        clk_flags.pending_restart = 1;
     }
 
     // restart is pending?
-    if(clk.pending_restart) {
-        clk.pending_restart = 0;
-        clk.is_restart = 1;
+    if(clk_flags.pending_restart) {
+        clk_flags.pending_restart = 0;
+        ++clk_flags.restart_count;
+        bbox_log_isr(BBOX_RESTART);
         clk.cur_ticks = 0;
         clk.ticks_at_next_step = clk.ticks_per_step;
     }
     else 
     {
-        // move the "step window" within which the internal clock can run
-        double ticks_at_next_step = clk.ticks_at_next_step + clk.ticks_per_step;
-        if(ticks_at_next_step >= MAX_TICKS) {  
-            clk.is_rollover = 1;
-            clk.cur_ticks = 0.0;
-            clk.ticks_at_next_step = clk.ticks_per_step; // rollover
-            
+        // move the "step window" within which the internal clock can run.
+        // If the new step has wrapped round to the start of the pattern
+        // then roll over
+        if(clk.ticks_at_next_step < clk.ticks_per_step) {
+            ++clk_flags.rollover_count;
+            bbox_log_isr(BBOX_ROLLOVER);
+            clk.cur_ticks = 0;
         }
         else {
             clk.cur_ticks = clk.ticks_at_next_step;
-            clk.ticks_at_next_step = ticks_at_next_step;
         }
+        clk.ticks_at_next_step = clk.cur_ticks + clk.ticks_per_step;
 
         // adjust the automatic tick increment to approximate the step rate
         if(clk.ms_since_ext_clock >= MIN_EXT_PERIOD_MS &&
@@ -100,19 +155,33 @@ inline void clk_ext_pulse_isr() {
 ////////////////////////////////////////////////////////////////////////////////
 // called every ms by interrupt
 inline void clk_ms_isr() {
-    if(!clk.is_external_clock && clk.pending_restart) {
+    ++clk_flags.generation;
+    
+    // pick up new rate settings from the main loop
+    if(clk_flags.pending_rate) {
+        clk.ticks_per_step = clk_main.ticks_per_step;
+        clk.ticks_per_ms = clk_main.ticks_per_ms;
+        if(clk_main.select_internal) {
+            clk_flags.is_external_clock = 0;
+        }
+        clk_flags.pending_rate = 0;
+    }
+    
+    if(!clk_flags.is_external_clock && clk_flags.pending_restart) {
         // perform a pending reset 
-        clk.pending_restart = 0;
-        clk.is_restart = 1;
+        clk_flags.pending_restart = 0;
+        ++clk_flags.restart_count;
+        bbox_log_isr(BBOX_RESTART);
         clk.cur_ticks = 0;
     }
     else 
     {
-        double next_ticks = clk.cur_ticks + clk.ticks_per_ms;
-        if(next_ticks > MAX_TICKS) {
-            next_ticks -= MAX_TICKS;
-        }
-        if(!clk.is_external_clock || next_ticks < clk.ticks_at_next_step) {
+        // the phase wraps round at the end of the pattern. On the external
+        // clock it stops at the end of the step until the next pulse
+        phase_t next_ticks = clk.cur_ticks + clk.ticks_per_ms;
+        phase_t step_start = clk.ticks_at_next_step - clk.ticks_per_step;
+        if(!clk_flags.is_external_clock || 
+            (phase_t)(next_ticks - step_start) < clk.ticks_per_step) {
             clk.cur_ticks = next_ticks;
         }        
     }
@@ -124,65 +193,76 @@ inline void clk_ms_isr() {
 
 //////////////////////////////////////////////////////////
 inline void clk_ext_restart_isr() {
+    ++clk_flags.generation;
     if(clk.ms_leading_clock_timeout) {
-        clk.pending_restart = 0;
-        clk.is_restart = 1;
+        clk_flags.pending_restart = 0;
+        ++clk_flags.restart_count;
+        bbox_log_isr(BBOX_RESTART);
         clk.cur_ticks = 0;
         clk.ticks_at_next_step = clk.ticks_per_step;        
     }
     else {
-        clk.pending_restart = 1;
+        clk_flags.pending_restart = 1;
     }
 }
 
 //////////////////////////////////////////////////////////
 void clk_manual_restart() {
-    clk.pending_restart = 1;    
+    clk_flags.pending_restart = 1;    
 }
 
 //////////////////////////////////////////////////////////
 void clk_init() {    
-    clk.bpm = 120;
-    clk.cur_ticks = 0.0;
-    clk.ticks_per_step = 0.0;
-    clk.ticks_per_ms = 0.0;
-    clk.ticks_at_next_step = 0.0;
-    clk.pending_restart = 0;
-    clk.is_restart = 0;
-    clk.is_rollover = 0;
-    clk.is_external_clock = 0;
+    clk.cur_ticks = 0;
+    clk.ticks_per_step = 0;
+    clk.ticks_per_ms = 0;
+    clk.ticks_at_next_step = 0;
+    clk_flags.pending_restart = 0;
+    clk_flags.pending_rate = 0;
+    clk_flags.restart_count = 0;
+    clk_flags.rollover_count = 0;
+    clk_flags.is_external_clock = 0;
+    clk_main.select_internal = 0;
+    clk_main.restart_seen = 0;
+    clk_main.rollover_seen = 0;
     clk.ms_since_ext_clock = 0;
     clk.ms_leading_clock_timeout = 0;
+    clk_main.bpm_index = (120 - MIN_BPM)>>1;
+    clk_main.bars_shift = 0;
     clk_set_num_steps(16);
 }
 
 //////////////////////////////////////////////////////////
 inline byte clk_is_restart() {
-    di();
-    byte is_restart = clk.is_restart;
-    clk.is_restart = 0;
-    ei();
+    byte restart_count = clk_flags.restart_count;
+    byte is_restart = (restart_count != clk_main.restart_seen);
+    clk_main.restart_seen = restart_count;
     return is_restart;
 }
 //////////////////////////////////////////////////////////
 inline byte clk_is_rollover() {
-    di();
-    byte is_rollover = clk.is_rollover;
-    clk.is_rollover = 0;
-    ei();
+    byte rollover_count = clk_flags.rollover_count;
+    byte is_rollover = (rollover_count != clk_main.rollover_seen);
+    clk_main.rollover_seen = rollover_count;
     return is_rollover;
 }
 //////////////////////////////////////////////////////////
-// return value is 0 .. 65535
-inline unsigned int clk_get_cur_pos() {
-    static unsigned int last_pos;
-     unsigned int pos;
-    if(clk.cur_ticks >= MAX_TICKS) {
-        pos = (unsigned int)MAX_TICKS;
-    }
-    else {
-        pos =  (unsigned int)(0.5+clk.cur_ticks);
-    }
+// take a copy of the position which was not changed by the ISR part way 
+// through reading it
+static phase_t get_cur_ticks() {
+    byte generation;
+    phase_t cur_ticks;
+    do {
+        generation = clk_flags.generation;
+        cur_ticks = clk.cur_ticks;
+    } while(generation != clk_flags.generation);
+    return cur_ticks;
+}
+//////////////////////////////////////////////////////////
+// return value is the position in the pattern, 0 .. (1 << POS_BITS) - 1
+inline pos_t clk_get_cur_pos() {
+    static pos_t last_pos;
+     pos_t pos = (pos_t)(get_cur_ticks() >> (32 - POS_BITS));
      if(pos < last_pos && !pos) {
           leds_set_clock(1, MED_LED_BLINK_MS);         
      }
@@ -191,16 +271,57 @@ inline unsigned int clk_get_cur_pos() {
 }
 //////////////////////////////////////////////////////////
 inline int clk_get_cur_step() {
-    return (int)(0.5 + clk.cur_ticks / clk.ticks_per_step);
+    byte generation;
+    phase_t cur_ticks;
+    phase_t ticks_per_step;
+    do {
+        generation = clk_flags.generation;
+        cur_ticks = clk.cur_ticks;
+        ticks_per_step = clk.ticks_per_step;
+    } while(generation != clk_flags.generation);
+    return (int)((cur_ticks + (ticks_per_step >> 1)) / ticks_per_step);
 }
 //////////////////////////////////////////////////////////
+// the menu only offers powers of 2, anything else is rounded up
 void clk_set_num_steps(int num_steps) {
-    clk.ticks_per_step = MAX_TICKS/num_steps;
-    recalc();
+    byte shift = 1;
+    while(shift < MAX_STEPS_SHIFT && (1<<shift) < num_steps) {
+        ++shift;
+    }
+    clk_main.steps_shift = shift;
+    recalc(0);
 }
 //////////////////////////////////////////////////////////
+// number of bars the pattern runs over, 1, 2, 4 or 8
+void clk_set_num_bars(byte num_bars) {
+    byte shift = 0;
+    while(shift < MAX_BARS_SHIFT && (1<<shift) < num_bars) {
+        ++shift;
+    }
+    clk_main.bars_shift = shift;
+    recalc(0);
+}
+//////////////////////////////////////////////////////////
+// the menu only offers even BPMs from MIN_BPM, odd values are rounded down
 void clk_set_bpm(int bpm) {
-    clk.bpm = bpm;    
-    clk.is_external_clock = 0;
-    recalc();    
+    int index = (bpm - MIN_BPM)>>1;
+    if(index < 0) {
+        index = 0;
+    }
+    else if(index >= BPM_OPTIONS) {
+        index = BPM_OPTIONS-1;
+    }
+    clk_main.bpm_index = (byte)index;
+    recalc(1);    
+}
+//////////////////////////////////////////////////////////
+// current rate of the clock in ticks (phase) per ms
+phase_t clk_get_ticks_per_ms() {
+    byte generation;
+    phase_t ticks_per_ms;
+    do {
+        generation = clk_flags.generation;
+        ticks_per_ms = clk.ticks_per_ms;
+    } while(generation != clk_flags.generation);
+    return ticks_per_ms;
 }
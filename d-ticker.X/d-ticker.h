@@ -1,8 +1,70 @@
 #ifndef D_TICKER_H
 #define	D_TICKER_H
+#include <stdint.h>
 
 typedef unsigned char byte;
+typedef uint32_t phase_t;       // clock phase, wraps round once per pattern
 
+// Placement of data used by the ISR. ISR_NEAR puts the small flags and 
+// counters tested on every ms tick in common RAM, which is mapped into every
+// bank. ISR_BANK keeps the small variables the ISR touches on every tick 
+// together in bank 0, the bank of TMR0, PIR1 and PORTA. Whether this saves
+// the ISR any bank selects depends on the code XC8 generates and has not 
+// been measured; pic_sim in host/ can compare the ISR paths of a build with
+// and without it. Bigger ISR data (rings, histograms, totals) is left for 
+// the linker to place. Needs the compiler's address qualifiers option set 
+// to "request"
+//
+// Both are budgeted, since a request which cannot be met fails the link:
+//
+//  common RAM (16 bytes)   clk_flags 6, g_out 3, sched_tick_count 1,
+//                          bbox_frozen 1, stats_ext_generation 1,
+//                          timing_snap_pending 1 (ISR_TIMING) = 13
+//  bank 0 (80 bytes)       clk 20, pots 14, seq 11, bbox_isr 4,
+//                          stats_tick 5 = 54, leaving room for the 
+//                          compiler's own use of bank 0
+#define ISR_NEAR __near
+#define ISR_BANK __bank(0)
+
+// Define UART_DEBUG in the project's preprocessor macros to send diagnostic
+// reports out of the UART. The UART TX pin is shared with the clock output 
+// so trigs are not output in this build.
+
+// Define LONG_PHASE to resolve trig positions to 24 bits of the pattern 
+// rather than 16, so that patterns can run over several bars and still 
+// place each trig to within 0.1ms at 16 BPM. The trig tables and the saved
+// pattern take half as much space again, so one less pattern is cached
+#ifdef LONG_PHASE
+typedef __uint24 pos_t;
+enum { POS_BITS = 24 };
+#else
+typedef unsigned int pos_t;
+enum { POS_BITS = 16 };
+#endif
+
+// Define ISR_TIMING to measure how long each path through the ISR takes, 
+// in instruction cycles. The results are added to the UART_DEBUG report
+#ifdef ISR_TIMING
+#define TIMING_ISR_ENTER()      timing_isr_enter()
+#define TIMING_PATH_END(src)    timing_path_end(src)
+#define TIMING_ISR_EXIT()       timing_isr_exit()
+#else
+#define TIMING_ISR_ENTER()
+#define TIMING_PATH_END(src)
+#define TIMING_ISR_EXIT()
+#endif
+
+// Define TRACE as well as UART_DEBUG to send timestamped binary event frames
+// out of the UART (see trace.c). Events are logged with these macros, the 
+// _ISR one in interrupt context and the other in the main loop. The host
+// simulator defines its own to log the events
+#ifdef TRACE
+#define TRACE_EVENT_ISR(type, data) trace_event_isr(type, data)
+#define TRACE_EVENT(type, data)     trace_event(type, data)
+#elif !defined(TRACE_EVENT)
+#define TRACE_EVENT_ISR(type, data)
+#define TRACE_EVENT(type, data)
+#endif
 
 
 enum byte {
@@ -12,9 +74,20 @@ enum byte {
     RESET_MODE_RESTART_RUN
 };
 enum {    
+    POTS_COUNT = 4,
     MAX_INPUT_STEPS = 16,
     MAX_OUTPUT_RATE = 4,
-    MAX_TRIGS = (MAX_INPUT_STEPS * MAX_OUTPUT_RATE)
+    MAX_TRIGS = (MAX_INPUT_STEPS * MAX_OUTPUT_RATE),
+    MAX_BARS = 8,
+    MIN_BPM = 16,       // range of the tempo table, see host/gen_tempo.c
+    MAX_BPM = 526,
+    POS_BYTES = POS_BITS / 8
+};
+enum {
+    PAT_CURVE_CLASSIC,
+    PAT_CURVE_TAN,
+    PAT_CURVE_EXP,
+    PAT_CURVE_LINEAR
 };
 enum {
     TINY_LED_BLINK_MS = 1,
@@ -22,6 +95,53 @@ enum {
     MED_LED_BLINK_MS = 30,
     LONG_LED_BLINK_MS = 50
 };
+enum {
+    SEQ_RUN_MS = 1,     // how often each main loop task is run
+    LEDS_RUN_MS = 2,
+    UI_RUN_MS = 5,
+    STORE_RUN_MS = 1
+};
+enum {
+    SCHED_SEQ,          // periodic tasks, in priority order
+    SCHED_LEDS,
+    SCHED_UI,
+    SCHED_STORE,
+    SCHED_NUM_PERIODIC,
+    SCHED_PAT = SCHED_NUM_PERIODIC, // background pattern recalculation
+    SCHED_NUM_TASKS
+};
+enum {
+    ISR_SRC_TIMER,      // sources of interrupts, in the order the ISR checks
+    ISR_SRC_ADC,
+    ISR_SRC_IOC,
+    ISR_SRC_EEPROM,
+    ISR_NUM_SOURCES
+};
+enum {
+    TRACE_CLOCK,        // external clock edge, data unused
+    TRACE_RESET,        // reset input changed, data is new state
+    TRACE_TRIG,         // trig fired, data is trig index
+    TRACE_PATTERN,      // new pattern in use, data is trig count
+    TRACE_DROPS,        // events were dropped, data is how many (max 255)
+    TRACE_RESTART,      // clock restarted
+    TRACE_ROLLOVER,     // external clock rolled over to the start of pattern
+    TRACE_DUMP          // black box dump, data is 1 at start and 0 at end
+};
+enum {
+    BBOX_CLOCK = 0x00,  // black box events (the top 3 bits of an entry)
+    BBOX_RESET_ON = 0x20,
+    BBOX_RESET_OFF = 0x40,
+    BBOX_RESTART = 0x60,
+    BBOX_ROLLOVER = 0x80,
+    BBOX_TRIG = 0xA0
+};
+enum {
+    STATS_BUCKETS = 8,  // histogram buckets
+    STATS_EXT_MIN = 0,  // external clock stats, for stats_get_ext()
+    STATS_EXT_MAX,
+    STATS_EXT_MEAN,
+    STATS_EXT_JITTER    // mean difference between consecutive intervals
+};
 ////////////////////////////////////////////////////////////////////////////////
 inline void clk_ext_pulse_isr(void);
 inline void clk_ms_isr(void);
@@ -29,25 +149,38 @@ void clk_init(void);
 inline void clk_ext_restart_isr();
 void clk_manual_restart();
 inline byte clk_is_restart(void);
-inline unsigned int clk_get_cur_pos(void);
+inline pos_t clk_get_cur_pos(void);
 inline int clk_get_cur_step(void);
 void clk_set_num_steps(int num_pulses);
+void clk_set_num_bars(byte num_bars);
 void clk_set_bpm(int bpm);
+phase_t clk_get_ticks_per_ms(void);
 
 
 
 ////////////////////////////////////////////////////////////////////////////////
 void pat_set_num_trigs(int num_trigs);
+void pat_set_curve(byte curve);
 inline int pat_get_num_trigs(void);
-inline unsigned int pat_get_trig(int pos);
+inline byte pat_get_curve(void);
+inline pos_t pat_get_trig(int pos);
 void pat_init(void);
+void pat_restore(int num_trigs);
+void pat_restore_trig(int pos, pos_t trig);
 void pat_recalc(void);
+void pat_recalc_pots(byte which);
+void pat_run(void);
+inline byte pat_is_busy(void);
+unsigned int pat_get_cache_hits(void);
+unsigned int pat_get_cache_misses(void);
 
 ////////////////////////////////////////////////////////////////////////////////
 void pots_read_isr(void);
 void pots_init(void);
+void pots_wait_scan(void);
+void pots_restore(byte which, byte reading);
 inline byte pots_reading(int which);
-inline int pots_moved(void);
+inline byte pots_moved(void);
 
 ////////////////////////////////////////////////////////////////////////////////
 void leds_init(void);
@@ -55,6 +188,7 @@ inline void leds_run(void);
 inline void leds_set_clock(byte state, byte timeout);
 inline void leds_set_pos(byte which, byte timeout);
 inline void leds_clear_pos(void);
+void leds_set_bar(byte count);
 
 ///////////////////////////////////////////////////////////////////////////////
 void out_init(void);
@@ -73,6 +207,69 @@ void seq_run(void);
 int seq_get_output_trig(void);
 void seq_set_reset_mode(byte reset_mode);
 
+////////////////////////////////////////////////////////////////////////////////
+byte store_init(void);
+void store_run(void);
+void store_write_isr(void);
+void store_set_num_steps(byte num_steps);
+void store_set_num_trigs(byte num_trigs);
+void store_set_reset_mode(byte reset_mode);
+void store_set_curve(byte curve);
+void store_set_num_bars(byte num_bars);
+void store_set_bpm(int bpm);
+void store_pattern_changed(void);
+
+////////////////////////////////////////////////////////////////////////////////
+void sched_init(void);
+inline void sched_ms_isr(void);
+void sched_run(void);
+unsigned int sched_get_overruns(void);
+byte sched_get_max_overrun(void);
+byte sched_get_load_main(void);
+byte sched_get_load_isr(void);
+unsigned int sched_get_max_time(byte which);
+unsigned long sched_get_total_time(byte which);
+
+////////////////////////////////////////////////////////////////////////////////
+unsigned int timing_read_timer(void);
+void timing_init(void);
+inline void timing_isr_enter(void);
+inline void timing_path_end(byte source);
+inline void timing_isr_exit(void);
+void timing_request_snapshot(void);
+byte timing_snapshot_ready(void);
+unsigned int timing_get_max(byte source);
+unsigned int timing_get_average(byte source);
+unsigned int timing_get_overruns(void);
+
+////////////////////////////////////////////////////////////////////////////////
+void stats_init(void);
+void stats_reset(void);
+inline void stats_ms_isr(void);
+inline void stats_ext_clock_isr(void);
+void stats_trig_late(pos_t late_pos);
+unsigned int stats_get_late_hist(byte bucket);
+byte stats_get_late_min(void);
+byte stats_get_late_max(void);
+byte stats_get_late_mean(void);
+unsigned int stats_get_jitter_hist(byte bucket);
+unsigned long stats_get_ext(byte which);
+
+////////////////////////////////////////////////////////////////////////////////
+void bbox_init(void);
+inline void bbox_ms_isr(void);
+inline void bbox_log_isr(byte event);
+void bbox_log(byte event);
+void bbox_dump(void);
+void bbox_run(void);
+
+////////////////////////////////////////////////////////////////////////////////
+void trace_init(void);
+inline void trace_ms_isr(void);
+inline void trace_event_isr(byte type, byte data);
+void trace_event(byte type, byte data);
+void trace_run(void);
+
 
 #endif	/* D_TICKER_H */
 
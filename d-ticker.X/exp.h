@@ -0,0 +1,130 @@
+const byte exp_table[128] = {
+0, 
+0, 
+0, 
+0, 
+1, 
+1, 
+1, 
+1, 
+1, 
+1, 
+2, 
+2, 
+2, 
+2, 
+2, 
+3, 
+3, 
+3, 
+3, 
+3, 
+4, 
+4, 
+4, 
+5, 
+5, 
+5, 
+5, 
+6, 
+6, 
+6, 
+7, 
+7, 
+7, 
+8, 
+8, 
+9, 
+9, 
+10, 
+10, 
+10, 
+11, 
+11, 
+12, 
+13, 
+13, 
+14, 
+14, 
+15, 
+15, 
+16, 
+17, 
+17, 
+18, 
+19, 
+20, 
+20, 
+21, 
+22, 
+23, 
+24, 
+25, 
+26, 
+27, 
+28, 
+29, 
+30, 
+31, 
+32, 
+33, 
+35, 
+36, 
+37, 
+39, 
+40, 
+42, 
+43, 
+45, 
+46, 
+48, 
+50, 
+52, 
+53, 
+55, 
+57, 
+59, 
+61, 
+64, 
+66, 
+68, 
+71, 
+73, 
+76, 
+78, 
+81, 
+84, 
+87, 
+90, 
+93, 
+96, 
+100, 
+103, 
+107, 
+110, 
+114, 
+118, 
+122, 
+126, 
+131, 
+135, 
+140, 
+144, 
+149, 
+154, 
+160, 
+165, 
+171, 
+177, 
+183, 
+189, 
+195, 
+202, 
+209, 
+216, 
+223, 
+231, 
+239, 
+247, 
+255, 
+};
\ No newline at end of file
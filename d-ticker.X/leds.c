@@ -14,6 +14,8 @@
 struct {
     volatile int clock_timeout;
     volatile int pos_timeout;
+    byte bar;                   // LEDs lit as a bar graph (0 = normal use)
+    byte bar_scan;              // LED of the bar lit at the moment
 } leds;
 
 /////////////////////////////////////////////////////////////////////////////
@@ -59,18 +61,41 @@ static void set_pos_leds(int i) {
 void leds_init() {
     leds.clock_timeout = 0;
     leds.pos_timeout = 0;
+    leds.bar = 0;
+    leds.bar_scan = 0;
  	T_LED1 = 1;
 	T_LED2 = 1;
 	T_LEDCOM = 1;
 }
 /////////////////////////////////////////////////////////////////////////////
+// called every LEDS_RUN_MS
 inline void leds_run() {
-    if(leds.pos_timeout && !--leds.pos_timeout) {
-         set_pos_leds(-1);
-     }
-     if(leds.clock_timeout && !--leds.clock_timeout) {
-         P_CLOCKLED = 0;
-     }    
+    if(leds.bar) {
+        // only one LED can be lit at a time, so light each LED of the bar 
+        // in turn
+        if(++leds.bar_scan >= leds.bar) {
+            leds.bar_scan = 0;
+        }
+        set_pos_leds(leds.bar_scan);
+    }
+    else if(leds.pos_timeout) {
+        if(leds.pos_timeout <= LEDS_RUN_MS) {
+            leds.pos_timeout = 0;
+            set_pos_leds(-1);
+        }
+        else {
+            leds.pos_timeout -= LEDS_RUN_MS;
+        }
+    }
+    if(leds.clock_timeout) {
+        if(leds.clock_timeout <= LEDS_RUN_MS) {
+            leds.clock_timeout = 0;
+            P_CLOCKLED = 0;
+        }
+        else {
+            leds.clock_timeout -= LEDS_RUN_MS;
+        }
+    }
 }
 /////////////////////////////////////////////////////////////////////////////
 inline void leds_set_clock(byte state, byte timeout) {
@@ -90,6 +115,19 @@ inline void leds_clear_pos() {
 }
 /////////////////////////////////////////////////////////////////////////////
 inline void leds_set_pos(byte which, byte timeout) {
+    if(leds.bar) {
+        return;
+    }
     set_pos_leds(which);
     leds.pos_timeout = timeout;
-}
\ No newline at end of file
+}
+/////////////////////////////////////////////////////////////////////////////
+// Show a bar graph of 0 to 4 LEDs in place of the position. The position 
+// LEDs are left off when the bar is set back to 0
+void leds_set_bar(byte count) {
+    leds.bar = count;
+    if(!count) {
+        set_pos_leds(-1);
+        leds.pos_timeout = 0;
+    }
+}
@@ -28,6 +28,7 @@
 
 #include <xc.h>
 #include "d-ticker.h"
+#include "uart_debug.h"
 
 /*
 1  VDD
@@ -63,20 +64,27 @@ RC2	POT1	AN6
 #define P_EXTRESET PORTAbits.RA4
 #define TIMER_0_INIT_SCALAR		5		// Timer 0 initialiser to overlow at 1ms intervals
 
-volatile byte ms_tick;
 ////////////////////////////////////////////////////////////
 void __interrupt() ISR()
 {
+    TIMING_ISR_ENTER();
+    
 	// timer 0 rollover ISR. Maintains the count of 
 	// "system ticks" that we use for key debounce etc
     
 	if(INTCONbits.T0IF)
 	{
 		TMR0 = TIMER_0_INIT_SCALAR;
-        ms_tick = 1;
+        sched_ms_isr();
         out_ms_isr();
         clk_ms_isr();
+        stats_ms_isr();
+        bbox_ms_isr();
+#ifdef TRACE
+        trace_ms_isr();
+#endif
         INTCONbits.T0IF = 0;
+        TIMING_PATH_END(ISR_SRC_TIMER);
 	}
 	
     ////////////////////////////////////////////////////////
@@ -84,6 +92,7 @@ void __interrupt() ISR()
     if(PIR1bits.ADIF) {
         pots_read_isr();
 		PIR1bits.ADIF = 0;
+        TIMING_PATH_END(ISR_SRC_ADC);
 	}
     
     ////////////////////////////////////////////////////////
@@ -98,8 +107,24 @@ void __interrupt() ISR()
             IOCAF_EXTRESET = 0;
         }
         INTCONbits.IOCIF = 0;
+        TIMING_PATH_END(ISR_SRC_IOC);
+    }
+    
+    ////////////////////////////////////////////////////////
+    // data EEPROM write complete
+    if(PIR2bits.EEIF) {
+        store_write_isr();
+        PIR2bits.EEIF = 0;
+        TIMING_PATH_END(ISR_SRC_EEPROM);
+    }
+
+    ////////////////////////////////////////////////////////
+    // UART ready for the next byte (debug output or black box dump)
+    if(PIE1bits.TXIE && PIR1bits.TXIF) {
+        uart_tx_isr();
     }
 
+    TIMING_ISR_EXIT();
 }
 
 ////////////////////////////////////////////////////////////
@@ -133,12 +158,14 @@ void main()
     OPTION_REGbits.PS = 0b011;  // 1/16 prescaler
     OPTION_REGbits.nWPUEN = 0;
     
-    ms_tick = 0;
     INTCONbits.T0IE = 1;    // enabled timer 0 interrrupt
     INTCONbits.T0IF = 0;    // clear interrupt fired flag
 
     PIR1bits.ADIF = 0;
     PIE1bits.ADIE = 1; // enable the ADC interrupt
+    
+    PIR2bits.EEIF = 0;
+    PIE2bits.EEIE = 1; // enable the EEPROM write complete interrupt
 
     // interrupt on change
     IOCAN = IOCAN_BITS;
@@ -146,24 +173,36 @@ void main()
     INTCONbits.IOCIF = 0;
     INTCONbits.IOCIE = 1;
 	
+    stats_init();
+    bbox_init();
+#ifdef ISR_TIMING
+    timing_init();
+#endif
+#ifdef TRACE
+    trace_init();
+#endif
     INTCONbits.GIE = 1;
     INTCONbits.PEIE = 1;
 
     out_init();
     leds_init();
     clk_init();
-    pots_init();   
     ui_init();
     pat_init();
     seq_init();
+    // restore saved settings and pattern. Any pots moved while powered off
+    // will be seen on the first scan and cause a recalc
+    byte restored = store_init();
+    pots_init();
+    if(!restored) {
+        // nothing saved, wait for the pots and calculate the pattern
+        pots_wait_scan();
+        pat_recalc();
+    }
+    sched_init();
  
     for(;;) {
-        if(ms_tick) {
-            ms_tick = 0;
-            leds_run();
-            ui_run();
-            seq_run();
-        }
+        sched_run();
     }
     
 }
\ No newline at end of file
@@ -6,8 +6,11 @@ enum {
     OUTPUT_PULSE_MS = 10,
     OUTPUT_PULSE_LOW_MS = 5
 };
-struct {
-    volatile byte pending;
+// The main loop only writes requested and the ISR only writes started, so 
+// trigs can be queued without disabling interrupts
+ISR_NEAR struct {
+    volatile byte requested;    // trigs requested by the main loop
+    volatile byte started;      // trigs started by the ISR
     volatile byte timeout;    
 } g_out;
 
@@ -18,7 +21,8 @@ static void start_trig() {
 
 ///////////////////////////////////////////////////////////////////////////////
 void out_init() {
-    g_out.pending = 0;
+    g_out.requested = 0;
+    g_out.started = 0;
     g_out.timeout = 0;
 };
 ///////////////////////////////////////////////////////////////////////////////
@@ -30,19 +34,19 @@ inline void out_ms_isr() {
             P_CLOCKOUT = 0;
         }
     }
-    else if(g_out.pending) {
+    else if(g_out.requested != g_out.started) {
         start_trig();
-        --g_out.pending;
+        ++g_out.started;
     }
 }
 ///////////////////////////////////////////////////////////////////////////////
 void out_trig() {    
-    di();
-    if(g_out.timeout) {
-        ++g_out.pending;
+    // the ISR only changes the output when a pulse is running or a trig is
+    // queued, so if neither is true it is safe to start the pulse here
+    if(g_out.timeout || g_out.requested != g_out.started) {
+        ++g_out.requested;
     }
     else {
         start_trig();
     }
-    ei();    
 }
@@ -1,64 +1,445 @@
 #include <xc.h>
 #include "d-ticker.h"
+#include "tan.h"
+#include "exp.h"
 
+enum {
+    PAT_SLICE_TRIGS = 4,    // trigs calculated per call to pat_run()
+#ifdef LONG_PHASE
+    PAT_TABLES = 2,         // active table and table being built
+#else
+    PAT_TABLES = 3,         // active table, table being built, one spare
+#endif
+    PAT_KEY_SIZE = POTS_COUNT + 2,
+    PAT_KEY_TRIGS = POTS_COUNT,     // index of trig count in key
+    PAT_KEY_CURVE,                  // index of curve in key
+    PAT_KEY_SHIFT = 3,      // pot readings are quantised to 5 bits for keys
+    PAT_CURVE_BASE = 16384  // average velocity for the curve engine
+};
+
+/*
+ Curve engine. The classic curve uses the pot reading directly as the 
+ velocity change per trig, and normalises the result with a division per
+ trig. The other curves map each pot through a table (tan, exponential or
+ linear) to get the velocity change across its whole segment. The average
+ velocity is then made PAT_CURVE_BASE, so the distance over the pattern is
+ always num_trigs * PAT_CURVE_BASE. When num_trigs is a power of two, 
+ normalising the distances is just a shift. Other trig counts fall back to
+ the classic normalisation.
+ 
+ Velocities are in 1/16 units. Each segment's velocity change is at most 
+ 255 * 16, so over the pattern the velocity varies by at most 16320 and 
+ always stays positive.
+*/
+
+/*
+ The trig tables are also used as a cache of recently calculated patterns.
+ Each table is tagged with a key made of the quantised pot readings and 
+ the trig count it was calculated for. If the pots are returned to a 
+ setting that is still in a table, that table is made active straight away
+ rather than being recalculated. The segments are worked out from the full
+ readings, which are kept with each table. If they differ from the readings
+ now, the cached table is only used until the exact one has been built, 
+ which then replaces it. Tables are reused in least recently used order. A
+ table's key is cleared (trig count 0) while it is being built.
+*/
 struct {
-    unsigned int trig[MAX_TRIGS];
+    pos_t trig[PAT_TABLES][MAX_TRIGS];
+    byte key[PAT_TABLES][PAT_KEY_SIZE];
+    byte last_used[PAT_TABLES];         // use_count when table was last active
+    byte use_count;
+    byte cur_table;                     // index of the active table
+    byte build_table;                   // index of table being built
+    byte build_key[PAT_KEY_SIZE];       // key of table being built
+    byte readings[PAT_TABLES][POTS_COUNT];  // pot readings of each table
+    byte seg_reading[POTS_COUNT];       // pot reading of each segment
+    unsigned int cache_hits;
+    unsigned int cache_misses;
     int num_trigs;
-    int tt[MAX_TRIGS];
+    int seg_first[POTS_COUNT+1];        // first trig in the segment for each pot
+    int seg_acc[POTS_COUNT];            // velocity change set by each pot
+    int seg_step[POTS_COUNT];           // velocity change per trig in segment
+    byte curve;                         // PAT_CURVE_xxx
+    byte trigs_shift;                   // log2(num_trigs), 0 if not a power of 2
+    byte build_curve;                   // is table being built by curve engine?
+    byte build_busy;                    // is a table being built?
+    byte build_seg;                     // segment being built
+    int build_trig;                     // next trig to build
+    int build_rate;                     // current velocity
+    long build_pos;                     // distance to the next trig
+    long build_dist;                    // total distance over the pattern
 } pat;
 
 /////////////////////////////////////////////////////////////////////////////
-void pat_set_num_trigs(int num_trigs) {
-    pat.num_trigs = num_trigs;
+// Each pot controls the acceleration over one quarter of the pattern
+static void calc_segment(byte which) {
+    byte reading = pots_reading(which);
+    pat.seg_reading[which] = reading;
+    if(pat.curve == PAT_CURVE_CLASSIC) {
+        pat.seg_acc[which] = 128-reading;
+        return;
+    }
+    
+    // pot above centre speeds up the trigs (reduces the velocity, which is 
+    // the distance between trigs)
+    byte index = (reading > 127) ? reading - 128 : 127 - reading;
+    int slope;
+    switch(pat.curve) {
+        case PAT_CURVE_TAN:
+            slope = tan_table[index];
+            break;
+        case PAT_CURVE_EXP:
+            slope = exp_table[index];
+            break;
+        default:
+            slope = 2*index;
+            break;
+    }
+    pat.seg_acc[which] = (reading > 127) ? -slope : slope;
 }
+
 /////////////////////////////////////////////////////////////////////////////
-inline int pat_get_num_trigs() {
-    return pat.num_trigs;
+// Get ready to build the trig table with the curve engine. Uses only shifts
+// and adds since the trigs per segment is a power of two
+static void start_curve_build() {
+    byte seg_shift = pat.trigs_shift - 2;   // log2 of trigs per segment
+    
+    // spread each segment's velocity change (in 1/16 units) over its trigs
+    for(byte i=0; i<POTS_COUNT; ++i) {
+        pat.seg_step[i] = pat.seg_acc[i] << (4 - seg_shift);
+    }
+    
+    // sum of the velocities over the pattern, relative to the start 
+    // velocity. Over a segment of len trigs starting at velocity v this is
+    // len*v + step*len*(len-1)/2
+    long sum = 0;
+    int rate = 0;
+    for(byte i=0; i<POTS_COUNT; ++i) {
+        int step = pat.seg_step[i];
+        sum += (long)rate << seg_shift;
+        if(seg_shift) {
+            sum += (((long)step << seg_shift) - step) << (seg_shift - 1);
+        }
+        rate += step << seg_shift;
+    }
+    
+    // start at the velocity which makes the average PAT_CURVE_BASE
+    pat.build_rate = PAT_CURVE_BASE - (int)(sum >> pat.trigs_shift);
+    pat.build_curve = 1;
 }
+
 /////////////////////////////////////////////////////////////////////////////
-inline unsigned int pat_get_trig(int pos) {
-    return pat.trig[pos];
+// The key of the segments as they were last calculated
+static void make_key(byte *key) {
+    for(byte i=0; i<POTS_COUNT; ++i) {
+        key[i] = pat.seg_reading[i] >> PAT_KEY_SHIFT;
+    }
+    key[PAT_KEY_TRIGS] = (byte)pat.num_trigs;
+    key[PAT_KEY_CURVE] = pat.curve;
 }
+
 /////////////////////////////////////////////////////////////////////////////
-void pat_init() {
-    for(int i=0; i<MAX_TRIGS; ++i) {
-        pat.trig[i] = 0;
+static void use_table(byte table) {
+    pat.cur_table = table;
+    pat.last_used[table] = ++pat.use_count;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Was the table calculated from the segments' readings exactly?
+static byte is_exact(byte table) {
+    for(byte i=0; i<POTS_COUNT; ++i) {
+        if(pat.readings[table][i] != pat.seg_reading[i]) {
+            return 0;
+        }
     }
-    pat.num_trigs = 16;
-    pat_recalc();
+    return 1;
 }
 
 /////////////////////////////////////////////////////////////////////////////
-// Recalculate the tempo map
+// Look for a table which was built with the same key. Returns PAT_TABLES
+// if there is none
+static byte find_table(byte *key) {
+    for(byte i=0; i<PAT_TABLES; ++i) {
+        byte j;
+        for(j=0; j<PAT_KEY_SIZE; ++j) {
+            if(pat.key[i][j] != key[j]) {
+                break;
+            }
+        }
+        if(j == PAT_KEY_SIZE) {
+            return i;
+        }
+    }
+    return PAT_TABLES;
+}
+
 /////////////////////////////////////////////////////////////////////////////
-void pat_recalc() {
+// Stitch the segments together and get ready to build the trig table
+static void start_build() {
     
-    // expand out the velocity(tempo) changes (defined by the pots) into a 
-    // list of velocity values at each output trigger position    
+    // build into the least recently used table other than the active one
+    byte oldest = 0;
+    for(byte i=0; i<PAT_TABLES; ++i) {
+        if(i != pat.cur_table) {
+            pat.build_table = i;
+            break;
+        }
+    }
+    for(byte i=0; i<PAT_TABLES; ++i) {
+        byte age = pat.use_count - pat.last_used[i];
+        if(i != pat.cur_table && (!pat.key[i][PAT_KEY_TRIGS] || age > oldest)) {
+            pat.build_table = i;
+            if(!pat.key[i][PAT_KEY_TRIGS]) {
+                break;
+            }
+            oldest = age;
+        }
+    }
+    pat.key[pat.build_table][PAT_KEY_TRIGS] = 0;
+    make_key(pat.build_key);
+    for(byte i=0; i<POTS_COUNT; ++i) {
+        pat.readings[pat.build_table][i] = pat.seg_reading[i];
+    }
+    pat.build_pos = 0;
+    pat.build_seg = 0;
+    pat.build_trig = 0;
+    pat.build_busy = 1;
+    
+    if(pat.curve != PAT_CURVE_CLASSIC && pat.trigs_shift >= 2) {
+        start_curve_build();
+        return;
+    }
+    pat.build_curve = 0;
+    for(byte i=0; i<POTS_COUNT; ++i) {
+        pat.seg_step[i] = pat.seg_acc[i];
+    }
+    
+    // velocity is linear within each segment so the lowest velocity is 
+    // always at a segment boundary
     int cur_rate = 128;
     int min_rate = 128;
-    for(int i=0; i<pat.num_trigs; ++i) {
-        pat.tt[i] = cur_rate;        
-        int acc = 128-pots_reading((i*4)/pat.num_trigs);
-        cur_rate += acc;
+    for(byte i=0; i<POTS_COUNT; ++i) {
+        cur_rate += pat.seg_acc[i] * (pat.seg_first[i+1] - pat.seg_first[i]);
         if(cur_rate < min_rate) {
             min_rate = cur_rate;
-        }        
+        }
     }
     
-    // normalise the velocities so that they are all positive and 
-    // expand out the "distance into sequence" by integrating velocity
-    int dist = 0;
-    for(int i=0; i<pat.num_trigs; ++i) {
-        int norm_rate = pat.tt[i] - min_rate + 128;
-        pat.tt[i] = dist;
-        dist = dist + norm_rate;
+    // total distance covered by the normalised (all positive) velocities. 
+    // Since the acceleration is constant within a segment this can be 
+    // worked out in closed form rather than stepping through each trig
+    long dist = 0;
+    cur_rate = 128 - min_rate + 128;
+    for(byte i=0; i<POTS_COUNT; ++i) {
+        int len = pat.seg_first[i+1] - pat.seg_first[i];
+        dist += (long)len * cur_rate + (long)pat.seg_acc[i] * ((len * (len-1))/2);
+        cur_rate += pat.seg_acc[i] * len;
     }
     
-    // now normalise the distances so that they run from 0 - 65535
-    for(int i=0; i<pat.num_trigs; ++i) {
-        pat.trig[i] = (unsigned int)(((long)65535 * pat.tt[i]) / dist);
+    pat.build_dist = dist;
+    pat.build_rate = 128 - min_rate + 128;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Scale a distance into the pattern to a trig position. pos is less than 
+// dist, which must also be less than 2^23 so that pos << 8 fits in a long
+static pos_t scale_pos(long pos, long dist) {
+#ifdef LONG_PHASE
+    // long division a byte at a time, since pos << 24 needs more than 32 bits
+    pos_t result = 0;
+    for(byte i=0; i<POS_BYTES; ++i) {
+        pos <<= 8;
+        result = (result << 8) | (byte)(pos / dist);
+        pos %= dist;
+    }
+    return result;
+#else
+    // 65535 * pos may not fit in a long, so divide pos << 16 a byte at a 
+    // time and take one off when the remainder shows 65535 * pos falls short
+    pos_t result = 0;
+    long rem = pos;
+    for(byte i=0; i<2; ++i) {
+        rem <<= 8;
+        result = (result << 8) | (byte)(rem / dist);
+        rem %= dist;
+    }
+    if(rem < pos) {
+        --result;
+    }
+    return result;
+#endif
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Integrate velocity to get the distance to the next few trigs and normalise 
+// the distances to trig positions over the whole pattern. The new table 
+// becomes active once it is complete
+static void continue_build(int count) {
+    pos_t *table = pat.trig[pat.build_table];
+    while(count-- && pat.build_trig < pat.num_trigs) {
+        while(pat.build_trig >= pat.seg_first[pat.build_seg+1]) {
+            ++pat.build_seg;
+        }
+        if(pat.build_curve) {
+            // distance over the pattern is num_trigs * PAT_CURVE_BASE
+            table[pat.build_trig] = (pos_t)((pat.build_pos << (POS_BITS - 16)) >> 
+                (pat.trigs_shift - 2));
+        }
+        else {
+            table[pat.build_trig] = scale_pos(pat.build_pos, pat.build_dist);
+        }
+        pat.build_pos += pat.build_rate;
+        pat.build_rate += pat.seg_step[pat.build_seg];
+        ++pat.build_trig;
     }
+    if(pat.build_trig >= pat.num_trigs) {
+        // a table with the same key is from other readings, so drop it
+        byte table = find_table(pat.build_key);
+        if(table < PAT_TABLES) {
+            pat.key[table][PAT_KEY_TRIGS] = 0;
+        }
+        for(byte i=0; i<PAT_KEY_SIZE; ++i) {
+            pat.key[pat.build_table][i] = pat.build_key[i];
+        }
+        use_table(pat.build_table);
+        pat.build_busy = 0;
+        store_pattern_changed();
+        TRACE_EVENT(TRACE_PATTERN, (byte)pat.num_trigs);
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+void pat_set_num_trigs(int num_trigs) {
+    pat.num_trigs = num_trigs;
+    for(byte i=0; i<=POTS_COUNT; ++i) {
+        // first trig for which (trig*POTS_COUNT)/num_trigs == i
+        pat.seg_first[i] = (i*num_trigs + POTS_COUNT - 1)/POTS_COUNT;
+    }
+    pat.trigs_shift = 0;
+    for(byte i=0; i<=6; ++i) {
+        if(num_trigs == (1<<i)) {
+            pat.trigs_shift = i;
+        }
+    }
+}
+/////////////////////////////////////////////////////////////////////////////
+// Select the curve used to map pot readings to changes in velocity. Like 
+// the trig count, it is used from the next recalculation
+void pat_set_curve(byte curve) {
+    pat.curve = curve;
+}
+/////////////////////////////////////////////////////////////////////////////
+inline int pat_get_num_trigs() {
+    return pat.num_trigs;
+}
+/////////////////////////////////////////////////////////////////////////////
+inline byte pat_get_curve() {
+    return pat.curve;
+}
+/////////////////////////////////////////////////////////////////////////////
+inline pos_t pat_get_trig(int pos) {
+    return pat.trig[pat.cur_table][pos];
+}
+/////////////////////////////////////////////////////////////////////////////
+void pat_init() {
+    for(byte t=0; t<PAT_TABLES; ++t) {
+        for(int i=0; i<MAX_TRIGS; ++i) {
+            pat.trig[t][i] = 0;
+        }
+        pat.key[t][PAT_KEY_TRIGS] = 0;
+        pat.last_used[t] = 0;
+    }
+    pat.use_count = 0;
+    pat.cur_table = 0;
+    pat.build_busy = 0;
+    pat.cache_hits = 0;
+    pat.cache_misses = 0;
+    pat.curve = PAT_CURVE_CLASSIC;
+    pat_set_num_trigs(16);
+}
+/////////////////////////////////////////////////////////////////////////////
+// Get ready to load a saved trig table. The pots must already hold the 
+// readings the table was calculated from
+void pat_restore(int num_trigs) {
+    pat_set_num_trigs(num_trigs);
+    for(byte i=0; i<POTS_COUNT; ++i) {
+        calc_segment(i);
+    }
+    make_key(pat.key[pat.cur_table]);
+    for(byte i=0; i<POTS_COUNT; ++i) {
+        pat.readings[pat.cur_table][i] = pat.seg_reading[i];
+    }
+    use_table(pat.cur_table);
+}
+/////////////////////////////////////////////////////////////////////////////
+void pat_restore_trig(int pos, pos_t trig) {
+    pat.trig[pat.cur_table][pos] = trig;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Recalculate the tempo map immediately
+/////////////////////////////////////////////////////////////////////////////
+void pat_recalc() {
+    for(byte i=0; i<POTS_COUNT; ++i) {
+        calc_segment(i);
+    }
+    start_build();
+    continue_build(MAX_TRIGS);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Start recalculating the tempo map after a change to the pots in the bit 
+// mask which. Only the segments belonging to those pots are recalculated 
+// here. If the new settings are in the cache the cached table is used. 
+// Otherwise, or if the cached table is from other readings with the same 
+// key, the trig table is rebuilt a slice at a time by pat_run()
+/////////////////////////////////////////////////////////////////////////////
+void pat_recalc_pots(byte which) {
+    for(byte i=0; i<POTS_COUNT; ++i) {
+        if(which & (1<<i)) {
+            calc_segment(i);
+        }
+    }
+    byte key[PAT_KEY_SIZE];
+    make_key(key);
+    byte table = find_table(key);
+    if(table < PAT_TABLES) {
+        ++pat.cache_hits;
+        pat.build_busy = 0;
+        if(table != pat.cur_table) {
+            use_table(table);
+            store_pattern_changed();
+            TRACE_EVENT(TRACE_PATTERN, (byte)pat.num_trigs);
+        }
+        if(!is_exact(table)) {
+            start_build();
+        }
+    }
+    else {
+        ++pat.cache_misses;
+        start_build();
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Background task. Builds the next slice of the trig table
+/////////////////////////////////////////////////////////////////////////////
+void pat_run() {
+    if(pat.build_busy) {
+        continue_build(PAT_SLICE_TRIGS);
+    }
+}
+/////////////////////////////////////////////////////////////////////////////
+inline byte pat_is_busy() {
+    return pat.build_busy;
+}
+/////////////////////////////////////////////////////////////////////////////
+unsigned int pat_get_cache_hits() {
+    return pat.cache_hits;
+}
+/////////////////////////////////////////////////////////////////////////////
+unsigned int pat_get_cache_misses() {
+    return pat.cache_misses;
 }
 
 /////////////////////////////////////////////////////////////////////////////
@@ -69,6 +450,6 @@ void xpat_recalc() {
     
     // now normalise the distances so that they run from 0 - 65535
     for(int i=0; i<pat.num_trigs; ++i) {
-        pat.trig[i] = (unsigned int)((65535.0 *i)/pat.num_trigs);
+        pat.trig[pat.cur_table][i] = (pos_t)((65535.0 *i)/pat.num_trigs);
     }
 }
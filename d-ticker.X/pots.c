@@ -7,14 +7,14 @@
 #define ADCON0_POT1	0b00011001
 
 enum {
-    POTS_COUNT = 4,
     POTS_MOVE_TOLERANCE = 3,
 };
-struct {
+ISR_BANK struct {
     volatile byte reading[POTS_COUNT];
     volatile byte cur_pot;
     volatile byte scan_complete;
-    volatile int last_moved;
+    volatile byte move_count[POTS_COUNT];   // incremented by ISR when pot moves
+    byte move_seen[POTS_COUNT];             // move_count last seen by main loop
 } pots;
 
 
@@ -42,7 +42,7 @@ static void read_next() {
 void pots_read_isr() {
     byte reading = ADRESH;
     if(abs(reading - pots.reading[pots.cur_pot]) >= POTS_MOVE_TOLERANCE) {
-        pots.last_moved = pots.cur_pot;
+        ++pots.move_count[pots.cur_pot];
         pots.reading[pots.cur_pot] = reading;            
     }
     if(++pots.cur_pot >= POTS_COUNT) {
@@ -56,18 +56,39 @@ void pots_init() {
     pots.cur_pot = 0;
     pots.scan_complete = 0;
     
+    for(byte i=0; i<POTS_COUNT; ++i) {
+        pots.move_seen[i] = pots.move_count[i];
+    }
     read_next();
-    while(!pots.scan_complete); // wait for first read of pots
-    
-    pots.last_moved = -1;
+}
+////////////////////////////////////////////////////////////////////////////////
+// wait for first read of pots, ignoring the moves from the initial readings
+void pots_wait_scan() {
+    while(!pots.scan_complete);
+    for(byte i=0; i<POTS_COUNT; ++i) {
+        pots.move_seen[i] = pots.move_count[i];
+    }
+}
+////////////////////////////////////////////////////////////////////////////////
+// set a saved reading before pots_init(). If the pot has since moved, the 
+// first scan will report the move
+void pots_restore(byte which, byte reading) {
+    pots.reading[which] = reading;
 }
 ////////////////////////////////////////////////////////////////////////////////
 inline byte pots_reading(int which) {
     return pots.reading[which];
 }
 ////////////////////////////////////////////////////////////////////////////////
-inline int pots_moved() {
-    int last_moved = pots.last_moved;
-    pots.last_moved = -1;
-    return last_moved;
+// returns a bit mask of the pots which have moved since the last call
+inline byte pots_moved() {
+    byte moved = 0;
+    for(byte i=0; i<POTS_COUNT; ++i) {
+        byte move_count = pots.move_count[i];
+        if(move_count != pots.move_seen[i]) {
+            pots.move_seen[i] = move_count;
+            moved |= (byte)(1<<i);
+        }
+    }
+    return moved;
 }
@@ -0,0 +1,422 @@
+#include <xc.h>
+#include "d-ticker.h"
+#ifdef UART_DEBUG
+#include "uart_debug.h"
+#endif
+
+/*
+ Cooperative scheduler for the main loop. On each ms tick the periodic 
+ tasks which are due are run to completion in table order, so the sequencer
+ is always served first. Long jobs (pattern recalculation) run as short 
+ bounded slices in the time left over before the next tick.
+ 
+ The ISR counts ticks rather than setting a flag. If the main loop falls 
+ behind (more than one tick pending) the tasks are run once for each missed 
+ tick so that their timeouts stay in step with real time, and the overrun 
+ is recorded. 
+ 
+ Timer 1 free runs at the instruction clock (4MHz) and is used to measure 
+ the run time of each task. Times include any interrupts serviced while
+ the task was running.
+ 
+ The CPU load is measured from the calls to sched_run() which find nothing 
+ to do. The quickest of these is taken as the cost of an idle pass with no
+ interrupt, so the idle passes in a window would have taken that much time 
+ each without interrupts, and anything more they took was spent in the ISR.
+ The ISR's share of the idle time is taken as its share of all the time.
+ */
+
+typedef struct {
+    void (*run)(void);
+    byte period_ms;
+} TASK_DEF;
+
+// periodic tasks, in priority order
+static const TASK_DEF task_def[SCHED_NUM_PERIODIC] = {
+    { seq_run, SEQ_RUN_MS },
+    { leds_run, LEDS_RUN_MS },
+    { ui_run, UI_RUN_MS },
+    { store_run, STORE_RUN_MS }
+};
+
+enum {
+    SCHED_LOAD_MS = 250,        // window over which CPU load is measured
+    SCHED_CYCLES_PER_MS = 4000  // timer 1 counts per ms
+};
+enum {
+    SCHED_REPORT_MS = 1000,     // how often stats are sent to debug UART
+    SCHED_REPORT_SIZE = 56      // longest report line
+};
+enum {
+    REPORT_OVERRUNS,            // lines in each report
+    REPORT_LOAD,
+    REPORT_LATE,
+    REPORT_LATE_HIST,
+    REPORT_EXT,
+    REPORT_JITTER_HIST,
+    REPORT_CACHE,
+    REPORT_TASK_TIME,
+    REPORT_TASK_LAST = REPORT_TASK_TIME + SCHED_NUM_TASKS - 1,
+#ifdef ISR_TIMING
+    REPORT_ISR_TIME,
+    REPORT_ISR_OVERRUNS = REPORT_ISR_TIME + ISR_NUM_SOURCES,
+#endif
+    SCHED_REPORT_LINES
+};
+
+// incremented by ISR each ms
+ISR_NEAR volatile byte sched_tick_count;
+
+struct {
+    byte ticks_done;                            // ticks handled by main loop
+    byte countdown[SCHED_NUM_PERIODIC];         // ms until task is due
+    unsigned int overruns;                      // times the main loop was late
+    byte max_overrun;                           // most ms the main loop was late
+    unsigned int max_time[SCHED_NUM_TASKS];     // longest run (timer 1 counts)
+    unsigned long total_time[SCHED_NUM_TASKS];  // total run (timer 1 counts)
+    byte load_countdown;                        // ms until end of load window
+    byte idle;                                  // was last sched_run() idle?
+    unsigned int idle_start;                    // timer 1 when it started
+    unsigned int idle_min;                      // quickest idle pass
+    unsigned long idle_passes;                  // idle passes in this window
+    unsigned long idle_time;                    // timer 1 counts spent idle
+    byte load_main;                             // % of last window in tasks
+    byte load_isr;                              // % of last window in ISR
+#ifdef UART_DEBUG
+    unsigned int report_timeout;
+    char report[SCHED_REPORT_SIZE];
+    byte report_pos;
+    byte report_line;                           // next line to send
+    unsigned long reported_time[SCHED_NUM_TASKS]; // total_time when reported
+#endif
+} sched;
+
+////////////////////////////////////////////////////////////////////////////////
+static void run_task(byte which, void (*run)(void)) {
+    unsigned int start = timing_read_timer();
+    run();
+    unsigned int elapsed = timing_read_timer() - start;
+    if(elapsed > sched.max_time[which]) {
+        sched.max_time[which] = elapsed;
+    }
+    sched.total_time[which] += elapsed;
+}
+
+#ifdef UART_DEBUG
+////////////////////////////////////////////////////////////////////////////////
+static char *put_number(char *p, unsigned int n) {
+    for(unsigned int div=10000; div; div/=10) {
+        *p++ = (char)('0' + (n/div)%10);
+    }
+    return p;
+}
+////////////////////////////////////////////////////////////////////////////////
+static char *put_long(char *p, unsigned long n) {
+    for(unsigned long div=1000000; div; div/=10) {
+        *p++ = (char)('0' + (n/div)%10);
+    }
+    return p;
+}
+////////////////////////////////////////////////////////////////////////////////
+// Put one line of the report in the buffer:
+//  o overruns m max d drops
+//                      main loop overruns, debug UART bytes dropped
+//  u main isr          CPU load in %
+//  l min max mean      trig lateness in 1/16 ms
+//  L counts...         trig lateness histogram, 1/4 ms buckets
+//  e min max mean jit  external clock interval in 4us
+//  E counts...         external clock jitter histogram
+//  c hits misses       pattern cache
+// Then there is a line for each task (SCHED_xxx) with its longest run and
+// its run time since the last report, in cycles:
+//  t0 max used
+// With ISR_TIMING there is then a line for each interrupt source with its 
+// longest and average time in cycles, and a line with the ISR overruns
+static void build_line(byte line) {
+    char *p = sched.report;
+    if(line == REPORT_OVERRUNS) {
+        *p++ = 'o';
+        *p++ = ' ';
+        p = put_number(p, sched.overruns);
+        *p++ = ' ';
+        *p++ = 'm';
+        *p++ = ' ';
+        p = put_number(p, sched.max_overrun);
+        *p++ = ' ';
+        *p++ = 'd';
+        *p++ = ' ';
+        p = put_number(p, uart_get_drops());
+    }
+    else if(line == REPORT_LOAD) {
+        *p++ = 'u';
+        *p++ = ' ';
+        p = put_number(p, sched.load_main);
+        *p++ = ' ';
+        p = put_number(p, sched.load_isr);
+    }
+    else if(line == REPORT_LATE) {
+        *p++ = 'l';
+        *p++ = ' ';
+        p = put_number(p, stats_get_late_min());
+        *p++ = ' ';
+        p = put_number(p, stats_get_late_max());
+        *p++ = ' ';
+        p = put_number(p, stats_get_late_mean());
+    }
+    else if(line == REPORT_LATE_HIST || line == REPORT_JITTER_HIST) {
+        *p++ = (line == REPORT_LATE_HIST) ? 'L' : 'E';
+        for(byte i=0; i<STATS_BUCKETS; ++i) {
+            *p++ = ' ';
+            p = put_number(p, (line == REPORT_LATE_HIST) ? 
+                stats_get_late_hist(i) : stats_get_jitter_hist(i));
+        }
+    }
+    else if(line == REPORT_EXT) {
+        *p++ = 'e';
+        for(byte i=STATS_EXT_MIN; i<=STATS_EXT_JITTER; ++i) {
+            *p++ = ' ';
+            p = put_long(p, stats_get_ext(i));
+        }
+    }
+    else if(line == REPORT_CACHE) {
+        *p++ = 'c';
+        *p++ = ' ';
+        p = put_number(p, pat_get_cache_hits());
+        *p++ = ' ';
+        p = put_number(p, pat_get_cache_misses());
+    }
+    else if(line <= REPORT_TASK_LAST) {
+        byte which = line - REPORT_TASK_TIME;
+        unsigned long total = sched_get_total_time(which);
+        *p++ = 't';
+        *p++ = (char)('0' + which);
+        *p++ = ' ';
+        p = put_number(p, sched_get_max_time(which));
+        *p++ = ' ';
+        p = put_long(p, total - sched.reported_time[which]);
+        sched.reported_time[which] = total;
+    }
+#ifdef ISR_TIMING
+    else if(line < REPORT_ISR_OVERRUNS) {
+        *p++ = 'i';
+        *p++ = (char)('0' + line - REPORT_ISR_TIME);
+        *p++ = ' ';
+        p = put_number(p, timing_get_max(line - REPORT_ISR_TIME));
+        *p++ = ' ';
+        p = put_number(p, timing_get_average(line - REPORT_ISR_TIME));
+    }
+    else {
+        *p++ = 'i';
+        *p++ = 'o';
+        *p++ = ' ';
+        p = put_number(p, timing_get_overruns());
+    }
+#endif
+    *p++ = '\r';
+    *p++ = '\n';
+    *p = 0;
+    sched.report_pos = 0;
+}
+////////////////////////////////////////////////////////////////////////////////
+// The report is queued on the UART one character at a time whenever there 
+// is room (leaving space for a trace frame), so it does not hold up the 
+// main loop. Returns 0 if there was nothing to do
+static byte run_report() {
+    if(!sched.report[sched.report_pos]) {
+        // line sent, start the next line or the next report when it is due
+        if(sched.report_line >= SCHED_REPORT_LINES) {
+            if(sched.report_timeout) {
+                return 0;
+            }
+            sched.report_timeout = SCHED_REPORT_MS;
+            sched.report_line = 0;
+#ifdef ISR_TIMING
+            timing_request_snapshot();
+#endif
+        }
+#ifdef ISR_TIMING
+        // wait for the ISR to take the snapshot of its timing
+        if(!timing_snapshot_ready()) {
+            return 0;
+        }
+#endif
+        build_line(sched.report_line++);
+        return 1;
+    }
+    if(uart_tx_free() > 8) {
+        uart_send(sched.report[sched.report_pos++]);
+        return 1;
+    }
+    return 0;
+}
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+// work out the CPU load over the window just ended and start the next one
+static void calc_load() {
+    const unsigned long window = 
+        (unsigned long)SCHED_LOAD_MS * SCHED_CYCLES_PER_MS;
+    unsigned long idle_time = sched.idle_time;
+    if(idle_time > window) {
+        // an idle pass can run on past the end of the window
+        idle_time = window;
+    }
+    // time the idle passes would have taken without interrupts
+    unsigned long idle_clear = sched.idle_passes * sched.idle_min;
+    if(idle_clear > idle_time) {
+        idle_clear = idle_time;
+    }
+    byte load = (byte)(100 - (idle_clear * 100) / window);
+    if(idle_time) {
+        sched.load_isr = (byte)(((idle_time - idle_clear) * 100) / idle_time);
+    }
+    // else the CPU had no idle time, so keep the last ISR share
+    sched.load_main = (load > sched.load_isr) ? load - sched.load_isr : 0;
+    
+    sched.idle_passes = 0;
+    sched.idle_time = 0;
+    sched.idle_min = 0xFFFF;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// run the periodic tasks which are due on this tick
+static void run_tick() {
+    for(byte i=0; i<SCHED_NUM_PERIODIC; ++i) {
+        if(!--sched.countdown[i]) {
+            sched.countdown[i] = task_def[i].period_ms;
+            run_task(i, task_def[i].run);
+        }
+    }
+    if(!--sched.load_countdown) {
+        sched.load_countdown = SCHED_LOAD_MS;
+        calc_load();
+    }
+#ifdef UART_DEBUG
+    if(sched.report_timeout) {
+        --sched.report_timeout;
+    }
+#endif
+#ifdef TRACE
+    trace_run();
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void sched_init() {
+    sched.ticks_done = sched_tick_count;
+    sched.overruns = 0;
+    sched.max_overrun = 0;
+    sched.load_countdown = SCHED_LOAD_MS;
+    sched.idle = 0;
+    sched.idle_min = 0xFFFF;
+    sched.idle_passes = 0;
+    sched.idle_time = 0;
+    sched.load_main = 0;
+    sched.load_isr = 0;
+    for(byte i=0; i<SCHED_NUM_TASKS; ++i) {
+        if(i < SCHED_NUM_PERIODIC) {
+            // stagger the first runs so slower tasks don't share a tick
+            sched.countdown[i] = 1 + i;
+        }
+        sched.max_time[i] = 0;
+        sched.total_time[i] = 0;
+    }
+    
+    // timer 1 free running at instruction clock, 1:1 prescale
+    T1CON = 0b00000001;
+    
+#ifdef UART_DEBUG
+    uart_init();
+    sched.report_timeout = SCHED_REPORT_MS;
+    sched.report[0] = 0;
+    sched.report_pos = 0;
+    sched.report_line = SCHED_REPORT_LINES;
+    for(byte i=0; i<SCHED_NUM_TASKS; ++i) {
+        sched.reported_time[i] = 0;
+    }
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// called every ms by interrupt
+inline void sched_ms_isr() {
+    ++sched_tick_count;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// called repeatedly from the main loop
+void sched_run() {
+    unsigned int now = timing_read_timer();
+    if(sched.idle) {
+        // the last pass found nothing to do, so it was idle until now
+        unsigned int elapsed = now - sched.idle_start;
+        if(elapsed < sched.idle_min) {
+            sched.idle_min = elapsed;
+        }
+        sched.idle_time += elapsed;
+        ++sched.idle_passes;
+        sched.idle = 0;
+    }
+    
+    // only the ISR writes sched_tick_count and only the main loop writes 
+    // ticks_done, so no need to disable interrupts here
+    byte pending = sched_tick_count - sched.ticks_done;
+    if(pending) {
+        if(pending > 1) {
+            ++sched.overruns;
+            if(pending - 1 > sched.max_overrun) {
+                sched.max_overrun = pending - 1;
+            }
+        }
+        // catch up on each missed tick in turn
+        while(pending--) {
+            run_tick();
+            ++sched.ticks_done;
+        }
+    }
+    else if(pat_is_busy()) {
+        run_task(SCHED_PAT, pat_run);
+    }
+    else {
+#ifdef UART_DEBUG
+        if(run_report()) {
+            return;
+        }
+#endif
+        // nothing to do, so this pass is idle until the next one starts
+        sched.idle = 1;
+        sched.idle_start = now;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+unsigned int sched_get_overruns() {
+    return sched.overruns;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+byte sched_get_max_overrun() {
+    return sched.max_overrun;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// % of the CPU used by the main loop tasks over the last 250ms
+byte sched_get_load_main() {
+    return sched.load_main;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// % of the CPU used by the ISR over the last 250ms
+byte sched_get_load_isr() {
+    return sched.load_isr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+unsigned int sched_get_max_time(byte which) {
+    return sched.max_time[which];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+unsigned long sched_get_total_time(byte which) {
+    return sched.total_time[which];
+}
@@ -1,10 +1,10 @@
 #include <xc.h>
 #include "d-ticker.h"
 
-static struct {
+static ISR_BANK struct {
     int cur_trig;
     int prev_step;
-    unsigned int prev_pos;
+    pos_t prev_pos;
     volatile byte reset_state;
     volatile byte reset_mode;
     volatile byte output_enabled;
@@ -25,6 +25,8 @@ void seq_init() {
 ////////////////////////////////////////////////////////////////////////////////
 void seq_reset_signal_isr(byte reset_signal) {
     seq.reset_state = reset_signal;
+    TRACE_EVENT_ISR(TRACE_RESET, reset_signal);
+    bbox_log_isr(reset_signal ? BBOX_RESET_ON : BBOX_RESET_OFF);
     if(reset_signal) { // rising edge
         seq.output_enabled = 1;
         switch(seq.reset_mode){
@@ -72,8 +74,8 @@ int seq_get_output_trig() {
 }
 ////////////////////////////////////////////////////////////////////////////////
 void seq_run() {
-    // fetch the current position in the pattern (0-65535)
-    unsigned int new_pos = clk_get_cur_pos();
+    // fetch the current position in the pattern
+    pos_t new_pos = clk_get_cur_pos();
     
     // check if the clock has been restarted
     if(clk_is_restart()) {
@@ -97,6 +99,9 @@ void seq_run() {
             }
             if(seq.output_enabled) {
                 out_trig(); 
+                stats_trig_late(new_pos - pat_get_trig(seq.cur_trig));
+                TRACE_EVENT(TRACE_TRIG, (byte)seq.cur_trig);
+                bbox_log(BBOX_TRIG);
                 leds_set_pos((byte)((4*seq.cur_trig)/pat_get_num_trigs()), SHORT_LED_BLINK_MS);
             }
             ++seq.cur_trig;
@@ -0,0 +1,233 @@
+#include <xc.h>
+#include "d-ticker.h"
+
+/*
+ Timing quality statistics, kept all the time so they can be read from 
+ any module.
+ 
+ Trig lateness is how far the clock had gone past a trig's position when 
+ seq_run() fired it. It is kept in 1/16 ms units, worked out from the 
+ clock's current rate by a 6 step shift and subtract rather than a 
+ division, and saturates at 63 (about 4ms).
+ 
+ External clock intervals are timed in timer 0 counts (4us) from a count
+ which the ms ISR moves on by 251 each tick, plus timer 0 itself. Timer 0 
+ is reloaded with 5 each tick and counts 5..255 and then overflows, so a
+ tick is 251 counts (1.004ms) rather than 250. Jitter is
+ the difference between one interval and the one before it. Its histogram
+ has log2 buckets: 0, 4us, 8-12us, 16-28us ... and 256us or more.
+ 
+ The main loop owns the lateness stats. The ISR owns the clock stats and 
+ bumps ext_generation when it changes them, so the getters can retry if
+ they read part way through an update. To clear the clock stats the main
+ loop sets reset_pending and the ISR clears them on the next ms tick.
+ */
+
+enum {
+    STATS_TMR0_START = 5,       // timer 0 count at the start of each ms
+    STATS_TMR0_PER_TICK = 251,
+    STATS_MIN_INTERVAL = 10L * STATS_TMR0_PER_TICK, // as clock.c, in ticks
+    STATS_MAX_INTERVAL = 3000L * STATS_TMR0_PER_TICK,
+    STATS_MAX_LATE = 63
+};
+
+// main loop state
+struct {
+    unsigned int late_hist[STATS_BUCKETS];  // 1/4 ms buckets
+    byte late_min;
+    byte late_max;
+    unsigned long late_total;
+    unsigned int late_count;
+} stats;
+
+// ISR state
+ISR_NEAR volatile byte stats_ext_generation;
+ISR_BANK struct {
+    long ext_ticks;                 // timer 0 counts since last pulse
+    volatile byte reset_pending;
+} stats_tick;
+struct {
+    unsigned long prev_interval;    // 0 if the last interval was not valid
+    unsigned int jitter_hist[STATS_BUCKETS];
+    unsigned long ext_min;
+    unsigned long ext_max;
+    unsigned long ext_total;
+    unsigned long jitter_total;
+    unsigned int ext_count;
+    unsigned int jitter_count;
+} stats_isr;
+
+////////////////////////////////////////////////////////////////////////////////
+static void inc_count(unsigned int *count) {
+    if(*count < 0xFFFF) {
+        ++*count;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void stats_reset() {
+    for(byte i=0; i<STATS_BUCKETS; ++i) {
+        stats.late_hist[i] = 0;
+    }
+    stats.late_min = STATS_MAX_LATE;
+    stats.late_max = 0;
+    stats.late_total = 0;
+    stats.late_count = 0;
+    stats_tick.reset_pending = 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void stats_init() {
+    stats_tick.ext_ticks = 0;
+    stats_isr.prev_interval = 0;
+    stats_ext_generation = 0;
+    stats_reset();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// called every ms by interrupt
+inline void stats_ms_isr() {
+    if(stats_tick.reset_pending) {
+        ++stats_ext_generation;
+        stats_isr.ext_count = 0;
+        stats_isr.jitter_count = 0;
+        stats_isr.ext_min = 0xFFFFFFFF;
+        stats_isr.ext_max = 0;
+        stats_isr.ext_total = 0;
+        stats_isr.jitter_total = 0;
+        for(byte i=0; i<STATS_BUCKETS; ++i) {
+            stats_isr.jitter_hist[i] = 0;
+        }
+        stats_tick.reset_pending = 0;
+    }
+    if(stats_tick.ext_ticks < STATS_MAX_INTERVAL) {
+        stats_tick.ext_ticks += STATS_TMR0_PER_TICK;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// called by interrupt on each external clock pulse
+inline void stats_ext_clock_isr() {
+    // counts since the start of the tick not yet counted by the ms ISR. If 
+    // timer 0 has overflowed but the ISR has not reloaded it yet, that 
+    // tick ended at the overflow, so count on from there. The ms ISR adds 
+    // the whole tick, so start the next interval that much lower
+    byte tmr0 = TMR0;
+    unsigned int sub_tick = (byte)(tmr0 - STATS_TMR0_START);
+    if(INTCONbits.T0IF) {
+        sub_tick = STATS_TMR0_PER_TICK + tmr0;
+    }
+    unsigned long interval = (unsigned long)(stats_tick.ext_ticks + sub_tick);
+    stats_tick.ext_ticks = -(long)sub_tick;
+    
+    if(interval < STATS_MIN_INTERVAL || interval > STATS_MAX_INTERVAL) {
+        stats_isr.prev_interval = 0;
+        return;
+    }
+    ++stats_ext_generation;
+    if(interval < stats_isr.ext_min) {
+        stats_isr.ext_min = interval;
+    }
+    if(interval > stats_isr.ext_max) {
+        stats_isr.ext_max = interval;
+    }
+    stats_isr.ext_total += interval;
+    inc_count(&stats_isr.ext_count);
+    
+    if(stats_isr.prev_interval) {
+        unsigned long jitter = (interval > stats_isr.prev_interval) ? 
+            interval - stats_isr.prev_interval : 
+            stats_isr.prev_interval - interval;
+        stats_isr.jitter_total += jitter;
+        inc_count(&stats_isr.jitter_count);
+        byte bucket = 0;
+        while(bucket < STATS_BUCKETS-1 && jitter) {
+            jitter >>= 1;
+            ++bucket;
+        }
+        inc_count(&stats_isr.jitter_hist[bucket]);
+    }
+    stats_isr.prev_interval = interval;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// A trig was fired late_pos after its position in the pattern
+void stats_trig_late(pos_t late_pos) {
+    phase_t late = (phase_t)late_pos << (32 - POS_BITS);
+    phase_t unit = clk_get_ticks_per_ms() >> 4;     // 1/16 ms
+    byte q = STATS_MAX_LATE;
+    if(late < unit << 6) {
+        // binary long division, q will be less than 64
+        q = 0;
+        for(signed char k=5; k>=0; --k) {
+            if(late >= unit << k) {
+                late -= unit << k;
+                q |= 1<<k;
+            }
+        }
+    }
+    if(q < stats.late_min) {
+        stats.late_min = q;
+    }
+    if(q > stats.late_max) {
+        stats.late_max = q;
+    }
+    stats.late_total += q;
+    inc_count(&stats.late_count);
+    inc_count(&stats.late_hist[q >> 2 < STATS_BUCKETS ? q >> 2 : STATS_BUCKETS-1]);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+unsigned int stats_get_late_hist(byte bucket) {
+    return stats.late_hist[bucket];
+}
+////////////////////////////////////////////////////////////////////////////////
+// in 1/16 ms
+byte stats_get_late_min() {
+    return stats.late_count ? stats.late_min : 0;
+}
+////////////////////////////////////////////////////////////////////////////////
+byte stats_get_late_max() {
+    return stats.late_max;
+}
+////////////////////////////////////////////////////////////////////////////////
+byte stats_get_late_mean() {
+    return stats.late_count ? (byte)(stats.late_total / stats.late_count) : 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+unsigned int stats_get_jitter_hist(byte bucket) {
+    byte generation;
+    unsigned int count;
+    do {
+        generation = stats_ext_generation;
+        count = stats_isr.jitter_hist[bucket];
+    } while(generation != stats_ext_generation);
+    return count;
+}
+////////////////////////////////////////////////////////////////////////////////
+// which is one of STATS_EXT_xxx. Results are in timer 0 counts (4us)
+unsigned long stats_get_ext(byte which) {
+    byte generation;
+    unsigned long result;
+    do {
+        generation = stats_ext_generation;
+        unsigned int count = stats_isr.ext_count;
+        unsigned int jitter_count = stats_isr.jitter_count;
+        switch(which) {
+            case STATS_EXT_MIN:
+                result = count ? stats_isr.ext_min : 0;
+                break;
+            case STATS_EXT_MAX:
+                result = stats_isr.ext_max;
+                break;
+            case STATS_EXT_MEAN:
+                result = count ? stats_isr.ext_total / count : 0;
+                break;
+            default:
+                result = jitter_count ? stats_isr.jitter_total / jitter_count : 0;
+                break;
+        }
+    } while(generation != stats_ext_generation);
+    return result;
+}
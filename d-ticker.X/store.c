@@ -0,0 +1,415 @@
+#include <xc.h>
+#include "d-ticker.h"
+
+/*
+ Settings and the last calculated pattern are kept in data EEPROM so that 
+ at power up the module can start running straight away rather than 
+ waiting for the pots to be read and the pattern to be calculated.
+ 
+ EEPROM layout:
+ 
+ 0..71      pattern bank 0: sequence number, trig count, curve, pot 
+            readings, trig table, checksum
+ 72..143    pattern bank 1
+ 144..255   settings ring: 14 slots of 8 bytes, each holding a sequence 
+            number, the menu settings and a checksum
+ 
+ With LONG_PHASE the trigs take 3 bytes each and the bank holds the bar 
+ count after the curve, so the pattern banks are 0..104 and 105..209 and 
+ the ring has 5 slots from 216.
+ 
+ Changes are saved in the background after a delay, so that a burst of 
+ changes (e.g. turning a pot) costs one save. Each save of the settings goes
+ to the next slot in the ring so that their EEPROM wear is shared across
+ all the slots. Saves of the pattern alternate between the two banks, and
+ only the bytes of a bank which have changed are written. At power up the
+ valid bank with the later sequence number is used, so a save interrupted 
+ by power off leaves the other bank to fall back on. The banks have room 
+ for as many trigs as the menu offers; a pattern with more is not saved 
+ and is calculated at power up instead. A bank is only restored if the 
+ settings it was calculated for (trig count, curve and with LONG_PHASE the
+ bar count) match the saved settings.
+ 
+ store_run() prepares a run of up to 8 bytes and starts writing the first.
+ The EEPROM interrupt then starts each following byte, so the main loop 
+ never waits for a write. Checksums are written last so a save interrupted
+ by power off is ignored at the next power up. A settings slot is only 
+ used if each of its settings is in range too.
+ */
+
+enum {
+    STORE_PAT_MAX_TRIGS = 32,       // most trigs the menu offers
+    STORE_PAT_SEQ = 0,
+    STORE_PAT_NUM_TRIGS,
+    STORE_PAT_CURVE,
+#ifdef LONG_PHASE
+    STORE_PAT_NUM_BARS,
+#endif
+    STORE_PAT_POTS,
+    STORE_PAT_TRIGS = STORE_PAT_POTS + POTS_COUNT,
+    STORE_PAT_CHECKSUM = STORE_PAT_TRIGS + POS_BYTES * STORE_PAT_MAX_TRIGS,
+    STORE_PAT_SIZE
+};
+enum {
+    STORE_SLOT_SEQ,
+    STORE_SLOT_NUM_STEPS,
+    STORE_SLOT_NUM_TRIGS,
+    STORE_SLOT_MODES,               // reset mode | curve << 4
+    STORE_SLOT_BPM_LO,
+    STORE_SLOT_BPM_HI,
+    STORE_SLOT_NUM_BARS,
+    STORE_SLOT_CHECKSUM,
+    STORE_SLOT_SIZE = 8
+};
+enum {
+    STORE_RING_ADDR = (2 * STORE_PAT_SIZE + 7) & ~7,
+    STORE_RING_SLOTS = (256 - STORE_RING_ADDR) / STORE_SLOT_SIZE,
+    STORE_BUF_SIZE = 8,             // bytes written per run
+    STORE_CHECKSUM_SEED = 0x5A,     // so that blank EEPROM is not valid
+    STORE_MAX_COMPARE = 8,          // bytes compared per call to store_run()
+    STORE_DELAY_MS = 3000           // time after last change before saving
+};
+
+struct {
+    byte setting[STORE_SLOT_SIZE];  // current settings, laid out as a slot
+    byte slot;                      // next ring slot to write
+    byte settings_pending;          // settings need saving
+    byte pattern_pending;           // pattern needs saving
+    unsigned int delay;             // ms before pending changes are saved
+    byte pat_addr;                  // next offset of pattern to save
+    byte pat_checksum;              // checksum of pattern bytes so far
+    byte pat_bank;                  // pattern bank to write next
+    byte pat_seq;                   // sequence number of the newest bank
+    
+    // run of bytes being written by the ISR
+    byte buf[STORE_BUF_SIZE];
+    byte buf_addr;
+    byte buf_len;
+    volatile byte buf_pos;
+    volatile byte writing;
+} store;
+
+////////////////////////////////////////////////////////////////////////////////
+static byte read_byte(byte addr) {
+    EEADRL = addr;
+    EECON1bits.CFGS = 0;
+    EECON1bits.EEPGD = 0;
+    EECON1bits.RD = 1;
+    return EEDATL;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Start writing a byte. The write completes in the background after a few 
+// ms and raises the EEPROM interrupt. Interrupts must be disabled since the
+// unlock sequence must not be interrupted
+static void start_write(byte addr, byte value) {
+    EEADRL = addr;
+    EEDATL = value;
+    EECON1bits.CFGS = 0;
+    EECON1bits.EEPGD = 0;
+    EECON1bits.WREN = 1;
+    EECON2 = 0x55;
+    EECON2 = 0xAA;
+    EECON1bits.WR = 1;
+    EECON1bits.WREN = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Hand a run of bytes in the buffer over to the ISR
+static void start_run(byte addr, byte len) {
+    store.buf_addr = addr;
+    store.buf_len = len;
+    store.buf_pos = 1;
+    store.writing = 1;
+    di();
+    start_write(addr, store.buf[0]);
+    ei();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// called by interrupt when a byte has been written
+void store_write_isr() {
+    if(store.buf_pos < store.buf_len) {
+        start_write(store.buf_addr + store.buf_pos, store.buf[store.buf_pos]);
+        ++store.buf_pos;
+    }
+    else {
+        store.writing = 0;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// The value of a byte in the pattern bank being written. The pot readings 
+// and trig table are taken from the pots and pattern at the time they are 
+// written
+static byte get_pattern_byte(byte addr) {
+    if(addr == STORE_PAT_SEQ) {
+        return store.pat_seq + 1;
+    }
+    if(addr == STORE_PAT_NUM_TRIGS) {
+        return (byte)pat_get_num_trigs();
+    }
+    if(addr == STORE_PAT_CURVE) {
+        return pat_get_curve();
+    }
+#ifdef LONG_PHASE
+    if(addr == STORE_PAT_NUM_BARS) {
+        return store.setting[STORE_SLOT_NUM_BARS];
+    }
+#endif
+    if(addr < STORE_PAT_TRIGS) {
+        return pots_reading(addr - STORE_PAT_POTS);
+    }
+    if(addr < STORE_PAT_CHECKSUM) {
+        byte offset = addr - STORE_PAT_TRIGS;
+        pos_t trig = 0;
+        if(offset/POS_BYTES < pat_get_num_trigs()) {
+            trig = pat_get_trig(offset/POS_BYTES);
+        }
+        return (byte)(trig >> (8 * (offset % POS_BYTES)));
+    }
+    return store.pat_checksum;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Write the settings to the next slot in the ring
+static void save_settings() {
+    ++store.setting[STORE_SLOT_SEQ];
+    byte checksum = STORE_CHECKSUM_SEED;
+    for(byte i=0; i<STORE_SLOT_CHECKSUM; ++i) {
+        store.buf[i] = store.setting[i];
+        checksum += store.setting[i];
+    }
+    store.buf[STORE_SLOT_CHECKSUM] = checksum;
+    start_run(STORE_RING_ADDR + store.slot * STORE_SLOT_SIZE, STORE_SLOT_CHECKSUM + 1);
+    if(++store.slot >= STORE_RING_SLOTS) {
+        store.slot = 0;
+    }
+    store.settings_pending = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Skip over bytes of the pattern bank which have not changed, then write the
+// next run of bytes which have. Once the whole bank is written it is the 
+// newest, and the next save goes to the other bank
+static void save_pattern() {
+    if(pat_get_num_trigs() > STORE_PAT_MAX_TRIGS) {
+        store.pattern_pending = 0;
+        return;
+    }
+    byte base = store.pat_bank * STORE_PAT_SIZE;
+    byte len = 0;
+    byte start = store.pat_addr;
+    for(byte i=0; i<STORE_MAX_COMPARE; ++i) {
+        byte addr = store.pat_addr;
+        byte value = get_pattern_byte(addr);
+        if(read_byte(base + addr) != value) {
+            if(!len) {
+                start = addr;
+            }
+            store.buf[len++] = value;
+        }
+        else if(len) {
+            break;
+        }
+        store.pat_checksum += value;
+        if(++store.pat_addr >= STORE_PAT_SIZE) {
+            store.pattern_pending = 0;
+            ++store.pat_seq;
+            store.pat_bank ^= 1;
+            break;
+        }
+        if(len >= STORE_BUF_SIZE) {
+            break;
+        }
+    }
+    if(len) {
+        start_run(base + start, len);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static void settings_changed() {
+    store.settings_pending = 1;
+    store.delay = STORE_DELAY_MS;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Is the pattern bank at base intact?
+static byte pattern_bank_valid(byte base) {
+    byte checksum = STORE_CHECKSUM_SEED;
+    for(byte addr = 0; addr < STORE_PAT_CHECKSUM; ++addr) {
+        checksum += read_byte(base + addr);
+    }
+    return checksum == read_byte(base + STORE_PAT_CHECKSUM) &&
+        read_byte(base + STORE_PAT_NUM_TRIGS) <= STORE_PAT_MAX_TRIGS;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Load the saved settings. Returns 1 if the pattern was restored too, 
+// otherwise 0 and the caller must calculate the pattern
+byte store_init() {
+    store.settings_pending = 0;
+    store.pattern_pending = 0;
+    store.delay = 0;
+    store.writing = 0;
+    store.slot = 0;
+    store.pat_bank = 0;
+    store.pat_seq = 0;
+    store.setting[STORE_SLOT_SEQ] = 0;
+    store.setting[STORE_SLOT_NUM_STEPS] = 16;
+    store.setting[STORE_SLOT_NUM_TRIGS] = 16;
+    store.setting[STORE_SLOT_MODES] = RESET_MODE_RESTART | (PAT_CURVE_CLASSIC << 4);
+    store.setting[STORE_SLOT_BPM_LO] = 120;
+    store.setting[STORE_SLOT_BPM_HI] = 0;
+    store.setting[STORE_SLOT_NUM_BARS] = 1;
+    
+    // find the most recently written valid slot in the settings ring
+    byte found = 0;
+    byte best_slot = 0;
+    byte best_seq = 0;
+    for(byte slot=0; slot<STORE_RING_SLOTS; ++slot) {
+        byte addr = STORE_RING_ADDR + slot * STORE_SLOT_SIZE;
+        byte checksum = STORE_CHECKSUM_SEED;
+        for(byte i=0; i<STORE_SLOT_CHECKSUM; ++i) {
+            checksum += read_byte(addr + i);
+        }
+        unsigned int bpm = read_byte(addr + STORE_SLOT_BPM_LO) | 
+            ((unsigned int)read_byte(addr + STORE_SLOT_BPM_HI)<<8);
+        if(checksum != read_byte(addr + STORE_SLOT_CHECKSUM) ||
+            !read_byte(addr + STORE_SLOT_NUM_STEPS) ||
+            !read_byte(addr + STORE_SLOT_NUM_TRIGS) ||
+            read_byte(addr + STORE_SLOT_NUM_TRIGS) > MAX_TRIGS ||
+            (read_byte(addr + STORE_SLOT_MODES) & 0x0F) > RESET_MODE_RESTART_RUN ||
+            (read_byte(addr + STORE_SLOT_MODES) >> 4) > PAT_CURVE_LINEAR ||
+            bpm < MIN_BPM || bpm > MAX_BPM ||
+            !read_byte(addr + STORE_SLOT_NUM_BARS) ||
+            read_byte(addr + STORE_SLOT_NUM_BARS) > MAX_BARS) {
+            continue;
+        }
+        byte seq = read_byte(addr + STORE_SLOT_SEQ);
+        if(!found || (signed char)(seq - best_seq) > 0) {
+            found = 1;
+            best_slot = slot;
+            best_seq = seq;
+        }
+    }
+    if(found) {
+        byte addr = STORE_RING_ADDR + best_slot * STORE_SLOT_SIZE;
+        for(byte i=0; i<STORE_SLOT_CHECKSUM; ++i) {
+            store.setting[i] = read_byte(addr + i);
+        }
+        store.slot = (best_slot + 1) % STORE_RING_SLOTS;
+        clk_set_num_steps(store.setting[STORE_SLOT_NUM_STEPS]);
+        clk_set_bpm(store.setting[STORE_SLOT_BPM_LO] | 
+            ((int)store.setting[STORE_SLOT_BPM_HI]<<8));
+        clk_set_num_bars(store.setting[STORE_SLOT_NUM_BARS]);
+        seq_set_reset_mode(store.setting[STORE_SLOT_MODES] & 0x0F);
+        pat_set_curve(store.setting[STORE_SLOT_MODES] >> 4);
+        pat_set_num_trigs(store.setting[STORE_SLOT_NUM_TRIGS]);
+    }
+    
+    // find the newest valid pattern bank. The next save goes to the other one
+    found = 0;
+    byte base = 0;
+    for(byte bank=0; bank<2; ++bank) {
+        if(!pattern_bank_valid(bank * STORE_PAT_SIZE)) {
+            continue;
+        }
+        byte seq = read_byte(bank * STORE_PAT_SIZE + STORE_PAT_SEQ);
+        if(!found || (signed char)(seq - store.pat_seq) > 0) {
+            found = 1;
+            base = bank * STORE_PAT_SIZE;
+            store.pat_seq = seq;
+            store.pat_bank = bank ^ 1;
+        }
+    }
+    
+    // the pattern is only used if it was calculated for the saved settings
+    byte num_trigs = read_byte(base + STORE_PAT_NUM_TRIGS);
+    if(!found || num_trigs != store.setting[STORE_SLOT_NUM_TRIGS] ||
+        read_byte(base + STORE_PAT_CURVE) != (store.setting[STORE_SLOT_MODES] >> 4)) {
+        return 0;
+    }
+#ifdef LONG_PHASE
+    if(read_byte(base + STORE_PAT_NUM_BARS) != store.setting[STORE_SLOT_NUM_BARS]) {
+        return 0;
+    }
+#endif
+    for(byte i=0; i<POTS_COUNT; ++i) {
+        pots_restore(i, read_byte(base + STORE_PAT_POTS + i));
+    }
+    pat_restore(num_trigs);
+    byte addr = base + STORE_PAT_TRIGS;
+    for(byte i=0; i<num_trigs; ++i) {
+        pos_t trig = 0;
+        for(byte j=0; j<POS_BYTES; ++j) {
+            trig |= (pos_t)read_byte(addr++) << (8 * j);
+        }
+        pat_restore_trig(i, trig);
+    }
+    return 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Called every STORE_RUN_MS to start saving any changes
+void store_run() {
+    if(store.delay) {
+        if(store.delay <= STORE_RUN_MS) {
+            store.delay = 0;
+        }
+        else {
+            store.delay -= STORE_RUN_MS;
+        }
+        return;
+    }
+    if(store.writing) {
+        return;
+    }
+    if(store.settings_pending) {
+        save_settings();
+    }
+    else if(store.pattern_pending) {
+        save_pattern();
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void store_set_num_steps(byte num_steps) {
+    store.setting[STORE_SLOT_NUM_STEPS] = num_steps;
+    settings_changed();
+}
+////////////////////////////////////////////////////////////////////////////////
+void store_set_num_trigs(byte num_trigs) {
+    store.setting[STORE_SLOT_NUM_TRIGS] = num_trigs;
+    settings_changed();
+}
+////////////////////////////////////////////////////////////////////////////////
+void store_set_reset_mode(byte reset_mode) {
+    store.setting[STORE_SLOT_MODES] = (store.setting[STORE_SLOT_MODES] & 0xF0) | reset_mode;
+    settings_changed();
+}
+////////////////////////////////////////////////////////////////////////////////
+void store_set_curve(byte curve) {
+    store.setting[STORE_SLOT_MODES] = (store.setting[STORE_SLOT_MODES] & 0x0F) | (curve << 4);
+    settings_changed();
+}
+////////////////////////////////////////////////////////////////////////////////
+void store_set_num_bars(byte num_bars) {
+    store.setting[STORE_SLOT_NUM_BARS] = num_bars;
+    settings_changed();
+}
+////////////////////////////////////////////////////////////////////////////////
+void store_set_bpm(int bpm) {
+    store.setting[STORE_SLOT_BPM_LO] = (byte)bpm;
+    store.setting[STORE_SLOT_BPM_HI] = (byte)(bpm>>8);
+    settings_changed();
+}
+////////////////////////////////////////////////////////////////////////////////
+// The pattern has been recalculated, save it from the start
+void store_pattern_changed() {
+    store.pattern_pending = 1;
+    store.pat_addr = 0;
+    store.pat_checksum = STORE_CHECKSUM_SEED;
+    store.delay = STORE_DELAY_MS;
+}
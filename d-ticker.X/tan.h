@@ -1,4 +1,4 @@
-byte tan_table[128] = {
+const byte tan_table[128] = {
 0, 
 2, 
 3, 
@@ -0,0 +1,262 @@
+// Generated by host/gen_tempo.c - do not edit
+
+// phase per ms for a one step pattern at BPM 16 + 2 * index. Shift
+// right by log2 of the number of steps in the pattern
+const unsigned long bpm_phase_per_ms[256] = {
+1145325, 
+1288490, 
+1431656, 
+1574821, 
+1717987, 
+1861152, 
+2004318, 
+2147484, 
+2290649, 
+2433815, 
+2576980, 
+2720146, 
+2863312, 
+3006477, 
+3149643, 
+3292808, 
+3435974, 
+3579139, 
+3722305, 
+3865471, 
+4008636, 
+4151802, 
+4294967, 
+4438133, 
+4581298, 
+4724464, 
+4867630, 
+5010795, 
+5153961, 
+5297126, 
+5440292, 
+5583457, 
+5726623, 
+5869789, 
+6012954, 
+6156120, 
+6299285, 
+6442451, 
+6585617, 
+6728782, 
+6871948, 
+7015113, 
+7158279, 
+7301444, 
+7444610, 
+7587776, 
+7730941, 
+7874107, 
+8017272, 
+8160438, 
+8303603, 
+8446769, 
+8589935, 
+8733100, 
+8876266, 
+9019431, 
+9162597, 
+9305762, 
+9448928, 
+9592094, 
+9735259, 
+9878425, 
+10021590, 
+10164756, 
+10307922, 
+10451087, 
+10594253, 
+10737418, 
+10880584, 
+11023749, 
+11166915, 
+11310081, 
+11453246, 
+11596412, 
+11739577, 
+11882743, 
+12025908, 
+12169074, 
+12312240, 
+12455405, 
+12598571, 
+12741736, 
+12884902, 
+13028067, 
+13171233, 
+13314399, 
+13457564, 
+13600730, 
+13743895, 
+13887061, 
+14030227, 
+14173392, 
+14316558, 
+14459723, 
+14602889, 
+14746054, 
+14889220, 
+15032386, 
+15175551, 
+15318717, 
+15461882, 
+15605048, 
+15748213, 
+15891379, 
+16034545, 
+16177710, 
+16320876, 
+16464041, 
+16607207, 
+16750372, 
+16893538, 
+17036704, 
+17179869, 
+17323035, 
+17466200, 
+17609366, 
+17752531, 
+17895697, 
+18038863, 
+18182028, 
+18325194, 
+18468359, 
+18611525, 
+18754691, 
+18897856, 
+19041022, 
+19184187, 
+19327353, 
+19470518, 
+19613684, 
+19756850, 
+19900015, 
+20043181, 
+20186346, 
+20329512, 
+20472677, 
+20615843, 
+20759009, 
+20902174, 
+21045340, 
+21188505, 
+21331671, 
+21474836, 
+21618002, 
+21761168, 
+21904333, 
+22047499, 
+22190664, 
+22333830, 
+22476996, 
+22620161, 
+22763327, 
+22906492, 
+23049658, 
+23192823, 
+23335989, 
+23479155, 
+23622320, 
+23765486, 
+23908651, 
+24051817, 
+24194982, 
+24338148, 
+24481314, 
+24624479, 
+24767645, 
+24910810, 
+25053976, 
+25197141, 
+25340307, 
+25483473, 
+25626638, 
+25769804, 
+25912969, 
+26056135, 
+26199301, 
+26342466, 
+26485632, 
+26628797, 
+26771963, 
+26915128, 
+27058294, 
+27201460, 
+27344625, 
+27487791, 
+27630956, 
+27774122, 
+27917287, 
+28060453, 
+28203619, 
+28346784, 
+28489950, 
+28633115, 
+28776281, 
+28919446, 
+29062612, 
+29205778, 
+29348943, 
+29492109, 
+29635274, 
+29778440, 
+29921605, 
+30064771, 
+30207937, 
+30351102, 
+30494268, 
+30637433, 
+30780599, 
+30923765, 
+31066930, 
+31210096, 
+31353261, 
+31496427, 
+31639592, 
+31782758, 
+31925924, 
+32069089, 
+32212255, 
+32355420, 
+32498586, 
+32641751, 
+32784917, 
+32928083, 
+33071248, 
+33214414, 
+33357579, 
+33500745, 
+33643910, 
+33787076, 
+33930242, 
+34073407, 
+34216573, 
+34359738, 
+34502904, 
+34646070, 
+34789235, 
+34932401, 
+35075566, 
+35218732, 
+35361897, 
+35505063, 
+35648229, 
+35791394, 
+35934560, 
+36077725, 
+36220891, 
+36364056, 
+36507222, 
+36650388, 
+36793553, 
+36936719, 
+37079884, 
+37223050, 
+37366215, 
+37509381, 
+37652547, 
+};
@@ -0,0 +1,130 @@
+#include <xc.h>
+#include "d-ticker.h"
+
+/*
+ ISR execution time measurement, built when ISR_TIMING is defined. Timer 1
+ free runs at the instruction clock, so times are in instruction cycles. 
+ Each path through the ISR is timed from the end of the previous path (or 
+ ISR entry), so it includes the test of any flags before it. The time for
+ saving and restoring context on entry and exit is not included.
+ 
+ For each source the ISR keeps the longest time and the total time and 
+ count for the average. An overrun is counted when the whole ISR takes 
+ longer than TIMING_BUDGET.
+ 
+ The main loop asks for a snapshot of the stats by setting snap_pending. 
+ The ISR copies them on its way out, restarts the totals and clears the 
+ flag, so the main loop never sees stats that are half updated. Averages 
+ are over the time since the last snapshot.
+ */
+////////////////////////////////////////////////////////////////////////////////
+// Read timer 1 while it is running, for the ISR timing and the scheduler. 
+// The high byte is read again in case the low byte overflowed into it part
+// way through
+unsigned int timing_read_timer() {
+    byte hi, lo;
+    do {
+        hi = TMR1H;
+        lo = TMR1L;
+    } while(hi != TMR1H);
+    return ((unsigned int)hi << 8) | lo;
+}
+
+#ifdef ISR_TIMING
+
+enum {
+    TIMING_BUDGET = 1000        // cycles, a quarter of the 1ms tick
+};
+
+typedef struct {
+    unsigned int max[ISR_NUM_SOURCES];
+    unsigned long total[ISR_NUM_SOURCES];
+    unsigned int count[ISR_NUM_SOURCES];
+    unsigned int overruns;
+} TIMING_STATS;
+
+struct {
+    unsigned int isr_start;     // timer 1 at ISR entry
+    unsigned int path_start;    // timer 1 at the start of the current path
+    TIMING_STATS stats;
+} timing;
+
+ISR_NEAR volatile byte timing_snap_pending;
+TIMING_STATS timing_snap;       // owned by the main loop while not pending
+
+////////////////////////////////////////////////////////////////////////////////
+void timing_init() {
+    for(byte i=0; i<ISR_NUM_SOURCES; ++i) {
+        timing.stats.max[i] = 0;
+        timing.stats.total[i] = 0;
+        timing.stats.count[i] = 0;
+    }
+    timing.stats.overruns = 0;
+    timing_snap_pending = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// called at the start of the ISR
+inline void timing_isr_enter() {
+    timing.isr_start = timing_read_timer();
+    timing.path_start = timing.isr_start;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// called at the end of the ISR path for a source
+inline void timing_path_end(byte source) {
+    unsigned int now = timing_read_timer();
+    unsigned int elapsed = now - timing.path_start;
+    timing.path_start = now;
+    if(elapsed > timing.stats.max[source]) {
+        timing.stats.max[source] = elapsed;
+    }
+    timing.stats.total[source] += elapsed;
+    ++timing.stats.count[source];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// called at the end of the ISR
+inline void timing_isr_exit() {
+    if((unsigned int)(timing_read_timer() - timing.isr_start) > TIMING_BUDGET) {
+        ++timing.stats.overruns;
+    }
+    if(timing_snap_pending) {
+        timing_snap = timing.stats;
+        for(byte i=0; i<ISR_NUM_SOURCES; ++i) {
+            timing.stats.total[i] = 0;
+            timing.stats.count[i] = 0;
+        }
+        timing_snap_pending = 0;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void timing_request_snapshot() {
+    timing_snap_pending = 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+byte timing_snapshot_ready() {
+    return !timing_snap_pending;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+unsigned int timing_get_max(byte source) {
+    return timing_snap.max[source];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+unsigned int timing_get_average(byte source) {
+    if(!timing_snap.count[source]) {
+        return 0;
+    }
+    return (unsigned int)(timing_snap.total[source] / timing_snap.count[source]);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+unsigned int timing_get_overruns() {
+    return timing_snap.overruns;
+}
+
+#endif
@@ -0,0 +1,152 @@
+#include <xc.h>
+#include "d-ticker.h"
+#include "uart_debug.h"
+
+/*
+ Event trace, built when TRACE and UART_DEBUG are defined. Each event is 
+ sent as a frame (see uart_debug.c) timestamped with a 16 bit ms count 
+ plus timer 0's count within the ms (4us units, 0..250).
+ 
+ Events in the ISR are put in a small queue, which costs the same few 
+ cycles whatever the UART is doing. trace_run() moves them into the UART
+ ring on each ms tick. Main loop events go straight into the UART ring. 
+ An event which finds no room is dropped and counted, and the count is 
+ sent in a TRACE_DROPS frame once there is room again.
+ */
+#ifdef TRACE
+
+enum {
+    TRACE_QUEUE_SIZE = 8,       // events queued by ISR, must be a power of 2
+    TRACE_TMR0_START = 5        // timer 0 count at the start of each ms
+};
+
+typedef struct {
+    byte type;
+    byte ms_lo;
+    byte ms_hi;
+    byte sub_ms;
+    byte data;
+} TRACE_EVENT_DEF;
+
+volatile unsigned int trace_ms;     // incremented by ISR each ms
+
+// written by ISR only
+struct {
+    TRACE_EVENT_DEF queue[TRACE_QUEUE_SIZE];
+    volatile byte head;         // next event to queue
+    volatile byte drops;        // events dropped because queue was full
+} trace_isr;
+
+// main loop state
+struct {
+    volatile byte tail;         // next queued event to send
+    byte drops_seen;            // trace_isr.drops already reported
+    byte drops;                 // dropped events not yet reported
+} trace;
+
+////////////////////////////////////////////////////////////////////////////////
+static void timestamp(TRACE_EVENT_DEF *event) {
+    unsigned int ms;
+    byte sub_ms;
+    do {
+        ms = trace_ms;
+        sub_ms = TMR0 - TRACE_TMR0_START;
+    } while(ms != trace_ms);
+    event->ms_lo = (byte)ms;
+    event->ms_hi = (byte)(ms>>8);
+    event->sub_ms = sub_ms;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// queue a frame on the UART, or return 0 if there is no room for all of it
+static byte send_frame(TRACE_EVENT_DEF *event) {
+    return uart_send_frame(event->type, 
+        event->ms_lo | ((unsigned int)event->ms_hi << 8), 
+        event->sub_ms, event->data);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static void count_drop() {
+    if(trace.drops < 255) {
+        ++trace.drops;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void trace_init() {
+    trace_ms = 0;
+    trace_isr.head = 0;
+    trace_isr.drops = 0;
+    trace.tail = 0;
+    trace.drops_seen = 0;
+    trace.drops = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// called every ms by interrupt
+inline void trace_ms_isr() {
+    ++trace_ms;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// log an event from interrupt context
+inline void trace_event_isr(byte type, byte data) {
+    byte head = trace_isr.head;
+    if((byte)(head - trace.tail) >= TRACE_QUEUE_SIZE) {
+        ++trace_isr.drops;
+        return;
+    }
+    TRACE_EVENT_DEF *event = &trace_isr.queue[head & (TRACE_QUEUE_SIZE-1)];
+    event->type = type;
+    event->ms_lo = (byte)trace_ms;
+    event->ms_hi = (byte)(trace_ms>>8);
+    event->sub_ms = TMR0 - TRACE_TMR0_START;
+    event->data = data;
+    trace_isr.head = head + 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// log an event from the main loop
+void trace_event(byte type, byte data) {
+    TRACE_EVENT_DEF event;
+    timestamp(&event);
+    event.type = type;
+    event.data = data;
+    if(!send_frame(&event)) {
+        count_drop();
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Called every ms to send the events queued by the ISR. Events stay queued 
+// until there is room for them on the UART
+void trace_run() {
+    while(trace.tail != trace_isr.head) {
+        if(!send_frame(&trace_isr.queue[trace.tail & (TRACE_QUEUE_SIZE-1)])) {
+            break;
+        }
+        ++trace.tail;
+    }
+    
+    // report any dropped events
+    byte drops = trace_isr.drops;
+    byte isr_drops = drops - trace.drops_seen;
+    trace.drops_seen = drops;
+    if((byte)(trace.drops + isr_drops) < trace.drops) {
+        trace.drops = 255;
+    }
+    else {
+        trace.drops += isr_drops;
+    }
+    if(trace.drops) {
+        TRACE_EVENT_DEF event;
+        timestamp(&event);
+        event.type = TRACE_DROPS;
+        event.data = trace.drops;
+        if(send_frame(&event)) {
+            trace.drops = 0;
+        }
+    }
+}
+
+#endif
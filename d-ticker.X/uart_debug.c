@@ -1,6 +1,30 @@
 #include <xc.h>
 #include "uart_debug.h"
 
+/*
+ Bytes sent are queued in a ring buffer and fed to the UART by the TX 
+ interrupt, so sending never waits for the UART. If the ring is full the
+ byte is dropped and counted. Only the main loop queues bytes (head) and 
+ only the ISR takes them (tail), so no need to disable interrupts.
+ 
+ Events are sent as 7 byte frames:
+ 
+    0xA5, type, ms low, ms high, sub-ms, data, checksum
+ 
+ where type is one of TRACE_xxx and the checksum is the sum of the 5 bytes
+ after 0xA5, so a reader can find the frames in a stream which also has 
+ text in it.
+ */
+enum {
+    UART_FRAME_SYNC = 0xA5      // first byte of each frame
+};
+struct {
+    byte buf[UART_TX_SIZE];
+    volatile byte head;         // next byte to queue, main loop only
+    volatile byte tail;         // next byte to send, ISR only
+    unsigned int drops;         // bytes dropped because the ring was full
+} uart_tx;
+
 ////////////////////////////////////////////////////////////
 // INITIALISE SERIAL PORT FOR MIDI
 void uart_init()
@@ -8,7 +32,7 @@ void uart_init()
     PIR1bits.TXIF = 0;
     PIR1bits.RCIF = 0;
     PIE1bits.TXIE = 0;
-    PIE1bits.RCIE = 1;
+    PIE1bits.RCIE = 0;      // nothing is received
 
     BAUDCONbits.SCKP = 0;//synchronous bit polarity 
     BAUDCONbits.BRG16 = 0;// enable 16 bit brg
@@ -29,12 +53,76 @@ void uart_init()
 
     SPBRGH = 0;// brg high byte
     SPBRG = 25;// brg low byte 
+    
+    uart_tx.head = 0;
+    uart_tx.tail = 0;
+    uart_tx.drops = 0;
 }
 
 void uart_send(byte ch) 
 {
-	TXREG = ch;
-	while(!TXSTAbits.TRMT);
+	byte head = uart_tx.head;
+	if((byte)(head - uart_tx.tail) >= UART_TX_SIZE) {
+		++uart_tx.drops;
+		return;
+	}
+	uart_tx.buf[head & (UART_TX_SIZE-1)] = ch;
+	uart_tx.head = head + 1;
+	PIE1bits.TXIE = 1;
+}
+
+// number of bytes which can be queued without any being dropped
+byte uart_tx_free() 
+{
+	return UART_TX_SIZE - (byte)(uart_tx.head - uart_tx.tail);
+}
+
+unsigned int uart_get_drops() 
+{
+	return uart_tx.drops;
+}
+
+// true when everything queued has been sent
+byte uart_tx_idle() 
+{
+	return uart_tx.head == uart_tx.tail && TXSTAbits.TRMT;
+}
+
+// give the TX pin back to the port (the clock output)
+void uart_stop() 
+{
+	RCSTAbits.SPEN = 0;
+}
+
+// queue an event frame, or return 0 if there is no room for all of it
+byte uart_send_frame(byte type, unsigned int ms, byte sub_ms, byte data) 
+{
+	if(uart_tx_free() < UART_FRAME_SIZE) {
+		return 0;
+	}
+	byte ms_lo = (byte)ms;
+	byte ms_hi = (byte)(ms>>8);
+	uart_send(UART_FRAME_SYNC);
+	uart_send(type);
+	uart_send(ms_lo);
+	uart_send(ms_hi);
+	uart_send(sub_ms);
+	uart_send(data);
+	uart_send(type + ms_lo + ms_hi + sub_ms + data);
+	return 1;
+}
+
+// called by interrupt when the UART is ready for the next byte
+void uart_tx_isr() 
+{
+	byte tail = uart_tx.tail;
+	if(tail != uart_tx.head) {
+		TXREG = uart_tx.buf[tail & (UART_TX_SIZE-1)];
+		uart_tx.tail = ++tail;
+	}
+	if(tail == uart_tx.head) {
+		PIE1bits.TXIE = 0;
+	}
 }
 
 void uart_send_string(byte *ch) 
@@ -1,8 +1,21 @@
-typedef unsigned char byte;
+#ifndef UART_DEBUG_H
+#define UART_DEBUG_H
+#include "d-ticker.h"
+enum {
+    UART_TX_SIZE = 64,          // bytes queued, must be a power of 2
+    UART_FRAME_SIZE = 7         // bytes in an event frame
+};
 void uart_init();
 void uart_send(byte ch);
+byte uart_tx_free(void);
+unsigned int uart_get_drops(void);
+void uart_tx_isr(void);
+byte uart_tx_idle(void);
+void uart_stop(void);
+byte uart_send_frame(byte type, unsigned int ms, byte sub_ms, byte data);
 void uart_send_string(byte *ch) ;
 void uart_send_number(int ch);
 void uart_send_long(long ch);
 void uart_send_hex(unsigned long ch);
 void uart_send_binary(unsigned long data);
+#endif /* UART_DEBUG_H */
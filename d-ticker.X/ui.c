@@ -20,6 +20,14 @@ static const byte num_trigs_menu[4] = {
     32
 };
 
+// curves mapped to the menu
+static const byte curve_menu[4] = {
+    PAT_CURVE_CLASSIC,
+    PAT_CURVE_TAN,
+    PAT_CURVE_EXP,
+    PAT_CURVE_LINEAR
+};
+
 // reset modss mapped to the menu
 static const byte reset_mode_menu[4] = { 
     RESET_MODE_RESTART, 
@@ -27,125 +35,149 @@ static const byte reset_mode_menu[4] = {
     RESET_MODE_RUN, 
     RESET_MODE_RESTART_RUN 
 };
+// the options set in the menus. The first four are the menus themselves, 
+// each opened and set with the pot of the same number
 enum {
     UI_NUM_PULSES,
     UI_NUM_TRIGS,
     UI_RESET_MODE,
     UI_BPM,
-    UI_PATTERN
+    UI_CURVE,
+    UI_NUM_BARS,
+    UI_PATTERN,                 // not in a menu
+    UI_NONE = UI_PATTERN
+};
+
+// a menu can have a second option, set with the next pot
+static const byte second_option[4] = {
+#ifdef LONG_PHASE
+    UI_NUM_BARS,
+#else
+    UI_NONE,
+#endif
+    UI_CURVE,
+    UI_NONE,
+    UI_NONE
 };
 
+// the pot which sets each option
+static const byte option_pot[UI_NUM_BARS + 1] = {
+    0, 
+    1, 
+    2, 
+    3, 
+    2,
+    1
+};
+
+// timeouts are counted in calls to ui_run(), every UI_RUN_MS
 static const int DEBOUNCE_MS = 20;
 static const int DOUBLE_CLICK_MS = 200;
 static const int POT_MOVE_TIMEOUT_MS = 200;
+static const int DUMP_HOLD_MS = 2000;      // hold button to dump black box
+static const int LOAD_SHOW_MS = 1000;      // time each load is shown for
+static const int LOAD_BLINK_MS = 100;      // ISR load blink rate
 
 static struct {
-    volatile byte mode;                      // are we in a "menu"
+    volatile byte mode;                      // menu (pot) or UI_PATTERN
+    byte option;                             // option shown in the menu
+    byte options_changed;                    // bit mask of options to set
     volatile byte pot_move_done;                  // has a pot been moved but not actioned?
+    volatile byte pots_changed;              // bit mask of pots moved since last recalc
     volatile byte button_state;              // is button pressed?
     volatile int debounce_timeout;           // counter for debouncing button
     volatile int double_click_timeout;       // counter for timing double click
     volatile int pot_move_timeout;       
+    int hold_timeout;                        // counter for button hold
+    byte dump_armed;                         // can a hold dump the black box
+    byte load_meter;                         // showing CPU load on the LEDs
+    int load_timeout;                        // counter for load display
 } ui;
 
 
 ////////////////////////////////////////////////////////////////////////////////
 void ui_init() {
     ui.mode = UI_PATTERN;
+    ui.option = UI_NONE;
+    ui.options_changed = 0;
     ui.button_state = 0;
     ui.debounce_timeout = 0;
     ui.double_click_timeout = 0;
     ui.pot_move_timeout = 0;
     ui.pot_move_done = 0;
+    ui.pots_changed = 0;
+    // outside of UART_DEBUG builds a dump takes over the clock output jack,
+    // so holding the button only dumps if it was also held at power up. 
+    // The hold is timed from when the button is next pressed
+    ui.hold_timeout = 0;
+#ifdef UART_DEBUG
+    ui.dump_armed = 1;
+#else
+    ui.dump_armed = !P_SWITCH;
+#endif
+    ui.load_meter = 0;
+    ui.load_timeout = 0;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-void xui_run() {
-    
-    // deal with the switch state
-    if(!ui.debounce_timeout) {
-        byte button_state = !P_SWITCH;
-        if(button_state != ui.button_state) {
-            ui.button_state = button_state;
-            ui.debounce_timeout = DEBOUNCE_MS;            
-            if(ui.double_click_timeout) {
-                // double clicking the button forces a restart 
-                seq_set_reset_mode(RESET_MODE_RESTART);
-//                clk_restart();
-                ui.double_click_timeout = 0;
-                
-            }
-            else if(button_state) {
-                ui.double_click_timeout = DOUBLE_CLICK_MS;
-            }            
-        }
+// Apply and save the option chosen in a menu. The pot reading selects one of
+// 4 choices, except for the BPM which uses the whole reading
+static void set_option(byte which, byte pot_reading) {
+    byte option = pot_reading/64;
+    switch(which) {
+        case UI_NUM_PULSES:
+            clk_set_num_steps(num_pulses_menu[option]);
+            store_set_num_steps(num_pulses_menu[option]);
+            break;
+        case UI_NUM_BARS:
+            // 1, 2, 4 or 8 bars
+            clk_set_num_bars(1 << option);
+            store_set_num_bars(1 << option);
+            break;
+        case UI_NUM_TRIGS:
+            // the active table must have the new number of trigs before 
+            // the sequencer next reads it
+            pat_set_num_trigs(num_trigs_menu[option]);
+            pat_recalc();
+            store_set_num_trigs(num_trigs_menu[option]);
+            break;
+        case UI_CURVE:
+            pat_set_curve(curve_menu[option]);
+            pat_recalc();
+            store_set_curve(curve_menu[option]);
+            break;
+        case UI_RESET_MODE:
+            seq_set_reset_mode(reset_mode_menu[option]);
+            store_set_reset_mode(reset_mode_menu[option]);
+            break;
+        case UI_BPM:
+            clk_set_bpm(MIN_BPM+2*pot_reading);
+            store_set_bpm(MIN_BPM+2*pot_reading);
+            break;
     }
-    
-    // has a pot moved since the last call?
-    int cur_pot = pots_moved();
-    if(cur_pot >= 0) {
-        ui.pot_move_timeout = POT_MOVE_TIMEOUT_MS;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Show the CPU load as a bar of 1 LED per 25%, the main loop for a second 
+// and then the ISR (blinking) for a second
+static void show_load() {
+    if(!ui.load_timeout) {
+        ui.load_timeout = 2*LOAD_SHOW_MS/UI_RUN_MS;
     }
-    
-    // are we in the normal running mode?
-    if(ui.mode == UI_PATTERN) {
-                
-        if(ui.button_state && cur_pot >= 0) {
-            // pot moved with a button held so enter the menu mode
-            ui.mode = (byte)cur_pot;
-        }
-        else {
-            // normal running mode
-            int cur_trig = seq_get_output_trig();
-            if(cur_trig >= 0) {
-                leds_set_pos((byte)((4*cur_trig)/pat_get_num_trigs()), 
-                    (cur_trig%4) ? SHORT_LED_BLINK_MS : MED_LED_BLINK_MS
-                );
-            }
-            // recalculate the pattern if a pot moves
-            if(ui.pot_move_done) {
-                ui.pot_move_done = 0;
-                pat_recalc();
-            }
-        }      
+    --ui.load_timeout;
+    byte load;
+    if(ui.load_timeout >= LOAD_SHOW_MS/UI_RUN_MS) {
+        load = sched_get_load_main();
+    }
+    else if((ui.load_timeout / (LOAD_BLINK_MS/UI_RUN_MS)) & 1) {
+        load = sched_get_load_isr();
     }
     else {
-        // read the pot for this menu
-        byte pot_reading = pots_reading(ui.mode);
-        byte option = pot_reading/64;
-        leds_set_pos(option,0);
-        
-        // has a pot been moved?
-        if(ui.pot_move_done) {
-            ui.pot_move_done = 0;
-            
-            // commit the value
-            switch(ui.mode) {
-                case UI_NUM_PULSES:
-                    clk_set_num_steps(num_pulses_menu[option]);
-                    break;
-                case UI_NUM_TRIGS:
-                    pat_set_num_trigs(num_trigs_menu[option]);
-                    break;
-                case UI_RESET_MODE:
-                    seq_set_reset_mode(reset_mode_menu[option]);
-                    break;
-                case UI_BPM:
-                    clk_set_bpm(15+2*pot_reading);
-                    break;
-            }
-
-            // when button is released, exit back to pattern mode
-            if(!ui.button_state) {
-                leds_clear_pos();
-                ui.mode = UI_PATTERN;
-            }
-        }
+        load = 0;
     }
+    leds_set_bar((load + 24) / 25);
 }
 
-
-
 ////////////////////////////////////////////////////////////////////////////////
 void ui_run() {
     if(ui.debounce_timeout) {
@@ -159,15 +191,105 @@ void ui_run() {
             ui.pot_move_done = 1;
         }
     }    
+    if(!ui.debounce_timeout) {
+        byte button_state = !P_SWITCH;
+        if(button_state != ui.button_state) {
+            ui.button_state = button_state;
+            ui.debounce_timeout = DEBOUNCE_MS/UI_RUN_MS;
+            if(button_state) {
+                if(ui.double_click_timeout) {
+                    // double clicking the button switches the CPU load 
+                    // meter on or off
+                    ui.double_click_timeout = 0;
+                    ui.load_meter = !ui.load_meter;
+                    ui.load_timeout = 0;
+                    leds_set_bar(0);
+                }
+                else {
+                    ui.double_click_timeout = DOUBLE_CLICK_MS/UI_RUN_MS;
+                }
+            }
+        }
+    }
     // has a pot moved since the last call?
-    int cur_pot = pots_moved();
-    if(cur_pot >= 0) {
+    byte moved = pots_moved();
+    if(moved) {
         ui.pot_move_done = 0;
-        ui.pot_move_timeout = POT_MOVE_TIMEOUT_MS;
+        ui.pots_changed |= moved;
+        ui.pot_move_timeout = POT_MOVE_TIMEOUT_MS/UI_RUN_MS;
+        if(ui.button_state) {
+            // turning a pot with the button held opens the menu for that 
+            // pot's setting, and is not a hold for the black box
+            ui.hold_timeout = 0;
+            if(ui.mode == UI_PATTERN) {
+                byte pots = moved;
+                ui.mode = 0;
+                while(!(pots & 1)) {
+                    pots >>= 1;
+                    ++ui.mode;
+                }
+            }
+        }
+        if(ui.mode != UI_PATTERN) {
+            // in a menu its own pot sets its option and the next pot the 
+            // second option, if it has one. Other pots do nothing until the 
+            // menu is left
+            if(moved & (1 << ui.mode)) {
+                ui.option = ui.mode;
+                ui.options_changed |= (1 << ui.mode);
+            }
+            byte second = second_option[ui.mode];
+            if(second != UI_NONE && (moved & (1 << option_pot[second]))) {
+                ui.option = second;
+                ui.options_changed |= (1 << second);
+            }
+        }
     }
-    // recalculate the pattern if a pot moves
-    if(ui.pot_move_done) {
-        ui.pot_move_done = 0;
-        pat_recalc();
+    if(ui.mode != UI_PATTERN) {
+        // show the last option turned on a bar of LEDs, and set the options
+        // when the pots stop
+        leds_set_bar(pots_reading(option_pot[ui.option])/64 + 1);
+        if(ui.pot_move_done) {
+            ui.pot_move_done = 0;
+            for(byte which = 0; which <= UI_NUM_BARS; ++which) {
+                if(ui.options_changed & (1 << which)) {
+                    set_option(which, pots_reading(option_pot[which]));
+                }
+            }
+            ui.options_changed = 0;
+        }
+        // once the button is released and the pots have stopped, go back 
+        // to the pattern. It follows any pots turned in the menu, so that 
+        // it always matches the pot readings
+        if(!ui.button_state && !ui.pot_move_timeout) {
+            leds_set_bar(0);
+            ui.mode = UI_PATTERN;
+            ui.option = UI_NONE;
+            ui.load_timeout = 0;
+            pat_recalc_pots(ui.pots_changed);
+            ui.pots_changed = 0;
+        }
+    }
+    else {
+        if(ui.pot_move_done) {
+            // recalculate the parts of the pattern belonging to the moved pots
+            ui.pot_move_done = 0;
+            pat_recalc_pots(ui.pots_changed);
+            ui.pots_changed = 0;
+        }
+        if(ui.load_meter) {
+            show_load();
+        }
+    }
+    
+    // holding the button down dumps the black box, if armed
+    if(ui.button_state) {
+        if(ui.hold_timeout && !--ui.hold_timeout && ui.dump_armed) {
+            bbox_dump();
+        }
+    }
+    else {
+        ui.hold_timeout = DUMP_HOLD_MS/UI_RUN_MS;
     }
+    bbox_run();
 }
@@ -0,0 +1,32 @@
+/*
+ Generates d-ticker.X/tempo.h, the table the clock uses to look up its 
+ phase increment when the BPM is changed, so that the firmware does no 
+ division at run time.
+ 
+    gcc -o gen_tempo gen_tempo.c
+    ./gen_tempo > ../d-ticker.X/tempo.h
+ 
+ Keep the constants here in step with the firmware: the BPM mapping in 
+ clock.c, and the 32 bit phase which covers one cycle of the pattern.
+ */
+#include <stdio.h>
+
+#define PHASE_CYCLE     4294967296.0    // phase per pattern cycle
+#define BPM_MIN         16              // BPM for option 0
+#define BPM_STEP        2               // BPM added for each option
+#define BPM_OPTIONS     256
+
+int main() {
+    printf("// Generated by host/gen_tempo.c - do not edit\n\n");
+    
+    printf("// phase per ms for a one step pattern at BPM %d + %d * index. Shift\n", 
+        BPM_MIN, BPM_STEP);
+    printf("// right by log2 of the number of steps in the pattern\n");
+    printf("const unsigned long bpm_phase_per_ms[%d] = {\n", BPM_OPTIONS);
+    for(int i=0; i<BPM_OPTIONS; ++i) {
+        int bpm = BPM_MIN + BPM_STEP * i;
+        printf("%.0f, \n", PHASE_CYCLE * bpm / (60.0 * 1000.0));
+    }
+    printf("};\n");
+    return 0;
+}
@@ -0,0 +1,160 @@
+#include <xc.h>
+#include "d-ticker.h"
+#include "tan.h"
+#include "exp.h"
+#include "pat_pic.h"
+
+const char *pic_op_names[PIC_NUM_OPS] = {
+    "curve seg_step (int)",
+    "curve sum (long)",
+    "curve rate (int)",
+    "curve start rate (int)",
+    "classic rate (int)",
+    "classic len*(len-1) (int)",
+    "classic dist (long)",
+    "scale_pos rem << 8 (long)",
+    "build_pos (long)",
+    "build_rate (int)",
+    "trig beyond pos_t"
+};
+
+// values as an int or long of the PIC would hold them, wrapping as it
+// does and noting the overflow
+static unsigned overflows;
+
+static long long pic_int(long long value, int op) {
+    if(value < -32768 || value > 32767) {
+        overflows |= 1u << op;
+        value = (short)value;
+    }
+    return value;
+}
+
+static long long pic_long(long long value, int op) {
+    if(value < -2147483648LL || value > 2147483647LL) {
+        overflows |= 1u << op;
+        value = (int)value;
+    }
+    return value;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Follows pat_set_num_trigs(), calc_segment(), start_build(), 
+// start_curve_build(), continue_build() and scale_pos() step by step
+unsigned pat_pic_calc(const unsigned char *pots, int num_trigs, int curve, unsigned *table) {
+    long long seg_first[POTS_COUNT+1];
+    long long seg_acc[POTS_COUNT];
+    long long seg_step[POTS_COUNT];
+    overflows = 0;
+
+    for(int i=0; i<=POTS_COUNT; ++i) {
+        seg_first[i] = (i*num_trigs + POTS_COUNT - 1)/POTS_COUNT;
+    }
+    int trigs_shift = 0;
+    for(int i=0; i<=6; ++i) {
+        if(num_trigs == (1<<i)) {
+            trigs_shift = i;
+        }
+    }
+
+    for(int i=0; i<POTS_COUNT; ++i) {
+        int reading = pots[i];
+        if(curve == PAT_CURVE_CLASSIC) {
+            seg_acc[i] = 128 - reading;
+            continue;
+        }
+        int index = (reading > 127) ? reading - 128 : 127 - reading;
+        int slope;
+        switch(curve) {
+            case PAT_CURVE_TAN: slope = tan_table[index]; break;
+            case PAT_CURVE_EXP: slope = exp_table[index]; break;
+            default: slope = 2*index; break;
+        }
+        seg_acc[i] = (reading > 127) ? -slope : slope;
+    }
+
+    int build_curve;
+    long long build_rate;
+    long long build_dist = 0;
+    if(curve != PAT_CURVE_CLASSIC && trigs_shift >= 2) {
+        int seg_shift = trigs_shift - 2;
+        for(int i=0; i<POTS_COUNT; ++i) {
+            seg_step[i] = pic_int(seg_acc[i] * (1 << (4 - seg_shift)), PIC_SEG_STEP);
+        }
+        long long sum = 0;
+        long long rate = 0;
+        for(int i=0; i<POTS_COUNT; ++i) {
+            long long step = seg_step[i];
+            sum = pic_long(sum + pic_long(rate * (1 << seg_shift), PIC_CURVE_SUM), PIC_CURVE_SUM);
+            if(seg_shift) {
+                long long spread = pic_long(pic_long(step * (1 << seg_shift), PIC_CURVE_SUM) - step,
+                    PIC_CURVE_SUM);
+                sum = pic_long(sum + pic_long(spread * (1 << (seg_shift - 1)), PIC_CURVE_SUM),
+                    PIC_CURVE_SUM);
+            }
+            rate = pic_int(rate + pic_int(step * (1 << seg_shift), PIC_CURVE_RATE), PIC_CURVE_RATE);
+        }
+        build_rate = pic_int(16384 - pic_int(sum >> trigs_shift, PIC_CURVE_START), PIC_CURVE_START);
+        build_curve = 1;
+    }
+    else {
+        for(int i=0; i<POTS_COUNT; ++i) {
+            seg_step[i] = seg_acc[i];
+        }
+        long long cur_rate = 128;
+        long long min_rate = 128;
+        for(int i=0; i<POTS_COUNT; ++i) {
+            cur_rate = pic_int(cur_rate + pic_int(seg_acc[i] * (seg_first[i+1] - seg_first[i]),
+                PIC_CLASSIC_RATE), PIC_CLASSIC_RATE);
+            if(cur_rate < min_rate) {
+                min_rate = cur_rate;
+            }
+        }
+        build_rate = pic_int(pic_int(128 - min_rate, PIC_CLASSIC_RATE) + 128, PIC_CLASSIC_RATE);
+        cur_rate = build_rate;
+        for(int i=0; i<POTS_COUNT; ++i) {
+            long long len = seg_first[i+1] - seg_first[i];
+            long long tri = pic_int(len * (len-1), PIC_CLASSIC_LEN) / 2;
+            long long add = pic_long(pic_long(len * cur_rate, PIC_CLASSIC_DIST) +
+                pic_long(seg_acc[i] * tri, PIC_CLASSIC_DIST), PIC_CLASSIC_DIST);
+            build_dist = pic_long(build_dist + add, PIC_CLASSIC_DIST);
+            cur_rate = pic_int(cur_rate + pic_int(seg_acc[i] * len, PIC_CLASSIC_RATE),
+                PIC_CLASSIC_RATE);
+        }
+        build_curve = 0;
+    }
+
+    long long build_pos = 0;
+    int build_seg = 0;
+    for(int trig=0; trig<num_trigs; ++trig) {
+        while(trig >= seg_first[build_seg+1]) {
+            ++build_seg;
+        }
+        long long pos;
+        if(build_curve) {
+            pos = build_pos >> (trigs_shift - 2);
+        }
+        else {
+            long long rem = build_pos;
+            pos = 0;
+            for(int i=0; i<2; ++i) {
+                rem = rem * 256;
+                if(rem < 0 || rem > 2147483647LL) {
+                    overflows |= 1u << PIC_SCALE;
+                }
+                pos = (pos << 8) | (build_dist ? rem / build_dist : 0);
+                rem = build_dist ? rem % build_dist : 0;
+            }
+            if(rem < build_pos) {
+                --pos;
+            }
+        }
+        if(pos < 0 || pos > 0xFFFF) {
+            overflows |= 1u << PIC_TRIG_POS;
+        }
+        table[trig] = (unsigned)pos & 0xFFFF;
+        build_pos = pic_long(build_pos + build_rate, PIC_BUILD_POS);
+        build_rate = pic_int(build_rate + seg_step[build_seg], PIC_BUILD_RATE);
+    }
+    return overflows;
+}
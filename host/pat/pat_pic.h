@@ -0,0 +1,32 @@
+/*
+ The pattern calculation of d-ticker.X/pattern.c redone with the integer
+ widths of XC8 on the PIC (16 bit int, 32 bit long), noting every
+ intermediate value which does not fit. On the host int is 32 bits and
+ long 64, so a build of pattern.c here never overflows where the module
+ can; this shows where the module's tables differ from the host's.
+ */
+#ifndef PAT_PIC_H
+#define PAT_PIC_H
+
+enum {
+    PIC_SEG_STEP,       // curve engine: seg_acc << (4 - seg_shift)
+    PIC_CURVE_SUM,      // curve engine: sum of the velocities (long)
+    PIC_CURVE_RATE,     // curve engine: rate and step << seg_shift (int)
+    PIC_CURVE_START,    // curve engine: start velocity (int)
+    PIC_CLASSIC_RATE,   // classic: velocities at the segment boundaries (int)
+    PIC_CLASSIC_LEN,    // classic: len * (len-1) (int)
+    PIC_CLASSIC_DIST,   // classic: total distance (long)
+    PIC_SCALE,          // classic: 65535 * pos in scale_pos() (unsigned long)
+    PIC_BUILD_POS,      // distance to the trig (long)
+    PIC_BUILD_RATE,     // velocity at the trig (int)
+    PIC_TRIG_POS,       // trig position beyond the range of pos_t
+    PIC_NUM_OPS
+};
+
+extern const char *pic_op_names[PIC_NUM_OPS];
+
+// fills the trig table as the module would calculate it and returns a bit
+// (1 << PIC_xxx) for each kind of overflow on the way
+unsigned pat_pic_calc(const unsigned char *pots, int num_trigs, int curve, unsigned *table);
+
+#endif
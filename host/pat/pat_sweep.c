@@ -0,0 +1,433 @@
+/*
+ Checks a new version of the pattern calculation (d-ticker.X/pattern.c)
+ against the original over every setting of the pots, for each trig count
+ and curve, and shows where the module's integer widths overflow.
+
+    make -C host -B pat_sweep PAT_REF=original.c PAT_NEW=new.c
+    pat_sweep [options]
+
+ PAT_REF (by default pat/pattern_ref.c, the first firmware's calculation)
+ and PAT_NEW (by default pattern.c) are built into pat_ref.so and
+ pat_new.so (see pat_unit.c). Each case is a setting of the four pots, a
+ trig count and a curve, for which the trig tables of the two must be the
+ same. Curves the reference does not have are only counted. The new 
+ tables are also worked out with the module's 16 bit int and 32 bit long
+ by pat_pic.c, which counts the cases where an intermediate value 
+ overflows and where that changes the table.
+
+ The cases are split into units of a setting of the first two pots and
+ run by worker processes (the firmware's state is global, so one case at a
+ time per process), which take the next unit as they finish one. Every
+ setting of all four pots is 2^32 settings, so the sweep can be thinned
+ with -v or split over machines with -S.
+
+ Options:
+    -n list     trig counts (default 4,8,16,32,64)
+    -c list     curves (default 0,1,2,3)
+    -v step     pot readings 0, step, 2*step... and 255 (default 1, every one)
+    -S i/n      run the i'th (from 0) of n shards, every n'th unit from i
+    -j workers  (default one per processor)
+    -x count    examples of each kind to print (default 5)
+    -r file     reference library (default pat_ref.so beside pat_sweep)
+    -w file     new library (default pat_new.so beside pat_sweep)
+    -q          no progress on stderr
+
+ Examples are the first cases in sweep order, so the report is the same
+ for any number of workers. Exits with 1 if the tables differ anywhere.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <dlfcn.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include "pat_pic.h"
+
+enum {
+    MAX_TRIGS = 64,
+    MAX_CASE_TRIGS = 16,    // entries in a trig count list
+    MAX_CURVES = 4,
+    MAX_EXAMPLES = 32
+};
+
+typedef int (*PAT_CALC)(const unsigned char *pots, int num_trigs, int curve, unsigned *table);
+
+typedef struct {
+    unsigned long long id;      // position in the sweep
+    unsigned char pots[4];
+    int num_trigs;
+    int curve;
+    int trig;                   // first trig which differs
+    unsigned a;                 // its position in the reference table
+    unsigned b;                 // and in the new (or PIC) table
+    unsigned ops;               // PIC overflows, 1 << PIC_xxx
+} EXAMPLE;
+
+// what a worker found, in shared memory
+typedef struct {
+    unsigned long long cases;
+    unsigned long long mismatches;
+    unsigned long long no_ref;              // curve not in the reference
+    unsigned long long overflow_cases;
+    unsigned long long op_cases[PIC_NUM_OPS];
+    unsigned long long pic_diffs;           // PIC table differs from new
+    unsigned long long pic_unexplained;     // ... without any overflow
+    int num_mismatch;
+    EXAMPLE mismatch[MAX_EXAMPLES];
+    int num_op[PIC_NUM_OPS];
+    EXAMPLE op[PIC_NUM_OPS][MAX_EXAMPLES];
+    int num_unexplained;
+    EXAMPLE unexplained[MAX_EXAMPLES];
+} RESULTS;
+
+typedef struct {
+    unsigned long long next_unit;       // next of the shard's units to take
+    unsigned long long cases_done;
+    RESULTS worker[];
+} SHARED;
+
+static int trig_list[MAX_CASE_TRIGS] = { 4, 8, 16, 32, 64 };
+static int num_trig_list = 5;
+static int curve_list[MAX_CURVES] = { 0, 1, 2, 3 };
+static int num_curve_list = 4;
+static unsigned char values[256];       // pot readings swept
+static int num_values;
+static int max_examples = 5;
+static PAT_CALC calc_ref;
+static PAT_CALC calc_new;
+
+////////////////////////////////////////////////////////////////////////////////
+static int parse_list(const char *s, int *list, int max, int lo, int hi) {
+    int n = 0;
+    while(*s) {
+        char *end;
+        long v = strtol(s, &end, 10);
+        if(end == s || v < lo || v > hi || n == max) {
+            return 0;
+        }
+        list[n++] = (int)v;
+        s = (*end == ',') ? end + 1 : end;
+        if(*end && *end != ',') {
+            return 0;
+        }
+    }
+    return n;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static PAT_CALC load_calc(const char *path, const char *def) {
+    char buf[4096];
+    if(!path) {
+        ssize_t n = readlink("/proc/self/exe", buf, sizeof(buf) - 1);
+        buf[(n > 0) ? n : 0] = 0;
+        char *slash = strrchr(buf, '/');
+        char *name = slash ? slash + 1 : buf;
+        snprintf(name, sizeof(buf) - (name - buf), "%s", def);
+        path = buf;
+    }
+    void *handle = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+    PAT_CALC calc = handle ? (PAT_CALC)dlsym(handle, "pat_unit_calc") : NULL;
+    if(!calc) {
+        fprintf(stderr, "%s\n", dlerror());
+        exit(1);
+    }
+    return calc;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Examples are found in sweep order, so the first max_examples are kept
+static void add_example(EXAMPLE *list, int *count, unsigned long long id,
+    const unsigned char *pots, int num_trigs, int curve, const unsigned *a,
+    const unsigned *b, unsigned ops)
+{
+    if(*count >= max_examples) {
+        return;
+    }
+    EXAMPLE *e = &list[(*count)++];
+    e->id = id;
+    memcpy(e->pots, pots, 4);
+    e->num_trigs = num_trigs;
+    e->curve = curve;
+    e->trig = 0;
+    while(e->trig < num_trigs - 1 && a[e->trig] == b[e->trig]) {
+        ++e->trig;
+    }
+    e->a = a[e->trig];
+    e->b = b[e->trig];
+    e->ops = ops;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static void run_unit(RESULTS *res, unsigned long long unit, SHARED *shared) {
+    unsigned char pots[4];
+    unsigned ref[MAX_TRIGS], test[MAX_TRIGS], pic[MAX_TRIGS];
+    pots[0] = values[unit / num_values];
+    pots[1] = values[unit % num_values];
+    unsigned long long id = unit * num_values * num_values * num_trig_list * num_curve_list;
+    unsigned long long cases = 0;
+    for(int i2=0; i2<num_values; ++i2) {
+        pots[2] = values[i2];
+        for(int i3=0; i3<num_values; ++i3) {
+            pots[3] = values[i3];
+            for(int t=0; t<num_trig_list; ++t) {
+                int num_trigs = trig_list[t];
+                size_t len = num_trigs * sizeof(unsigned);
+                for(int c=0; c<num_curve_list; ++c, ++id) {
+                    int curve = curve_list[c];
+                    int has_ref = calc_ref(pots, num_trigs, curve, ref);
+                    calc_new(pots, num_trigs, curve, test);
+                    unsigned ops = pat_pic_calc(pots, num_trigs, curve, pic);
+                    ++cases;
+                    if(!has_ref) {
+                        ++res->no_ref;
+                    }
+                    else if(memcmp(ref, test, len)) {
+                        ++res->mismatches;
+                        add_example(res->mismatch, &res->num_mismatch, id, pots,
+                            num_trigs, curve, ref, test, ops);
+                    }
+                    if(ops) {
+                        ++res->overflow_cases;
+                        for(int op=0; op<PIC_NUM_OPS; ++op) {
+                            if(ops & (1u << op)) {
+                                ++res->op_cases[op];
+                                add_example(res->op[op], &res->num_op[op], id, pots,
+                                    num_trigs, curve, test, pic, ops);
+                            }
+                        }
+                    }
+                    if(memcmp(test, pic, len)) {
+                        ++res->pic_diffs;
+                        if(!ops) {
+                            ++res->pic_unexplained;
+                            add_example(res->unexplained, &res->num_unexplained, id, pots,
+                                num_trigs, curve, test, pic, ops);
+                        }
+                    }
+                }
+            }
+        }
+    }
+    res->cases += cases;
+    __atomic_add_fetch(&shared->cases_done, cases, __ATOMIC_RELAXED);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static void worker(SHARED *shared, RESULTS *res, unsigned long long num_units,
+    int shard, int num_shards)
+{
+    for(;;) {
+        unsigned long long k = __atomic_fetch_add(&shared->next_unit, 1, __ATOMIC_RELAXED);
+        unsigned long long unit = shard + k * num_shards;
+        if(unit >= num_units) {
+            break;
+        }
+        run_unit(res, unit, shared);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Gathers the examples of all the workers and prints the first in sweep order
+static int cmp_example(const void *a, const void *b) {
+    const EXAMPLE *ea = a;
+    const EXAMPLE *eb = b;
+    return (ea->id > eb->id) - (ea->id < eb->id);
+}
+
+static void print_examples(SHARED *shared, int num_workers, size_t offset, size_t count_offset,
+    const char *a_name, const char *b_name)
+{
+    EXAMPLE all[MAX_EXAMPLES * 256];
+    int n = 0;
+    for(int w=0; w<num_workers; ++w) {
+        const char *res = (const char *)&shared->worker[w];
+        int count = *(const int *)(res + count_offset);
+        memcpy(&all[n], res + offset, count * sizeof(EXAMPLE));
+        n += count;
+    }
+    qsort(all, n, sizeof(EXAMPLE), cmp_example);
+    for(int i=0; i<n && i<max_examples; ++i) {
+        EXAMPLE *e = &all[i];
+        printf("    pots %3d %3d %3d %3d  trigs %2d  curve %d: trig %d at %u %s, %u %s",
+            e->pots[0], e->pots[1], e->pots[2], e->pots[3], e->num_trigs, e->curve,
+            e->trig, e->a, a_name, e->b, b_name);
+        if(e->ops) {
+            printf(" (overflows:");
+            for(int op=0; op<PIC_NUM_OPS; ++op) {
+                if(e->ops & (1u << op)) {
+                    printf(" %s", pic_op_names[op]);
+                }
+            }
+            printf(")");
+        }
+        printf("\n");
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static double now() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+int main(int argc, char *argv[]) {
+    int step = 1;
+    int shard = 0;
+    int num_shards = 1;
+    int num_workers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int quiet = 0;
+    const char *ref_path = NULL;
+    const char *new_path = NULL;
+    int opt;
+    while((opt = getopt(argc, argv, "n:c:v:S:j:x:r:w:q")) != -1) {
+        int ok = 1;
+        switch(opt) {
+            case 'n':
+                ok = num_trig_list = parse_list(optarg, trig_list, MAX_CASE_TRIGS, 1, MAX_TRIGS);
+                break;
+            case 'c':
+                ok = num_curve_list = parse_list(optarg, curve_list, MAX_CURVES, 0, 3);
+                break;
+            case 'v': step = atoi(optarg); ok = (step >= 1 && step <= 255); break;
+            case 'S':
+                ok = (sscanf(optarg, "%d/%d", &shard, &num_shards) == 2 &&
+                    num_shards >= 1 && shard >= 0 && shard < num_shards);
+                break;
+            case 'j': num_workers = atoi(optarg); ok = (num_workers >= 1 && num_workers <= 256); break;
+            case 'x':
+                max_examples = atoi(optarg);
+                ok = (max_examples >= 0 && max_examples <= MAX_EXAMPLES);
+                break;
+            case 'r': ref_path = optarg; break;
+            case 'w': new_path = optarg; break;
+            case 'q': quiet = 1; break;
+            default: ok = 0; break;
+        }
+        if(!ok) {
+            fprintf(stderr, "usage: pat_sweep [-n trigs,...] [-c curves,...] [-v step] "
+                "[-S i/n] [-j workers] [-x examples] [-r ref.so] [-w new.so] [-q]\n");
+            return 1;
+        }
+    }
+    if(num_workers < 1) {
+        num_workers = 1;
+    }
+    calc_ref = load_calc(ref_path, "pat_ref.so");
+    calc_new = load_calc(new_path, "pat_new.so");
+
+    for(int v=0; v<255; v+=step) {
+        values[num_values++] = (unsigned char)v;
+    }
+    values[num_values++] = 255;
+    unsigned long long num_units = (unsigned long long)num_values * num_values;
+    unsigned long long shard_units = (num_units > (unsigned long long)shard) ?
+        (num_units - shard + num_shards - 1) / num_shards : 0;
+    unsigned long long unit_cases = (unsigned long long)num_values * num_values *
+        num_trig_list * num_curve_list;
+    unsigned long long total = shard_units * unit_cases;
+
+    size_t size = sizeof(SHARED) + num_workers * sizeof(RESULTS);
+    SHARED *shared = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if(shared == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+    double start = now();
+    fflush(NULL);
+    for(int w=0; w<num_workers; ++w) {
+        pid_t pid = fork();
+        if(pid < 0) {
+            perror("fork");
+            return 1;
+        }
+        if(pid == 0) {
+            worker(shared, &shared->worker[w], num_units, shard, num_shards);
+            _exit(0);
+        }
+    }
+    int running = num_workers;
+    int failed = 0;
+    double last = start;
+    while(running) {
+        int status;
+        pid_t pid = waitpid(-1, &status, WNOHANG);
+        if(pid > 0) {
+            --running;
+            failed |= !WIFEXITED(status) || WEXITSTATUS(status);
+            continue;
+        }
+        usleep(100000);
+        double t = now();
+        if(!quiet && t - last >= 2) {
+            unsigned long long done = __atomic_load_n(&shared->cases_done, __ATOMIC_RELAXED);
+            double rate = done / (t - start);
+            fprintf(stderr, "\r%llu of %llu cases, %.2fM/s, %.0fs to go   ", done, total,
+                rate * 1e-6, rate > 0 ? (total - done) / rate : 0.0);
+            last = t;
+        }
+    }
+    double secs = now() - start;
+    if(!quiet && secs >= 2) {
+        fprintf(stderr, "\n");
+    }
+    if(failed) {
+        fprintf(stderr, "a worker failed\n");
+        return 1;
+    }
+
+    RESULTS sum;
+    memset(&sum, 0, sizeof(sum));
+    for(int w=0; w<num_workers; ++w) {
+        RESULTS *r = &shared->worker[w];
+        sum.cases += r->cases;
+        sum.mismatches += r->mismatches;
+        sum.no_ref += r->no_ref;
+        sum.overflow_cases += r->overflow_cases;
+        sum.pic_diffs += r->pic_diffs;
+        sum.pic_unexplained += r->pic_unexplained;
+        for(int op=0; op<PIC_NUM_OPS; ++op) {
+            sum.op_cases[op] += r->op_cases[op];
+        }
+    }
+
+    printf("trigs");
+    for(int i=0; i<num_trig_list; ++i) {
+        printf("%c%d", i ? ',' : ' ', trig_list[i]);
+    }
+    printf("  curves");
+    for(int i=0; i<num_curve_list; ++i) {
+        printf("%c%d", i ? ',' : ' ', curve_list[i]);
+    }
+    printf("  %d readings per pot  shard %d/%d\n", num_values, shard, num_shards);
+    printf("%llu cases in %.2fs on %d workers, %.2fM cases/s\n", sum.cases, secs,
+        num_workers, secs > 0 ? sum.cases / secs * 1e-6 : 0.0);
+    printf("new differs from reference: %llu cases\n", sum.mismatches);
+    print_examples(shared, num_workers, offsetof(RESULTS, mismatch),
+        offsetof(RESULTS, num_mismatch), "ref", "new");
+    if(sum.no_ref) {
+        printf("curve not in reference, not compared: %llu cases\n", sum.no_ref);
+    }
+    printf("overflows with PIC widths: %llu cases, of which the table differs in %llu\n",
+        sum.overflow_cases, sum.pic_diffs - sum.pic_unexplained);
+    for(int op=0; op<PIC_NUM_OPS; ++op) {
+        if(sum.op_cases[op]) {
+            printf("  %-28s %llu cases\n", pic_op_names[op], sum.op_cases[op]);
+            print_examples(shared, num_workers,
+                offsetof(RESULTS, op) + op * sizeof(shared->worker[0].op[0]),
+                offsetof(RESULTS, num_op) + op * sizeof(int), "host", "PIC");
+        }
+    }
+    if(sum.pic_unexplained) {
+        // pat_pic.c is out of step with pattern.c
+        printf("PIC model differs without an overflow: %llu cases\n", sum.pic_unexplained);
+        print_examples(shared, num_workers, offsetof(RESULTS, unexplained),
+            offsetof(RESULTS, num_unexplained), "host", "PIC");
+    }
+    return sum.mismatches ? 1 : 0;
+}
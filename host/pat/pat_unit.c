@@ -0,0 +1,50 @@
+/*
+ An implementation of the pattern calculation for pat_sweep: a copy of
+ the firmware's pattern.c (PAT_SRC) built as a library on its own, with
+ the pots and the pattern store stubbed out. Being a library of its own,
+ it can be loaded beside another version of pattern.c. Versions without
+ curves (such as pattern_ref.c) leave pat_set_curve() out, so it is weak.
+ */
+#include <string.h>
+#include <xc.h>
+#include "d-ticker.h"
+
+static byte readings[POTS_COUNT];
+
+byte pots_reading(int which) {
+    return readings[which];
+}
+
+void store_pattern_changed() {
+}
+
+void pat_set_curve(byte curve) __attribute__((weak));
+
+#include PAT_SRC
+
+// NULL for a version without curves
+static void (*set_curve)(byte curve) = pat_set_curve;
+
+////////////////////////////////////////////////////////////////////////////////
+// The trig table for the pot readings, trig count and curve. Returns 0 if
+// this version has no such curve
+int pat_unit_calc(const unsigned char *pots, int num_trigs, int curve, unsigned *table) {
+    if(!set_curve && curve != PAT_CURVE_CLASSIC) {
+        return 0;
+    }
+    static byte started;
+    if(!started) {
+        pat_init();
+        started = 1;
+    }
+    memcpy(readings, pots, POTS_COUNT);
+    pat_set_num_trigs(num_trigs);
+    if(set_curve) {
+        set_curve((byte)curve);
+    }
+    pat_recalc();
+    for(int i=0; i<num_trigs; ++i) {
+        table[i] = pat_get_trig(i);
+    }
+    return 1;
+}
@@ -0,0 +1,1716 @@
+/*
+ Instruction set simulator for the PIC16F1825, to count the cycles taken by
+ the firmware as built by XC8 (d-ticker.X/dist/.../d-ticker.X.production.hex)
+ without the module or a PICkit:
+
+    make pic_sim
+    pic_sim [options] firmware.hex
+
+ It runs the firmware from reset for a given time and prints:
+
+ - the ISR: entries, cycles and share of the CPU for each set of interrupt
+   sources found pending on entry, plus the worst case
+ - each distinct path through the ISR (the same sources and the same
+   branches taken), with its cycles and the functions it called
+ - each function: calls, cycles in its own code, and cycles from its call
+   to its return (including the call and return, less any interrupts)
+
+ The core is the enhanced mid-range one (49 instructions, 16 level stack,
+ automatic context save). Cycles are as in the datasheet: 2 for branches,
+ calls and returns, skips that skip and writes to PCL, plus 1 for an INDF
+ access to program memory. Entering the ISR takes 2 cycles (the datasheet
+ gives 3 to 5 cycles latency, which includes the instruction finishing).
+
+ The peripherals are modelled as far as the firmware uses them: timer 0 and
+ timer 1 on the instruction clock, the ADC (11.5 TAD per conversion),
+ interrupt on change and INT on port A, the port latches and TRIS, the
+ data EEPROM (4ms writes), and the UART transmitter at the set baud rate.
+ Other registers just hold what is written. The clock is set from OSCCON
+ (and the PLL config bit) as on the chip, starting at 500kHz.
+
+ Options:
+    -t ms       time to run for (default 1000)
+    -w ms       time to run before counting starts, to leave out the
+                start up (default 0)
+    -s file     code symbols, one per line as <name> <hex word address>.
+                Extra fields are ignored, except that a line with a third
+                field which is a class other than CODE is skipped, so a
+                symbol table listing the class of each symbol can be given
+                as is. Without symbols, functions are named by address and
+                code is counted against the nearest call target below it
+    -i file     inputs, one per line in time order:
+                    <time in us> RA<n>|RC<n> 0|1    digital input level
+                    <time in us> AN<n> <0..1023>   analogue input level
+                Digital inputs start high and analogue ones at 512
+    -l          log the changes on output pins, in the form of the inputs
+    -u file     write the bytes sent by the UART to file
+    -p n        list the n paths with the most cycles (default 20)
+    -f n        list the n functions with the most cycles (default 40)
+
+ make check runs the simulator on the test programs in pic_test/ (the core,
+ and the cycle counts and peripherals, each counted by hand in its .asm
+ source) and on old_firmware/Debug/d-ticker.hex, the XC8 build of the first
+ firmware, whose ISR paths are counted by hand in pic_test/old_firmware.lst.
+ The reports and UART output must match the ones kept there.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+
+enum {
+    PROG_WORDS = 0x8000,        // address space of the 15 bit PC
+    PROG_SIZE = 0x2000,         // implemented on the PIC16F1825
+    PC_MASK = PROG_WORDS - 1,
+    EEPROM_SIZE = 256,
+    EEPROM_HEX_ADDR = 0xF000,   // word address of the EEPROM in a hex file
+    CONFIG_HEX_ADDR = 0x8007,
+    STACK_LEVELS = 16,
+    ISR_VECTOR = 0x0004,
+    ISR_ENTRY_CYCLES = 2,
+    EE_WRITE_US = 4000,
+    ANALOG_INPUTS = 8,
+    MAX_PATHS = 4096,           // distinct ISR paths kept
+    MAX_PATH_CALLS = 12,        // functions listed for each path
+    MAX_SOURCE_SETS = 64
+};
+
+// core registers, at the same place in every bank
+enum {
+    R_INDF0, R_INDF1, R_PCL, R_STATUS, R_FSR0L, R_FSR0H, R_FSR1L, R_FSR1H,
+    R_BSR, R_WREG, R_PCLATH, R_INTCON
+};
+
+// special function registers used by the model, by bank << 7 | offset
+enum {
+    R_PORTA = 0x00C, R_PORTC = 0x00E, R_PIR1 = 0x011, R_PIR2 = 0x012,
+    R_PIR3 = 0x013, R_TMR0 = 0x015, R_TMR1L = 0x016, R_TMR1H = 0x017,
+    R_T1CON = 0x018,
+    R_TRISA = 0x08C, R_TRISC = 0x08E, R_PIE1 = 0x091, R_PIE2 = 0x092,
+    R_PIE3 = 0x093, R_OPTION_REG = 0x095, R_OSCCON = 0x099,
+    R_OSCSTAT = 0x09A, R_ADRESL = 0x09B, R_ADRESH = 0x09C, R_ADCON0 = 0x09D,
+    R_ADCON1 = 0x09E,
+    R_LATA = 0x10C, R_LATC = 0x10E,
+    R_ANSELA = 0x18C, R_ANSELC = 0x18E, R_EEADRL = 0x191, R_EEADRH = 0x192,
+    R_EEDATL = 0x193, R_EEDATH = 0x194, R_EECON1 = 0x195, R_EECON2 = 0x196,
+    R_TXREG = 0x19A, R_SPBRGL = 0x19B, R_SPBRGH = 0x19C, R_RCSTA = 0x19D,
+    R_TXSTA = 0x19E, R_BAUDCON = 0x19F,
+    R_WPUA = 0x20C, R_WPUC = 0x20E,
+    R_IOCAP = 0x391, R_IOCAN = 0x392, R_IOCAF = 0x393,
+    R_STATUS_SHAD = 0xFE4, R_WREG_SHAD, R_BSR_SHAD, R_PCLATH_SHAD,
+    R_FSR0L_SHAD, R_FSR0H_SHAD, R_FSR1L_SHAD, R_FSR1H_SHAD
+};
+
+enum {
+    STATUS_C = 0x01,
+    STATUS_DC = 0x02,
+    STATUS_Z = 0x04,
+    STATUS_WRITABLE = 0x07,
+    INTCON_GIE = 0x80,
+    INTCON_PEIE = 0x40,
+    INTCON_IOCIF = 0x01,        // flags are 3 bits below their enables
+    INTCON_INTF = 0x02,
+    INTCON_TMR0IF = 0x04,
+    PIR1_TMR1IF = 0x01,
+    PIR1_TXIF = 0x10,
+    PIR1_ADIF = 0x40,
+    PIR2_EEIF = 0x10,
+    OPTION_PS = 0x07,
+    OPTION_PSA = 0x08,
+    OPTION_TMR0CS = 0x20,
+    OPTION_INTEDG = 0x40,
+    T1CON_ON = 0x01,
+    ADCON0_ADON = 0x01,
+    ADCON0_GO = 0x02,
+    ADCON1_ADFM = 0x80,
+    EECON1_RD = 0x01,
+    EECON1_WR = 0x02,
+    EECON1_WREN = 0x04,
+    EECON1_CFGS = 0x40,
+    EECON1_EEPGD = 0x80,
+    TXSTA_TRMT = 0x02,
+    TXSTA_BRGH = 0x04,
+    TXSTA_TXEN = 0x20,
+    TXSTA_TX9 = 0x40,
+    RCSTA_SPEN = 0x80,
+    BAUDCON_BRG16 = 0x08,
+    OSCCON_SPLLEN = 0x80,
+    CONFIG2_PLLEN = 0x0100
+};
+
+typedef struct {
+    uint16_t entry;             // address called
+    uint8_t in_isr;
+    uint8_t counted;            // called since counting started
+    uint64_t start;             // cycles at the call, less ISR cycles if in_isr is 0
+} FRAME;
+
+typedef struct {
+    uint64_t calls;             // which have returned
+    uint64_t total;             // cycles from call to return
+    uint64_t min;
+    uint64_t max;
+} FUNC;
+
+typedef struct {
+    uint64_t hash;              // of the sources and the branches taken
+    uint32_t sources;           // interrupt flags found pending on entry
+    uint64_t count;
+    uint64_t total;
+    uint64_t min;
+    uint64_t max;
+    long long first_ps;
+    uint16_t calls[MAX_PATH_CALLS];
+    int num_calls;
+} PATH;
+
+typedef struct {
+    uint16_t addr;
+    char *name;
+} SYMBOL;
+
+// the chip
+static struct {
+    uint16_t prog[PROG_WORDS];
+    uint16_t config[2];
+    uint8_t ram[0x1000];        // all banks, core registers and common RAM in bank 0
+    uint8_t eeprom[EEPROM_SIZE];
+    uint16_t pc;
+    uint16_t next_pc;
+    uint16_t stack[STACK_LEVELS];
+    FRAME frames[STACK_LEVELS];
+    int sp;
+    int cycles;                 // cycles of the instruction being run
+    uint64_t now;               // cycles since reset
+    long long now_ps;
+    long long tcy_ps;           // instruction cycle
+    const char *error;          // set to stop the run
+} cpu;
+
+// the peripherals
+static struct {
+    int t0_prescale;            // counts towards the next TMR0 increment
+    int t0_inhibit;             // cycles TMR0 holds after a write
+    long t1_prescale;
+    long adc_left;              // cycles until the conversion is done, or 0
+    long ee_left;               // cycles until the EEPROM write is done, or 0
+    uint8_t ee_addr;
+    uint8_t ee_data;
+    int ee_unlock;              // 0x55 then 0xAA written to EECON2
+    int tx_full;                // byte waiting in TXREG
+    uint8_t tx_byte;
+    long tx_left;               // cycles until the shift register is empty, or 0
+    uint8_t pins_a;             // digital input levels
+    uint8_t pins_c;
+    int analog[ANALOG_INPUTS];
+    unsigned outputs;           // driven pins and their levels, for the log
+} per;
+
+// stimulus
+static struct {
+    FILE *file;
+    const char *path;
+    int line;
+    int have_next;
+    long long time_ps;
+    int is_analog;
+    int port;                   // 0 for A, 1 for C
+    int which;
+    int value;
+} input;
+
+// what is counted
+static struct {
+    uint64_t start;             // cycles when counting started
+    uint64_t instructions;
+    uint64_t isr_cycles;        // in the ISR, since reset
+    uint64_t isr_counted;       // in the ISR, since counting started
+    uint64_t isr_entries;
+    uint64_t isr_max;
+    long long isr_max_ps;
+    uint64_t pc_cycles[PROG_WORDS];
+    FUNC func[PROG_WORDS];
+    PATH paths[MAX_PATHS];
+    int num_paths;
+    uint64_t lost_paths;        // entries not kept, the table being full
+} stats;
+
+// the ISR being run
+static struct {
+    int active;
+    int counted;                // entered since counting started
+    uint64_t start;
+    uint32_t sources;
+    uint64_t hash;
+    uint16_t calls[MAX_PATH_CALLS];
+    int num_calls;
+} isr;
+
+static SYMBOL *symbols;
+static int num_symbols;
+static int log_pins;
+static FILE *uart_out;
+
+static const char *source_names[] = {
+    "IOC", "INT", "TMR0", 0, 0, 0, 0, 0,                // INTCON
+    "TMR1", "TMR2", "CCP1", "SSP1", "TX", "RC", "ADC", "TMR1G",    // PIR1
+    "CCP2", 0, 0, "BCL1", "EE", "C1", "C2", "OSF",      // PIR2
+    0, "TMR4", 0, "TMR6", "CCP3", "CCP4", 0, 0          // PIR3
+};
+
+////////////////////////////////////////////////////////////////////////////////
+static void fail(const char *msg) {
+    if(!cpu.error) {
+        cpu.error = msg;
+    }
+}
+
+static uint64_t fnv(uint64_t h, uint32_t x) {
+    return (h ^ x) * 0x100000001B3ULL;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Peripherals
+////////////////////////////////////////////////////////////////////////////////
+
+static void set_clock() {
+    // for each IRCF setting
+    static const long hz[16] = {
+        31000, 31000, 31250, 31250, 62500, 125000, 250000, 500000,
+        125000, 250000, 500000, 1000000, 2000000, 4000000, 8000000, 16000000
+    };
+    uint8_t osccon = cpu.ram[R_OSCCON];
+    int ircf = (osccon >> 3) & 0x0F;
+    long long fosc = hz[ircf];
+    if(ircf == 14 && ((osccon & OSCCON_SPLLEN) || (cpu.config[1] & CONFIG2_PLLEN))) {
+        fosc *= 4;
+    }
+    cpu.tcy_ps = 4000000000000LL / fosc;
+}
+
+static long us_to_cycles(long long us) {
+    return (long)(us * 1000000LL / cpu.tcy_ps);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static uint8_t read_intcon() {
+    return (cpu.ram[R_INTCON] & ~INTCON_IOCIF) | (cpu.ram[R_IOCAF] ? INTCON_IOCIF : 0);
+}
+
+static uint8_t read_pir1() {
+    return (cpu.ram[R_PIR1] & ~PIR1_TXIF) |
+        (((cpu.ram[R_TXSTA] & TXSTA_TXEN) && !per.tx_full) ? PIR1_TXIF : 0);
+}
+
+static uint8_t read_port(uint8_t lat, uint8_t tris, uint8_t ansel, uint8_t pins) {
+    return ((lat & ~tris) | (pins & tris & ~ansel)) & 0x3F;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static void print_time(FILE *out, long long ps) {
+    fprintf(out, "%lld.%02lld", ps / 1000000, (ps % 1000000) / 10000);
+}
+
+// log the output pins which changed
+static void check_outputs() {
+    uint8_t tris_a = cpu.ram[R_TRISA] | 0x08;   // RA3 is input only
+    unsigned outputs = (unsigned)(~tris_a & 0x3F) << 24 |
+        (unsigned)(~cpu.ram[R_TRISC] & 0x3F) << 16 |
+        (unsigned)(cpu.ram[R_LATA] & ~tris_a & 0x3F) << 8 |
+        (cpu.ram[R_LATC] & ~cpu.ram[R_TRISC] & 0x3F);
+    unsigned changed = outputs ^ per.outputs;
+    per.outputs = outputs;
+    if(!log_pins || !changed) {
+        return;
+    }
+    for(int port=0; port<2; ++port) {
+        for(int bit=0; bit<6; ++bit) {
+            unsigned drive = 1U << (24 - 8*port + bit);
+            unsigned level = 1U << (8 - 8*port + bit);
+            if(changed & (drive | level)) {
+                print_time(stdout, cpu.now_ps);
+                printf(" R%c%d %c\n", port ? 'C' : 'A', bit,
+                    !(outputs & drive) ? 'z' : (outputs & level) ? '1' : '0');
+            }
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static void adc_start() {
+    // TAD in Fosc periods for each ADCS setting, 0 for the FRC oscillator
+    static const int tad_fosc[8] = { 2, 8, 32, 0, 4, 16, 64, 0 };
+    int tad = tad_fosc[(cpu.ram[R_ADCON1] >> 4) & 7];
+    if(tad) {
+        per.adc_left = (23 * tad + 7) / 8;      // 11.5 TAD in cycles
+    }
+    else {
+        per.adc_left = us_to_cycles(18) + 1;    // FRC, 1.6us TAD
+    }
+}
+
+static void adc_done() {
+    int channel = (cpu.ram[R_ADCON0] >> 2) & 0x1F;
+    int value = (channel < ANALOG_INPUTS) ? per.analog[channel] : 0;
+    if(cpu.ram[R_ADCON1] & ADCON1_ADFM) {
+        cpu.ram[R_ADRESH] = (uint8_t)(value >> 8);
+        cpu.ram[R_ADRESL] = (uint8_t)value;
+    }
+    else {
+        cpu.ram[R_ADRESH] = (uint8_t)(value >> 2);
+        cpu.ram[R_ADRESL] = (uint8_t)(value << 6);
+    }
+    cpu.ram[R_ADCON0] &= ~ADCON0_GO;
+    cpu.ram[R_PIR1] |= PIR1_ADIF;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static long uart_frame_cycles() {
+    int brg16 = (cpu.ram[R_BAUDCON] & BAUDCON_BRG16) != 0;
+    int brgh = (cpu.ram[R_TXSTA] & TXSTA_BRGH) != 0;
+    long div = (brg16 && brgh) ? 4 : (brg16 || brgh) ? 16 : 64;
+    long n = cpu.ram[R_SPBRGL] | (brg16 ? cpu.ram[R_SPBRGH] << 8 : 0);
+    long bits = (cpu.ram[R_TXSTA] & TXSTA_TX9) ? 11 : 10;
+    return bits * div * (n + 1) / 4;
+}
+
+static void uart_shift(uint8_t byte) {
+    per.tx_left = uart_frame_cycles();
+    if(uart_out) {
+        fputc(byte, uart_out);
+    }
+}
+
+static void uart_write(uint8_t byte) {
+    if(!(cpu.ram[R_TXSTA] & TXSTA_TXEN) || !(cpu.ram[R_RCSTA] & RCSTA_SPEN)) {
+        return;
+    }
+    if(per.tx_left) {
+        per.tx_full = 1;
+        per.tx_byte = byte;
+    }
+    else {
+        uart_shift(byte);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static void eeprom_control(uint8_t value) {
+    uint8_t old = cpu.ram[R_EECON1];
+    // RD and WR can only be set by software, not cleared
+    cpu.ram[R_EECON1] = (value & ~(EECON1_RD | EECON1_WR)) | (old & EECON1_WR);
+    if(value & EECON1_RD) {
+        if(value & EECON1_CFGS) {
+            cpu.ram[R_EEDATL] = 0;      // config and ID words are not kept
+            cpu.ram[R_EEDATH] = 0;
+        }
+        else if(value & EECON1_EEPGD) {
+            uint16_t word = cpu.prog[((cpu.ram[R_EEADRH] << 8) | cpu.ram[R_EEADRL]) & PC_MASK];
+            cpu.ram[R_EEDATL] = (uint8_t)word;
+            cpu.ram[R_EEDATH] = (uint8_t)(word >> 8);
+        }
+        else {
+            cpu.ram[R_EEDATL] = cpu.eeprom[cpu.ram[R_EEADRL]];
+        }
+    }
+    if((value & EECON1_WR) && !(old & EECON1_WR) && (value & EECON1_WREN) &&
+        per.ee_unlock == 2)
+    {
+        if(value & (EECON1_EEPGD | EECON1_CFGS)) {
+            fail("program memory writes are not modelled");
+            return;
+        }
+        cpu.ram[R_EECON1] |= EECON1_WR;
+        per.ee_addr = cpu.ram[R_EEADRL];
+        per.ee_data = cpu.ram[R_EEDATL];
+        per.ee_left = us_to_cycles(EE_WRITE_US);
+    }
+    per.ee_unlock = 0;
+}
+
+static void eeprom_unlock(uint8_t value) {
+    if(value == 0x55) {
+        per.ee_unlock = 1;
+    }
+    else if(value == 0xAA && per.ee_unlock == 1) {
+        per.ee_unlock = 2;
+    }
+    else {
+        per.ee_unlock = 0;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// a digital input pin changes
+static void set_pin(int port, int bit, int level) {
+    uint8_t *pins = port ? &per.pins_c : &per.pins_a;
+    uint8_t mask = (uint8_t)(1 << bit);
+    int old = (*pins & mask) != 0;
+    if(level == old) {
+        return;
+    }
+    *pins ^= mask;
+    if(port) {
+        return;
+    }
+    if(mask & (level ? cpu.ram[R_IOCAP] : cpu.ram[R_IOCAN])) {
+        cpu.ram[R_IOCAF] |= mask;
+    }
+    if(bit == 2 && level == ((cpu.ram[R_OPTION_REG] & OPTION_INTEDG) != 0)) {
+        cpu.ram[R_INTCON] |= INTCON_INTF;
+    }
+}
+
+static void read_input() {
+    char line[256];
+    char pin[16];
+    double us;
+    input.have_next = 0;
+    while(fgets(line, sizeof(line), input.file)) {
+        ++input.line;
+        if(line[0] == '#' || line[strspn(line, " \t\r\n")] == 0) {
+            continue;
+        }
+        int value;
+        if(sscanf(line, "%lf %15s %d", &us, pin, &value) != 3 ||
+            !((pin[0] == 'R' && (pin[1] == 'A' || pin[1] == 'C') &&
+                pin[2] >= '0' && pin[2] <= '5' && !pin[3] && (value == 0 || value == 1)) ||
+              (pin[0] == 'A' && pin[1] == 'N' && pin[2] >= '0' && pin[2] < '0' + ANALOG_INPUTS &&
+                !pin[3] && value >= 0 && value <= 1023)))
+        {
+            fprintf(stderr, "%s:%d: bad input\n", input.path, input.line);
+            exit(1);
+        }
+        input.time_ps = (long long)(us * 1e6);
+        input.is_analog = (pin[0] == 'A');
+        input.port = (pin[1] == 'C');
+        input.which = pin[2] - '0';
+        input.value = value;
+        input.have_next = 1;
+        return;
+    }
+}
+
+static void apply_inputs() {
+    while(input.have_next && input.time_ps <= cpu.now_ps) {
+        if(input.is_analog) {
+            per.analog[input.which] = input.value;
+        }
+        else {
+            set_pin(input.port, input.which, input.value);
+        }
+        read_input();
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// the peripherals run on for n instruction cycles
+static void tick(int n) {
+    cpu.now += n;
+    cpu.now_ps += n * cpu.tcy_ps;
+
+    // timer 0, which stops for 2 cycles after it is written
+    uint8_t option = cpu.ram[R_OPTION_REG];
+    if(!(option & OPTION_TMR0CS)) {
+        int count = n;
+        if(per.t0_inhibit) {
+            int held = (count < per.t0_inhibit) ? count : per.t0_inhibit;
+            per.t0_inhibit -= held;
+            count -= held;
+        }
+        if(!(option & OPTION_PSA)) {
+            int shift = (option & OPTION_PS) + 1;
+            per.t0_prescale += count;
+            count = per.t0_prescale >> shift;
+            per.t0_prescale &= (1 << shift) - 1;
+        }
+        int tmr0 = cpu.ram[R_TMR0] + count;
+        if(tmr0 > 0xFF) {
+            cpu.ram[R_INTCON] |= INTCON_TMR0IF;
+        }
+        cpu.ram[R_TMR0] = (uint8_t)tmr0;
+    }
+
+    // timer 1 on the instruction clock or Fosc
+    uint8_t t1con = cpu.ram[R_T1CON];
+    if((t1con & T1CON_ON) && (t1con >> 6) < 2) {
+        int shift = (t1con >> 4) & 3;
+        per.t1_prescale += ((t1con >> 6) ? 4L : 1L) * n;
+        long count = per.t1_prescale >> shift;
+        per.t1_prescale &= (1L << shift) - 1;
+        long tmr1 = (cpu.ram[R_TMR1H] << 8 | cpu.ram[R_TMR1L]) + count;
+        if(tmr1 > 0xFFFF) {
+            cpu.ram[R_PIR1] |= PIR1_TMR1IF;
+        }
+        cpu.ram[R_TMR1L] = (uint8_t)tmr1;
+        cpu.ram[R_TMR1H] = (uint8_t)(tmr1 >> 8);
+    }
+
+    if(per.adc_left && (per.adc_left -= n) <= 0) {
+        per.adc_left = 0;
+        adc_done();
+    }
+    if(per.ee_left && (per.ee_left -= n) <= 0) {
+        per.ee_left = 0;
+        cpu.eeprom[per.ee_addr] = per.ee_data;
+        cpu.ram[R_EECON1] &= ~EECON1_WR;
+        cpu.ram[R_PIR2] |= PIR2_EEIF;
+    }
+    if(per.tx_left && (per.tx_left -= n) <= 0) {
+        per.tx_left = 0;
+        if(per.tx_full) {
+            per.tx_full = 0;
+            uart_shift(per.tx_byte);
+        }
+    }
+    apply_inputs();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Register file
+////////////////////////////////////////////////////////////////////////////////
+
+// the core registers and common RAM are kept in bank 0
+static unsigned normalise(unsigned addr) {
+    unsigned offset = addr & 0x7F;
+    if(offset < 0x0C) {
+        return offset;
+    }
+    if(offset >= 0x70) {
+        return 0x70 | (offset & 0x0F);
+    }
+    return addr & 0xFFF;
+}
+
+static uint16_t get_fsr(int n) {
+    return cpu.ram[R_FSR0L + 2*n] | (cpu.ram[R_FSR0H + 2*n] << 8);
+}
+
+static void set_fsr(int n, uint16_t value) {
+    cpu.ram[R_FSR0L + 2*n] = (uint8_t)value;
+    cpu.ram[R_FSR0H + 2*n] = (uint8_t)(value >> 8);
+}
+
+// the data address an FSR value points at, or -1 for program memory or none
+static int fsr_target(uint16_t fsr) {
+    if(fsr < 0x1000) {
+        return (int)normalise(fsr);
+    }
+    if(fsr >= 0x2000 && fsr < 0x29B0) {
+        // linear data memory, the GPR of each bank end to end
+        unsigned offset = fsr - 0x2000;
+        return (int)(((offset / 80) << 7) + 0x20 + offset % 80);
+    }
+    return -1;
+}
+
+static uint8_t read_reg(unsigned addr);
+static void write_reg(unsigned addr, uint8_t value);
+
+static uint8_t read_fsr(uint16_t fsr) {
+    int target = fsr_target(fsr);
+    if(target < 0) {
+        if(fsr >= 0x8000) {
+            ++cpu.cycles;
+            return (uint8_t)cpu.prog[fsr & PC_MASK];
+        }
+        return 0;
+    }
+    if(target <= R_INDF1) {
+        return 0;
+    }
+    return read_reg((unsigned)target);
+}
+
+static void write_fsr(uint16_t fsr, uint8_t value) {
+    int target = fsr_target(fsr);
+    if(target < 0) {
+        if(fsr >= 0x8000) {
+            ++cpu.cycles;
+        }
+        return;
+    }
+    if(target > R_INDF1) {
+        write_reg((unsigned)target, value);
+    }
+}
+
+// addr has been normalised
+static uint8_t read_reg(unsigned addr) {
+    switch(addr) {
+        case R_INDF0:
+        case R_INDF1:
+            return read_fsr(get_fsr(addr));
+        case R_PCL:
+            return (uint8_t)cpu.next_pc;
+        case R_INTCON:
+            return read_intcon();
+        case R_PORTA:
+            return read_port(cpu.ram[R_LATA], cpu.ram[R_TRISA] | 0x08,
+                cpu.ram[R_ANSELA], per.pins_a);
+        case R_PORTC:
+            return read_port(cpu.ram[R_LATC], cpu.ram[R_TRISC],
+                cpu.ram[R_ANSELC], per.pins_c);
+        case R_PIR1:
+            return read_pir1();
+        case R_TXSTA:
+            return (cpu.ram[R_TXSTA] & ~TXSTA_TRMT) | (per.tx_left ? 0 : TXSTA_TRMT);
+        case R_EECON2:
+            return 0;
+        default:
+            return cpu.ram[addr];
+    }
+}
+
+static void write_reg(unsigned addr, uint8_t value) {
+    switch(addr) {
+        case R_INDF0:
+        case R_INDF1:
+            write_fsr(get_fsr(addr), value);
+            return;
+        case R_PCL:
+            cpu.ram[R_PCL] = value;
+            cpu.next_pc = (uint16_t)(((cpu.ram[R_PCLATH] << 8) | value) & PC_MASK);
+            ++cpu.cycles;
+            return;
+        case R_STATUS:
+            cpu.ram[R_STATUS] = (cpu.ram[R_STATUS] & ~STATUS_WRITABLE) | (value & STATUS_WRITABLE);
+            return;
+        case R_BSR:
+            cpu.ram[R_BSR] = value & 0x1F;
+            return;
+        case R_PCLATH:
+            cpu.ram[R_PCLATH] = value & 0x7F;
+            return;
+        case R_INTCON:
+            cpu.ram[R_INTCON] = value & ~INTCON_IOCIF;
+            return;
+        case R_PORTA:
+        case R_LATA:
+            cpu.ram[R_LATA] = value & 0x37;
+            check_outputs();
+            return;
+        case R_PORTC:
+        case R_LATC:
+            cpu.ram[R_LATC] = value & 0x3F;
+            check_outputs();
+            return;
+        case R_TRISA:
+            cpu.ram[R_TRISA] = (value & 0x37) | 0x08;
+            check_outputs();
+            return;
+        case R_TRISC:
+            cpu.ram[R_TRISC] = value & 0x3F;
+            check_outputs();
+            return;
+        case R_TMR0:
+            cpu.ram[R_TMR0] = value;
+            per.t0_prescale = 0;
+            per.t0_inhibit = 2;
+            return;
+        case R_PIR1:
+            cpu.ram[R_PIR1] = value & ~PIR1_TXIF;
+            return;
+        case R_ADCON0: {
+            uint8_t old = cpu.ram[R_ADCON0];
+            cpu.ram[R_ADCON0] = value;
+            if(!(value & ADCON0_GO) || !(value & ADCON0_ADON)) {
+                cpu.ram[R_ADCON0] &= ~ADCON0_GO;
+                per.adc_left = 0;
+            }
+            else if(!(old & ADCON0_GO)) {
+                adc_start();
+            }
+            return;
+        }
+        case R_OSCCON:
+            cpu.ram[R_OSCCON] = value;
+            set_clock();
+            return;
+        case R_OSCSTAT:
+            return;
+        case R_EECON1:
+            eeprom_control(value);
+            return;
+        case R_EECON2:
+            eeprom_unlock(value);
+            return;
+        case R_TXREG:
+            cpu.ram[R_TXREG] = value;
+            uart_write(value);
+            return;
+        case R_TXSTA:
+            cpu.ram[R_TXSTA] = value & ~TXSTA_TRMT;
+            return;
+        default:
+            cpu.ram[addr] = value;
+            return;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Counting
+////////////////////////////////////////////////////////////////////////////////
+
+// cycles for frames not in the ISR do not count interrupts
+static uint64_t frame_clock(int in_isr) {
+    return in_isr ? cpu.now : cpu.now - stats.isr_cycles;
+}
+
+static void push(uint16_t ret, uint16_t entry) {
+    if(cpu.sp == STACK_LEVELS) {
+        fail("stack overflow");
+        return;
+    }
+    FRAME *frame = &cpu.frames[cpu.sp];
+    frame->entry = entry;
+    frame->in_isr = (uint8_t)isr.active;
+    frame->counted = 1;
+    frame->start = frame_clock(isr.active);
+    cpu.stack[cpu.sp++] = ret;
+    if(isr.active && entry != ISR_VECTOR) {
+        if(isr.num_calls < MAX_PATH_CALLS) {
+            isr.calls[isr.num_calls] = entry;
+        }
+        ++isr.num_calls;
+    }
+}
+
+static int pop() {
+    if(!cpu.sp) {
+        fail("stack underflow");
+        return 0;
+    }
+    cpu.next_pc = cpu.stack[--cpu.sp];
+    return 1;
+}
+
+// after the return from the frame at cpu.sp
+static void frame_done() {
+    FRAME *frame = &cpu.frames[cpu.sp];
+    if(!frame->counted) {
+        return;
+    }
+    FUNC *func = &stats.func[frame->entry];
+    uint64_t cycles = frame_clock(frame->in_isr) - frame->start;
+    ++func->calls;
+    func->total += cycles;
+    if(!func->min || cycles < func->min) {
+        func->min = cycles;
+    }
+    if(cycles > func->max) {
+        func->max = cycles;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static void path_done() {
+    uint64_t cycles = cpu.now - isr.start;
+    isr.active = 0;
+    stats.isr_cycles += cycles;
+    if(!isr.counted) {
+        return;
+    }
+    stats.isr_counted += cycles;
+    ++stats.isr_entries;
+    if(cycles > stats.isr_max) {
+        stats.isr_max = cycles;
+        stats.isr_max_ps = cpu.now_ps;
+    }
+    uint64_t hash = fnv(isr.hash, isr.sources);
+    PATH *path = 0;
+    for(int i=0; i<stats.num_paths; ++i) {
+        if(stats.paths[i].hash == hash && stats.paths[i].sources == isr.sources) {
+            path = &stats.paths[i];
+            break;
+        }
+    }
+    if(!path) {
+        if(stats.num_paths == MAX_PATHS) {
+            ++stats.lost_paths;
+            return;
+        }
+        path = &stats.paths[stats.num_paths++];
+        memset(path, 0, sizeof(*path));
+        path->hash = hash;
+        path->sources = isr.sources;
+        path->min = cycles;
+        path->first_ps = cpu.now_ps;
+        path->num_calls = isr.num_calls;
+        memcpy(path->calls, isr.calls, sizeof(path->calls));
+    }
+    ++path->count;
+    path->total += cycles;
+    if(cycles < path->min) {
+        path->min = cycles;
+    }
+    if(cycles > path->max) {
+        path->max = cycles;
+    }
+}
+
+// the most used paths are moved to the front now and then, so they are
+// found quickly
+static void sort_paths();
+
+static void reset_stats() {
+    memset(stats.pc_cycles, 0, sizeof(stats.pc_cycles));
+    memset(stats.func, 0, sizeof(stats.func));
+    stats.num_paths = 0;
+    stats.lost_paths = 0;
+    stats.start = cpu.now;
+    stats.instructions = 0;
+    stats.isr_counted = 0;
+    stats.isr_entries = 0;
+    stats.isr_max = 0;
+    // calls and ISR paths part way through are not counted
+    for(int i=0; i<cpu.sp; ++i) {
+        cpu.frames[i].counted = 0;
+    }
+    isr.counted = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Core
+////////////////////////////////////////////////////////////////////////////////
+
+static void reset() {
+    memset(cpu.ram, 0, sizeof(cpu.ram));
+    cpu.ram[R_STATUS] = 0x18;
+    cpu.ram[R_OPTION_REG] = 0xFF;
+    cpu.ram[R_TRISA] = 0x3F;
+    cpu.ram[R_TRISC] = 0x3F;
+    cpu.ram[R_ANSELA] = 0x17;
+    cpu.ram[R_ANSELC] = 0x0F;
+    cpu.ram[R_WPUA] = 0x3F;
+    cpu.ram[R_WPUC] = 0x3F;
+    cpu.ram[R_OSCCON] = 0x38;
+    cpu.ram[R_OSCSTAT] = 0x1F;
+    cpu.ram[R_TXSTA] = TXSTA_TRMT;
+    cpu.ram[R_BAUDCON] = 0x40;
+    cpu.pc = 0;
+    cpu.sp = 0;
+    cpu.now = 0;
+    cpu.now_ps = 0;
+    set_clock();
+    per.pins_a = 0x3F;
+    per.pins_c = 0x3F;
+    for(int i=0; i<ANALOG_INPUTS; ++i) {
+        per.analog[i] = 512;
+    }
+    per.outputs = 0;
+    check_outputs();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static uint8_t w() {
+    return cpu.ram[R_WREG];
+}
+
+static void set_flags(uint8_t mask, uint8_t flags) {
+    cpu.ram[R_STATUS] = (cpu.ram[R_STATUS] & ~mask) | (flags & mask);
+}
+
+static uint8_t z_flag(unsigned result) {
+    return (result & 0xFF) ? 0 : STATUS_Z;
+}
+
+// result of a byte operation to W or the register
+static void store(unsigned op, unsigned addr, uint8_t result) {
+    if(op & 0x80) {
+        write_reg(addr, result);
+    }
+    else {
+        cpu.ram[R_WREG] = result;
+    }
+}
+
+static uint8_t add(uint8_t a, uint8_t b, int carry) {
+    unsigned result = a + b + carry;
+    set_flags(STATUS_C | STATUS_DC | STATUS_Z,
+        (result > 0xFF ? STATUS_C : 0) |
+        (((a & 0x0F) + (b & 0x0F) + carry) > 0x0F ? STATUS_DC : 0) |
+        z_flag(result));
+    return (uint8_t)result;
+}
+
+// a - b, C and DC are set when there is no borrow
+static uint8_t sub(uint8_t a, uint8_t b, int borrow) {
+    return add(a, (uint8_t)~b, !borrow);
+}
+
+static void skip() {
+    cpu.next_pc = (cpu.next_pc + 1) & PC_MASK;
+    ++cpu.cycles;
+}
+
+static int sext(unsigned value, int bits) {
+    int sign = 1 << (bits - 1);
+    return (int)(value & (sign - 1)) - (int)(value & sign);
+}
+
+// MOVIW and MOVWI with pre/post increment or decrement
+static void move_indirect(unsigned op, int to_w) {
+    int n = (op >> 2) & 1;
+    int mode = op & 3;
+    uint16_t fsr = get_fsr(n);
+    if(mode == 0) {
+        ++fsr;
+    }
+    else if(mode == 1) {
+        --fsr;
+    }
+    set_fsr(n, fsr);
+    if(to_w) {
+        uint8_t value = read_fsr(fsr);
+        cpu.ram[R_WREG] = value;
+        set_flags(STATUS_Z, z_flag(value));
+    }
+    else {
+        write_fsr(fsr, w());
+    }
+    if(mode == 2) {
+        set_fsr(n, fsr + 1);
+    }
+    else if(mode == 3) {
+        set_fsr(n, fsr - 1);
+    }
+}
+
+static void interrupt_entry(uint32_t sources) {
+    isr.active = 1;
+    isr.counted = 1;
+    isr.start = cpu.now;
+    isr.sources = sources;
+    isr.hash = 0xCBF29CE484222325ULL;
+    isr.num_calls = 0;
+    push(cpu.pc, ISR_VECTOR);
+    cpu.ram[R_STATUS_SHAD] = cpu.ram[R_STATUS];
+    cpu.ram[R_WREG_SHAD] = cpu.ram[R_WREG];
+    cpu.ram[R_BSR_SHAD] = cpu.ram[R_BSR];
+    cpu.ram[R_PCLATH_SHAD] = cpu.ram[R_PCLATH];
+    cpu.ram[R_FSR0L_SHAD] = cpu.ram[R_FSR0L];
+    cpu.ram[R_FSR0H_SHAD] = cpu.ram[R_FSR0H];
+    cpu.ram[R_FSR1L_SHAD] = cpu.ram[R_FSR1L];
+    cpu.ram[R_FSR1H_SHAD] = cpu.ram[R_FSR1H];
+    cpu.ram[R_INTCON] &= ~INTCON_GIE;
+    cpu.pc = ISR_VECTOR;
+    stats.pc_cycles[ISR_VECTOR] += ISR_ENTRY_CYCLES;
+    tick(ISR_ENTRY_CYCLES);
+}
+
+static void interrupt_return() {
+    cpu.ram[R_STATUS] = (cpu.ram[R_STATUS] & ~STATUS_WRITABLE) |
+        (cpu.ram[R_STATUS_SHAD] & STATUS_WRITABLE);
+    cpu.ram[R_WREG] = cpu.ram[R_WREG_SHAD];
+    cpu.ram[R_BSR] = cpu.ram[R_BSR_SHAD];
+    cpu.ram[R_PCLATH] = cpu.ram[R_PCLATH_SHAD];
+    cpu.ram[R_FSR0L] = cpu.ram[R_FSR0L_SHAD];
+    cpu.ram[R_FSR0H] = cpu.ram[R_FSR0H_SHAD];
+    cpu.ram[R_FSR1L] = cpu.ram[R_FSR1L_SHAD];
+    cpu.ram[R_FSR1H] = cpu.ram[R_FSR1H_SHAD];
+    cpu.ram[R_INTCON] |= INTCON_GIE;
+}
+
+// the pending interrupt sources, or 0 if none
+static uint32_t pending_interrupts() {
+    uint8_t intcon = read_intcon();
+    if(!(intcon & INTCON_GIE)) {
+        return 0;
+    }
+    uint32_t sources = intcon & (intcon >> 3) & 0x07;
+    if(intcon & INTCON_PEIE) {
+        sources |= (uint32_t)(read_pir1() & cpu.ram[R_PIE1]) << 8 |
+            (uint32_t)(cpu.ram[R_PIR2] & cpu.ram[R_PIE2]) << 16 |
+            (uint32_t)(cpu.ram[R_PIR3] & cpu.ram[R_PIE3]) << 24;
+    }
+    return sources;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// run the next instruction, or enter the ISR
+static void step() {
+    uint32_t sources = pending_interrupts();
+    if(sources) {
+        interrupt_entry(sources);
+        return;
+    }
+
+    uint16_t pc = cpu.pc;
+    unsigned op = cpu.prog[pc];
+    unsigned addr = normalise((cpu.ram[R_BSR] << 7) | (op & 0x7F));
+    uint8_t bit = (uint8_t)(1 << ((op >> 7) & 7));
+    int returned = 0;
+    int retfie = 0;
+    uint8_t f, result;
+    cpu.next_pc = (pc + 1) & PC_MASK;
+    cpu.cycles = 1;
+
+    switch(op >> 8) {
+        case 0x00:
+            if(op & 0x80) {                         // MOVWF
+                write_reg(addr, w());
+            }
+            else if(op == 0x0000) {                 // NOP
+            }
+            else if(op == 0x0008) {                 // RETURN
+                returned = pop();
+                ++cpu.cycles;
+            }
+            else if(op == 0x0009) {                 // RETFIE
+                returned = pop();
+                retfie = returned;
+                ++cpu.cycles;
+            }
+            else if(op == 0x000A) {                 // CALLW
+                cpu.next_pc = (uint16_t)(((cpu.ram[R_PCLATH] << 8) | w()) & PC_MASK);
+                push((pc + 1) & PC_MASK, cpu.next_pc);
+                ++cpu.cycles;
+            }
+            else if(op == 0x000B) {                 // BRW
+                cpu.next_pc = (cpu.next_pc + w()) & PC_MASK;
+                ++cpu.cycles;
+            }
+            else if((op & 0xFFF8) == 0x0010) {      // MOVIW ++FSRn etc
+                move_indirect(op, 1);
+            }
+            else if((op & 0xFFF8) == 0x0018) {      // MOVWI ++FSRn etc
+                move_indirect(op, 0);
+            }
+            else if((op & 0xFFE0) == 0x0020) {      // MOVLB
+                cpu.ram[R_BSR] = op & 0x1F;
+            }
+            else if(op == 0x0062) {                 // OPTION
+                write_reg(R_OPTION_REG, w());
+            }
+            else if(op == 0x0064) {                 // CLRWDT
+            }
+            else if(op == 0x0065) {                 // TRIS PORTA
+                write_reg(R_TRISA, w());
+            }
+            else if(op == 0x0067) {                 // TRIS PORTC
+                write_reg(R_TRISC, w());
+            }
+            else if(op == 0x0063) {
+                fail("SLEEP is not modelled");
+            }
+            else if(op == 0x0001) {
+                fail("RESET instruction");
+            }
+            else {
+                fail("unknown instruction");
+            }
+            break;
+        case 0x01:
+            if(op & 0x80) {                         // CLRF
+                write_reg(addr, 0);
+            }
+            else {                                  // CLRW
+                cpu.ram[R_WREG] = 0;
+            }
+            set_flags(STATUS_Z, STATUS_Z);
+            break;
+        case 0x02:                                  // SUBWF
+            store(op, addr, sub(read_reg(addr), w(), 0));
+            break;
+        case 0x03:                                  // DECF
+            result = read_reg(addr) - 1;
+            store(op, addr, result);
+            set_flags(STATUS_Z, z_flag(result));
+            break;
+        case 0x04:                                  // IORWF
+            result = read_reg(addr) | w();
+            store(op, addr, result);
+            set_flags(STATUS_Z, z_flag(result));
+            break;
+        case 0x05:                                  // ANDWF
+            result = read_reg(addr) & w();
+            store(op, addr, result);
+            set_flags(STATUS_Z, z_flag(result));
+            break;
+        case 0x06:                                  // XORWF
+            result = read_reg(addr) ^ w();
+            store(op, addr, result);
+            set_flags(STATUS_Z, z_flag(result));
+            break;
+        case 0x07:                                  // ADDWF
+            store(op, addr, add(read_reg(addr), w(), 0));
+            break;
+        case 0x08:                                  // MOVF
+            result = read_reg(addr);
+            store(op, addr, result);
+            set_flags(STATUS_Z, z_flag(result));
+            break;
+        case 0x09:                                  // COMF
+            result = ~read_reg(addr);
+            store(op, addr, result);
+            set_flags(STATUS_Z, z_flag(result));
+            break;
+        case 0x0A:                                  // INCF
+            result = read_reg(addr) + 1;
+            store(op, addr, result);
+            set_flags(STATUS_Z, z_flag(result));
+            break;
+        case 0x0B:                                  // DECFSZ
+            result = read_reg(addr) - 1;
+            store(op, addr, result);
+            if(!result) {
+                skip();
+            }
+            break;
+        case 0x0C:                                  // RRF
+            f = read_reg(addr);
+            store(op, addr, (uint8_t)((f >> 1) | ((cpu.ram[R_STATUS] & STATUS_C) << 7)));
+            set_flags(STATUS_C, f & 1);
+            break;
+        case 0x0D:                                  // RLF
+            f = read_reg(addr);
+            store(op, addr, (uint8_t)((f << 1) | (cpu.ram[R_STATUS] & STATUS_C)));
+            set_flags(STATUS_C, f >> 7);
+            break;
+        case 0x0E:                                  // SWAPF
+            f = read_reg(addr);
+            store(op, addr, (uint8_t)((f << 4) | (f >> 4)));
+            break;
+        case 0x0F:                                  // INCFSZ
+            result = read_reg(addr) + 1;
+            store(op, addr, result);
+            if(!result) {
+                skip();
+            }
+            break;
+        case 0x10: case 0x11: case 0x12: case 0x13: // BCF
+            write_reg(addr, read_reg(addr) & ~bit);
+            break;
+        case 0x14: case 0x15: case 0x16: case 0x17: // BSF
+            write_reg(addr, read_reg(addr) | bit);
+            break;
+        case 0x18: case 0x19: case 0x1A: case 0x1B: // BTFSC
+            if(!(read_reg(addr) & bit)) {
+                skip();
+            }
+            break;
+        case 0x1C: case 0x1D: case 0x1E: case 0x1F: // BTFSS
+            if(read_reg(addr) & bit) {
+                skip();
+            }
+            break;
+        case 0x20: case 0x21: case 0x22: case 0x23: // CALL
+        case 0x24: case 0x25: case 0x26: case 0x27:
+            cpu.next_pc = (uint16_t)(((cpu.ram[R_PCLATH] & 0x78) << 8) | (op & 0x7FF));
+            push((pc + 1) & PC_MASK, cpu.next_pc);
+            ++cpu.cycles;
+            break;
+        case 0x28: case 0x29: case 0x2A: case 0x2B: // GOTO
+        case 0x2C: case 0x2D: case 0x2E: case 0x2F:
+            cpu.next_pc = (uint16_t)(((cpu.ram[R_PCLATH] & 0x78) << 8) | (op & 0x7FF));
+            ++cpu.cycles;
+            break;
+        case 0x30:                                  // MOVLW
+            cpu.ram[R_WREG] = (uint8_t)op;
+            break;
+        case 0x31:
+            if(op & 0x80) {                         // MOVLP
+                cpu.ram[R_PCLATH] = op & 0x7F;
+            }
+            else {                                  // ADDFSR
+                int n = (op >> 6) & 1;
+                set_fsr(n, (uint16_t)(get_fsr(n) + sext(op, 6)));
+            }
+            break;
+        case 0x32: case 0x33:                       // BRA
+            cpu.next_pc = (uint16_t)((cpu.next_pc + sext(op, 9)) & PC_MASK);
+            ++cpu.cycles;
+            break;
+        case 0x34:                                  // RETLW
+            cpu.ram[R_WREG] = (uint8_t)op;
+            returned = pop();
+            ++cpu.cycles;
+            break;
+        case 0x35:                                  // LSLF
+            f = read_reg(addr);
+            result = f << 1;
+            store(op, addr, result);
+            set_flags(STATUS_C | STATUS_Z, (f >> 7) | z_flag(result));
+            break;
+        case 0x36:                                  // LSRF
+            f = read_reg(addr);
+            result = f >> 1;
+            store(op, addr, result);
+            set_flags(STATUS_C | STATUS_Z, (f & 1) | z_flag(result));
+            break;
+        case 0x37:                                  // ASRF
+            f = read_reg(addr);
+            result = (f >> 1) | (f & 0x80);
+            store(op, addr, result);
+            set_flags(STATUS_C | STATUS_Z, (f & 1) | z_flag(result));
+            break;
+        case 0x38:                                  // IORLW
+            cpu.ram[R_WREG] |= (uint8_t)op;
+            set_flags(STATUS_Z, z_flag(w()));
+            break;
+        case 0x39:                                  // ANDLW
+            cpu.ram[R_WREG] &= (uint8_t)op;
+            set_flags(STATUS_Z, z_flag(w()));
+            break;
+        case 0x3A:                                  // XORLW
+            cpu.ram[R_WREG] ^= (uint8_t)op;
+            set_flags(STATUS_Z, z_flag(w()));
+            break;
+        case 0x3B:                                  // SUBWFB
+            store(op, addr, sub(read_reg(addr), w(), !(cpu.ram[R_STATUS] & STATUS_C)));
+            break;
+        case 0x3C:                                  // SUBLW
+            cpu.ram[R_WREG] = sub((uint8_t)op, w(), 0);
+            break;
+        case 0x3D:                                  // ADDWFC
+            store(op, addr, add(read_reg(addr), w(), cpu.ram[R_STATUS] & STATUS_C));
+            break;
+        case 0x3E:                                  // ADDLW
+            cpu.ram[R_WREG] = add((uint8_t)op, w(), 0);
+            break;
+        case 0x3F: {                                // MOVIW/MOVWI k[n]
+            int n = (op >> 6) & 1;
+            uint16_t fsr = (uint16_t)(get_fsr(n) + sext(op, 6));
+            if(op & 0x80) {
+                write_fsr(fsr, w());
+            }
+            else {
+                cpu.ram[R_WREG] = read_fsr(fsr);
+                set_flags(STATUS_Z, z_flag(w()));
+            }
+            break;
+        }
+    }
+    if(cpu.error) {
+        return;
+    }
+    if(isr.active && !retfie && cpu.next_pc != ((pc + 1) & PC_MASK)) {
+        isr.hash = fnv(fnv(isr.hash, pc), cpu.next_pc);
+    }
+    if(retfie) {
+        interrupt_return();
+    }
+
+    tick(cpu.cycles);
+    stats.pc_cycles[pc] += cpu.cycles;
+    ++stats.instructions;
+    if(returned) {
+        frame_done();
+        if(retfie && isr.active) {
+            path_done();
+        }
+    }
+    cpu.pc = cpu.next_pc;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Loading
+////////////////////////////////////////////////////////////////////////////////
+
+static int hex_byte(const char *s) {
+    int value;
+    return (sscanf(s, "%2x", &value) == 1) ? value : -1;
+}
+
+static void load_hex(const char *path) {
+    FILE *file = fopen(path, "r");
+    if(!file) {
+        perror(path);
+        exit(1);
+    }
+    for(int i=0; i<PROG_WORDS; ++i) {
+        cpu.prog[i] = 0x3FFF;
+    }
+    memset(cpu.eeprom, 0xFF, sizeof(cpu.eeprom));
+    cpu.config[0] = cpu.config[1] = 0x3FFF;
+
+    char line[600];
+    unsigned long base = 0;
+    int line_num = 0;
+    int words = 0;
+    while(fgets(line, sizeof(line), file)) {
+        ++line_num;
+        line[strcspn(line, "\r\n")] = 0;
+        if(!line[0]) {
+            continue;
+        }
+        uint8_t record[256 + 5];
+        int len = (int)strlen(line);
+        int count = (len - 1) / 2;
+        int sum = 0;
+        int ok = (line[0] == ':' && len % 2 == 1 && count >= 5);
+        for(int i=0; ok && i<count; ++i) {
+            int byte = hex_byte(line + 1 + 2*i);
+            ok = (byte >= 0);
+            record[i] = (uint8_t)byte;
+            sum += byte;
+        }
+        if(!ok || record[0] + 5 != count || (sum & 0xFF)) {
+            fprintf(stderr, "%s:%d: bad hex record\n", path, line_num);
+            exit(1);
+        }
+        unsigned addr = (record[1] << 8) | record[2];
+        const uint8_t *data = record + 4;
+        switch(record[3]) {
+            case 0:
+                for(int i=0; i<record[0]; ++i) {
+                    unsigned long byte_addr = base + addr + i;
+                    unsigned long word = byte_addr >> 1;
+                    int shift = (byte_addr & 1) ? 8 : 0;
+                    uint16_t keep = (uint16_t)~(0xFF << shift);
+                    if(word < PROG_SIZE) {
+                        cpu.prog[word] = (uint16_t)(((cpu.prog[word] & keep) |
+                            (data[i] << shift)) & 0x3FFF);
+                        words += !shift;
+                    }
+                    else if(word >= CONFIG_HEX_ADDR && word < CONFIG_HEX_ADDR + 2) {
+                        uint16_t *config = &cpu.config[word - CONFIG_HEX_ADDR];
+                        *config = (uint16_t)(((*config & keep) | (data[i] << shift)) & 0x3FFF);
+                    }
+                    else if(word >= EEPROM_HEX_ADDR && word < EEPROM_HEX_ADDR + EEPROM_SIZE) {
+                        if(!shift) {
+                            cpu.eeprom[word - EEPROM_HEX_ADDR] = data[i];
+                        }
+                    }
+                }
+                break;
+            case 1:
+                fclose(file);
+                if(!words) {
+                    fprintf(stderr, "%s: no program\n", path);
+                    exit(1);
+                }
+                return;
+            case 2:
+                base = (unsigned long)((data[0] << 8) | data[1]) << 4;
+                break;
+            case 4:
+                base = (unsigned long)((data[0] << 8) | data[1]) << 16;
+                break;
+        }
+    }
+    fprintf(stderr, "%s: no end record\n", path);
+    exit(1);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static int compare_symbols(const void *a, const void *b) {
+    return (int)((const SYMBOL *)a)->addr - (int)((const SYMBOL *)b)->addr;
+}
+
+static void add_symbol(uint16_t addr, const char *name) {
+    static int size;
+    if(num_symbols == size) {
+        size = size ? 2 * size : 256;
+        symbols = realloc(symbols, size * sizeof(SYMBOL));
+        if(!symbols) {
+            fprintf(stderr, "pic_sim: out of memory\n");
+            exit(1);
+        }
+    }
+    symbols[num_symbols].addr = addr;
+    symbols[num_symbols].name = strdup(name);
+    ++num_symbols;
+}
+
+static void load_symbols(const char *path) {
+    FILE *file = fopen(path, "r");
+    if(!file) {
+        perror(path);
+        exit(1);
+    }
+    char line[512];
+    char name[256], value[64], class[64];
+    while(fgets(line, sizeof(line), file)) {
+        int fields = sscanf(line, "%255s %63s %63s", name, value, class);
+        char *end;
+        unsigned long addr = strtoul(value, &end, 16);
+        if(fields < 2 || *end || end == value || addr >= PROG_SIZE ||
+            (fields == 3 && strcmp(class, "CODE") &&
+                (strspn(class, "0123456789") != strlen(class))))
+        {
+            continue;
+        }
+        add_symbol((uint16_t)addr, name);
+    }
+    fclose(file);
+    qsort(symbols, num_symbols, sizeof(SYMBOL), compare_symbols);
+}
+
+// without a symbol table, name functions by the addresses called
+static void call_symbols() {
+    char name[16];
+    for(int addr=0; addr<PROG_WORDS; ++addr) {
+        if(stats.func[addr].calls || !addr || addr == ISR_VECTOR) {
+            snprintf(name, sizeof(name), "%s%04X",
+                !addr ? "reset " : addr == ISR_VECTOR ? "isr " : "", addr);
+            add_symbol((uint16_t)addr, name);
+        }
+    }
+}
+
+// the symbol at or before addr, or -1
+static int find_symbol(unsigned addr) {
+    int lo = 0;
+    int hi = num_symbols - 1;
+    int found = -1;
+    while(lo <= hi) {
+        int mid = (lo + hi) / 2;
+        if(symbols[mid].addr <= addr) {
+            found = mid;
+            lo = mid + 1;
+        }
+        else {
+            hi = mid - 1;
+        }
+    }
+    return found;
+}
+
+static const char *func_name(unsigned addr) {
+    static char name[300];
+    int i = find_symbol(addr);
+    if(i < 0) {
+        snprintf(name, sizeof(name), "%04X", addr);
+    }
+    else if(symbols[i].addr == addr) {
+        return symbols[i].name;
+    }
+    else {
+        snprintf(name, sizeof(name), "%s+%X", symbols[i].name, addr - symbols[i].addr);
+    }
+    return name;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Report
+////////////////////////////////////////////////////////////////////////////////
+
+static const char *sources_name(uint32_t sources) {
+    static char name[128];
+    name[0] = 0;
+    for(int i=0; i<32; ++i) {
+        if(sources & (1U << i)) {
+            char part[16];
+            snprintf(part, sizeof(part), "%s%s", name[0] ? "+" : "",
+                source_names[i] ? source_names[i] : "?");
+            strncat(name, part, sizeof(name) - strlen(name) - 1);
+        }
+    }
+    return name;
+}
+
+static int compare_paths(const void *a, const void *b) {
+    const PATH *pa = a;
+    const PATH *pb = b;
+    return (pa->total < pb->total) - (pa->total > pb->total);
+}
+
+static void sort_paths() {
+    qsort(stats.paths, stats.num_paths, sizeof(PATH), compare_paths);
+}
+
+typedef struct {
+    int symbol;
+    uint64_t self;
+    FUNC func;
+} REPORT_FUNC;
+
+static int compare_report_funcs(const void *a, const void *b) {
+    const REPORT_FUNC *fa = a;
+    const REPORT_FUNC *fb = b;
+    uint64_t ka = fa->self > fa->func.total ? fa->self : fa->func.total;
+    uint64_t kb = fb->self > fb->func.total ? fb->self : fb->func.total;
+    return (ka < kb) - (ka > kb);
+}
+
+static void report(int max_paths, int max_funcs) {
+    uint64_t cycles = cpu.now - stats.start;
+    printf("\n%llu cycles (%.3f ms), %llu instructions\n",
+        (unsigned long long)cycles, cycles * cpu.tcy_ps / 1e9,
+        (unsigned long long)stats.instructions);
+    printf("ISR: %llu entries, %llu cycles (%.2f%%), longest %llu cycles at ",
+        (unsigned long long)stats.isr_entries, (unsigned long long)stats.isr_counted,
+        cycles ? 100.0 * stats.isr_counted / cycles : 0,
+        (unsigned long long)stats.isr_max);
+    print_time(stdout, stats.isr_max_ps);
+    printf("us\n");
+
+    // by sources
+    struct {
+        uint32_t sources;
+        uint64_t count;
+        uint64_t total;
+        uint64_t min;
+        uint64_t max;
+        int paths;
+    } sets[MAX_SOURCE_SETS];
+    int num_sets = 0;
+    for(int i=0; i<stats.num_paths; ++i) {
+        PATH *path = &stats.paths[i];
+        int j;
+        for(j=0; j<num_sets && sets[j].sources != path->sources; ++j) {
+        }
+        if(j == MAX_SOURCE_SETS) {
+            continue;
+        }
+        if(j == num_sets) {
+            memset(&sets[j], 0, sizeof(sets[j]));
+            sets[j].sources = path->sources;
+            sets[j].min = path->min;
+            ++num_sets;
+        }
+        sets[j].count += path->count;
+        sets[j].total += path->total;
+        sets[j].paths++;
+        if(path->min < sets[j].min) {
+            sets[j].min = path->min;
+        }
+        if(path->max > sets[j].max) {
+            sets[j].max = path->max;
+        }
+    }
+    printf("\n%-24s %10s %6s %8s %8s %8s %7s\n",
+        "sources", "count", "paths", "min", "mean", "max", "cpu%");
+    for(int i=0; i<num_sets; ++i) {
+        printf("%-24s %10llu %6d %8llu %8.1f %8llu %7.2f\n", sources_name(sets[i].sources),
+            (unsigned long long)sets[i].count, sets[i].paths,
+            (unsigned long long)sets[i].min, (double)sets[i].total / sets[i].count,
+            (unsigned long long)sets[i].max, cycles ? 100.0 * sets[i].total / cycles : 0);
+    }
+
+    // by path
+    printf("\n%4s %-24s %10s %8s %8s  %s\n", "path", "sources", "count", "cycles", "max", "calls");
+    for(int i=0; i<stats.num_paths && i<max_paths; ++i) {
+        PATH *path = &stats.paths[i];
+        printf("%4d %-24s %10llu %8llu %8llu  ", i + 1, sources_name(path->sources),
+            (unsigned long long)path->count, (unsigned long long)path->min,
+            (unsigned long long)path->max);
+        for(int j=0; j<path->num_calls && j<MAX_PATH_CALLS; ++j) {
+            printf("%s%s", j ? " " : "", func_name(path->calls[j]));
+        }
+        if(path->num_calls > MAX_PATH_CALLS) {
+            printf(" ...");
+        }
+        printf("\n");
+    }
+    if(stats.num_paths > max_paths) {
+        printf("     and %d more paths\n", stats.num_paths - max_paths);
+    }
+    if(stats.lost_paths) {
+        printf("     %llu entries on paths not kept\n", (unsigned long long)stats.lost_paths);
+    }
+
+    // by function
+    if(!num_symbols) {
+        call_symbols();
+    }
+    REPORT_FUNC *funcs = calloc(num_symbols, sizeof(REPORT_FUNC));
+    for(int i=0; i<num_symbols; ++i) {
+        funcs[i].symbol = i;
+        funcs[i].func = stats.func[symbols[i].addr];
+    }
+    for(unsigned addr=0; addr<PROG_WORDS; ++addr) {
+        if(stats.pc_cycles[addr]) {
+            int i = find_symbol(addr);
+            if(i >= 0) {
+                funcs[i].self += stats.pc_cycles[addr];
+            }
+        }
+    }
+    qsort(funcs, num_symbols, sizeof(REPORT_FUNC), compare_report_funcs);
+    printf("\n%-28s %10s %12s %7s %12s %8s %8s %8s\n", "function", "calls", "self",
+        "self%", "total", "min", "mean", "max");
+    for(int i=0; i<num_symbols && i<max_funcs; ++i) {
+        REPORT_FUNC *f = &funcs[i];
+        if(!f->self && !f->func.calls) {
+            break;
+        }
+        printf("%-28s %10llu %12llu %7.2f %12llu %8llu %8.1f %8llu\n",
+            symbols[f->symbol].name, (unsigned long long)f->func.calls,
+            (unsigned long long)f->self, cycles ? 100.0 * f->self / cycles : 0,
+            (unsigned long long)f->func.total, (unsigned long long)f->func.min,
+            f->func.calls ? (double)f->func.total / f->func.calls : 0,
+            (unsigned long long)f->func.max);
+    }
+    free(funcs);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+int main(int argc, char *argv[]) {
+    double run_ms = 1000;
+    double warm_ms = 0;
+    int max_paths = 20;
+    int max_funcs = 40;
+    const char *symbol_path = 0;
+    int opt;
+    while((opt = getopt(argc, argv, "t:w:s:i:lu:p:f:")) != -1) {
+        switch(opt) {
+            case 't': run_ms = atof(optarg); break;
+            case 'w': warm_ms = atof(optarg); break;
+            case 's': symbol_path = optarg; break;
+            case 'i': input.path = optarg; break;
+            case 'l': log_pins = 1; break;
+            case 'u':
+                uart_out = fopen(optarg, "wb");
+                if(!uart_out) {
+                    perror(optarg);
+                    return 1;
+                }
+                break;
+            case 'p': max_paths = atoi(optarg); break;
+            case 'f': max_funcs = atoi(optarg); break;
+            default:
+                fprintf(stderr, "usage: pic_sim [-t ms] [-w ms] [-s symbols] "
+                    "[-i inputs] [-l] [-u uart_file] [-p paths] [-f functions] "
+                    "firmware.hex\n");
+                return 1;
+        }
+    }
+    if(optind != argc - 1) {
+        fprintf(stderr, "pic_sim: no hex file\n");
+        return 1;
+    }
+    load_hex(argv[optind]);
+    if(symbol_path) {
+        load_symbols(symbol_path);
+    }
+    if(input.path) {
+        input.file = fopen(input.path, "r");
+        if(!input.file) {
+            perror(input.path);
+            return 1;
+        }
+        read_input();
+    }
+
+    reset();
+    long long warm_ps = (long long)(warm_ms * 1e9);
+    long long end_ps = (long long)((warm_ms + run_ms) * 1e9);
+    int counting = 0;
+    uint64_t next_sort = 1000;
+    while(!cpu.error && cpu.now_ps < end_ps) {
+        if(!counting && cpu.now_ps >= warm_ps) {
+            reset_stats();
+            counting = 1;
+        }
+        step();
+        if(stats.isr_entries >= next_sort) {
+            sort_paths();
+            next_sort *= 4;
+        }
+    }
+    if(cpu.error) {
+        fprintf(stderr, "pic_sim: %s at %04X (%s), ", cpu.error, cpu.pc, func_name(cpu.pc));
+        print_time(stderr, cpu.now_ps);
+        fprintf(stderr, "us\n");
+    }
+    sort_paths();
+    report(max_paths, max_funcs);
+    if(uart_out) {
+        fclose(uart_out);
+    }
+    return cpu.error ? 1 : 0;
+}
@@ -0,0 +1,1593 @@
+; Test program for pic_sim: the core. 120 random ALU operations, each
+; followed by its result and the C, DC and Z flags, then indirect access
+; with MOVIW and MOVWI in their different modes, linear and program memory
+; access through FSR, BRW and computed goto tables, CALLW, DECFSZ, INCFSZ,
+; BTFSC, BTFSS and a call across pages. Each result is sent out of the UART.
+;
+; alu.uart has the bytes sent. The results and flags were worked out apart
+; from the simulator; the flags an instruction leaves alone are as the
+; simulator leaves them.
+;
+        ORG 0
+        GOTO start
+        ORG 4
+        RETFIE
+start:
+        MOVLB 3
+        MOVLW 0
+        MOVWF 0x1B
+        MOVLW 0x24
+        MOVWF 0x1E
+        MOVLW 0x80
+        MOVWF 0x1D
+        MOVLB 0
+        MOVLW 121
+        MOVWF 0x20
+        MOVLW 66
+        BSF 3,0
+        ANDWF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 33
+        MOVWF 0x20
+        MOVLW 6
+        BSF 3,0
+        LSLF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 119
+        MOVWF 0x20
+        MOVLW 98
+        BSF 3,0
+        XORWF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 243
+        MOVWF 0x20
+        MOVLW 203
+        BCF 3,0
+        RLF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 77
+        MOVWF 0x20
+        MOVLW 199
+        BCF 3,0
+        ADDWFC 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 81
+        MOVWF 0x20
+        MOVLW 21
+        BSF 3,0
+        ADDWF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 137
+        MOVWF 0x20
+        MOVLW 242
+        BSF 3,0
+        INCF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 202
+        MOVWF 0x20
+        MOVLW 227
+        BCF 3,0
+        COMF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 49
+        MOVWF 0x20
+        MOVLW 18
+        BCF 3,0
+        ANDWF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 111
+        MOVWF 0x20
+        MOVLW 132
+        BSF 3,0
+        LSRF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 215
+        MOVWF 0x20
+        MOVLW 197
+        BSF 3,0
+        XORWF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 208
+        MOVWF 0x20
+        MOVLW 118
+        BSF 3,0
+        ADDWF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 143
+        MOVWF 0x20
+        MOVLW 83
+        BSF 3,0
+        XORWF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 53
+        MOVWF 0x20
+        MOVLW 108
+        BSF 3,0
+        LSRF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 63
+        MOVWF 0x20
+        MOVLW 32
+        BSF 3,0
+        ANDWF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 45
+        MOVWF 0x20
+        MOVLW 176
+        BCF 3,0
+        INCF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 77
+        MOVWF 0x20
+        MOVLW 10
+        BSF 3,0
+        INCF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 212
+        MOVWF 0x20
+        MOVLW 60
+        BCF 3,0
+        SUBWF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 193
+        MOVWF 0x20
+        MOVLW 169
+        BSF 3,0
+        IORWF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 120
+        MOVWF 0x20
+        MOVLW 18
+        BSF 3,0
+        ADDWF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 39
+        MOVWF 0x20
+        MOVLW 55
+        BCF 3,0
+        RRF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 208
+        MOVWF 0x20
+        MOVLW 149
+        BSF 3,0
+        ADDLW 208
+        MOVWF 0x20
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 21
+        MOVWF 0x20
+        MOVLW 173
+        BSF 3,0
+        COMF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 70
+        MOVWF 0x20
+        MOVLW 193
+        BSF 3,0
+        DECF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 197
+        MOVWF 0x20
+        MOVLW 52
+        BSF 3,0
+        INCF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 121
+        MOVWF 0x20
+        MOVLW 154
+        BSF 3,0
+        LSLF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 155
+        MOVWF 0x20
+        MOVLW 173
+        BCF 3,0
+        INCF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 161
+        MOVWF 0x20
+        MOVLW 10
+        BSF 3,0
+        ADDLW 161
+        MOVWF 0x20
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 30
+        MOVWF 0x20
+        MOVLW 170
+        BSF 3,0
+        COMF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 180
+        MOVWF 0x20
+        MOVLW 142
+        BSF 3,0
+        ADDWF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 31
+        MOVWF 0x20
+        MOVLW 10
+        BSF 3,0
+        LSLF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 233
+        MOVWF 0x20
+        MOVLW 152
+        BSF 3,0
+        SUBLW 233
+        MOVWF 0x20
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 186
+        MOVWF 0x20
+        MOVLW 94
+        BSF 3,0
+        COMF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 135
+        MOVWF 0x20
+        MOVLW 153
+        BSF 3,0
+        SUBWFB 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 13
+        MOVWF 0x20
+        MOVLW 67
+        BSF 3,0
+        IORWF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 113
+        MOVWF 0x20
+        MOVLW 137
+        BCF 3,0
+        ASRF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 95
+        MOVWF 0x20
+        MOVLW 222
+        BCF 3,0
+        SUBWFB 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 164
+        MOVWF 0x20
+        MOVLW 170
+        BCF 3,0
+        DECF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 86
+        MOVWF 0x20
+        MOVLW 40
+        BSF 3,0
+        RRF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 230
+        MOVWF 0x20
+        MOVLW 138
+        BCF 3,0
+        SUBWFB 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 17
+        MOVWF 0x20
+        MOVLW 97
+        BSF 3,0
+        SUBLW 17
+        MOVWF 0x20
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 142
+        MOVWF 0x20
+        MOVLW 174
+        BCF 3,0
+        COMF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 66
+        MOVWF 0x20
+        MOVLW 215
+        BSF 3,0
+        IORWF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 138
+        MOVWF 0x20
+        MOVLW 237
+        BSF 3,0
+        INCF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 148
+        MOVWF 0x20
+        MOVLW 214
+        BSF 3,0
+        SUBWF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 211
+        MOVWF 0x20
+        MOVLW 79
+        BCF 3,0
+        ADDWF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 244
+        MOVWF 0x20
+        MOVLW 222
+        BCF 3,0
+        SUBWF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 233
+        MOVWF 0x20
+        MOVLW 147
+        BSF 3,0
+        RLF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 34
+        MOVWF 0x20
+        MOVLW 146
+        BCF 3,0
+        RLF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 23
+        MOVWF 0x20
+        MOVLW 17
+        BCF 3,0
+        INCF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 25
+        MOVWF 0x20
+        MOVLW 6
+        BSF 3,0
+        SUBWFB 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 87
+        MOVWF 0x20
+        MOVLW 153
+        BCF 3,0
+        ADDWF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 211
+        MOVWF 0x20
+        MOVLW 27
+        BCF 3,0
+        ASRF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 64
+        MOVWF 0x20
+        MOVLW 129
+        BSF 3,0
+        SUBWF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 180
+        MOVWF 0x20
+        MOVLW 113
+        BCF 3,0
+        SUBWFB 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 61
+        MOVWF 0x20
+        MOVLW 87
+        BCF 3,0
+        LSLF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 65
+        MOVWF 0x20
+        MOVLW 3
+        BSF 3,0
+        SWAPF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 25
+        MOVWF 0x20
+        MOVLW 138
+        BCF 3,0
+        LSLF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 216
+        MOVWF 0x20
+        MOVLW 26
+        BSF 3,0
+        ASRF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 0
+        MOVWF 0x20
+        MOVLW 28
+        BCF 3,0
+        SUBWF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 63
+        MOVWF 0x20
+        MOVLW 25
+        BCF 3,0
+        ANDWF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 16
+        MOVWF 0x20
+        MOVLW 44
+        BSF 3,0
+        ASRF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 80
+        MOVWF 0x20
+        MOVLW 161
+        BCF 3,0
+        COMF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 197
+        MOVWF 0x20
+        MOVLW 199
+        BSF 3,0
+        COMF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 135
+        MOVWF 0x20
+        MOVLW 97
+        BSF 3,0
+        INCF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 63
+        MOVWF 0x20
+        MOVLW 65
+        BCF 3,0
+        SWAPF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 40
+        MOVWF 0x20
+        MOVLW 91
+        BCF 3,0
+        COMF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 235
+        MOVWF 0x20
+        MOVLW 194
+        BCF 3,0
+        INCF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 27
+        MOVWF 0x20
+        MOVLW 190
+        BSF 3,0
+        ASRF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 215
+        MOVWF 0x20
+        MOVLW 214
+        BSF 3,0
+        ADDWF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 125
+        MOVWF 0x20
+        MOVLW 111
+        BSF 3,0
+        ADDWFC 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 217
+        MOVWF 0x20
+        MOVLW 114
+        BSF 3,0
+        ADDLW 217
+        MOVWF 0x20
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 14
+        MOVWF 0x20
+        MOVLW 166
+        BSF 3,0
+        XORWF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 134
+        MOVWF 0x20
+        MOVLW 62
+        BSF 3,0
+        SUBWFB 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 192
+        MOVWF 0x20
+        MOVLW 55
+        BSF 3,0
+        XORWF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 52
+        MOVWF 0x20
+        MOVLW 2
+        BSF 3,0
+        ADDLW 52
+        MOVWF 0x20
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 120
+        MOVWF 0x20
+        MOVLW 199
+        BCF 3,0
+        IORWF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 47
+        MOVWF 0x20
+        MOVLW 50
+        BSF 3,0
+        SUBLW 47
+        MOVWF 0x20
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 12
+        MOVWF 0x20
+        MOVLW 174
+        BCF 3,0
+        ADDWF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 58
+        MOVWF 0x20
+        MOVLW 246
+        BSF 3,0
+        LSRF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 45
+        MOVWF 0x20
+        MOVLW 18
+        BCF 3,0
+        SUBWFB 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 51
+        MOVWF 0x20
+        MOVLW 31
+        BSF 3,0
+        SUBLW 51
+        MOVWF 0x20
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 39
+        MOVWF 0x20
+        MOVLW 123
+        BCF 3,0
+        RLF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 232
+        MOVWF 0x20
+        MOVLW 201
+        BSF 3,0
+        COMF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 203
+        MOVWF 0x20
+        MOVLW 179
+        BSF 3,0
+        ADDWFC 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 192
+        MOVWF 0x20
+        MOVLW 120
+        BSF 3,0
+        SUBLW 192
+        MOVWF 0x20
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 212
+        MOVWF 0x20
+        MOVLW 247
+        BCF 3,0
+        SWAPF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 76
+        MOVWF 0x20
+        MOVLW 83
+        BCF 3,0
+        ANDWF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 247
+        MOVWF 0x20
+        MOVLW 226
+        BCF 3,0
+        ADDLW 247
+        MOVWF 0x20
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 136
+        MOVWF 0x20
+        MOVLW 101
+        BCF 3,0
+        IORWF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 161
+        MOVWF 0x20
+        MOVLW 118
+        BSF 3,0
+        INCF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 136
+        MOVWF 0x20
+        MOVLW 111
+        BSF 3,0
+        ADDWF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 137
+        MOVWF 0x20
+        MOVLW 245
+        BSF 3,0
+        RRF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 88
+        MOVWF 0x20
+        MOVLW 184
+        BCF 3,0
+        ASRF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 247
+        MOVWF 0x20
+        MOVLW 73
+        BSF 3,0
+        ANDWF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 105
+        MOVWF 0x20
+        MOVLW 239
+        BCF 3,0
+        ANDWF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 37
+        MOVWF 0x20
+        MOVLW 204
+        BCF 3,0
+        DECF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 117
+        MOVWF 0x20
+        MOVLW 120
+        BCF 3,0
+        RRF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 130
+        MOVWF 0x20
+        MOVLW 123
+        BCF 3,0
+        LSLF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 70
+        MOVWF 0x20
+        MOVLW 95
+        BCF 3,0
+        LSLF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 86
+        MOVWF 0x20
+        MOVLW 23
+        BSF 3,0
+        SUBLW 86
+        MOVWF 0x20
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 216
+        MOVWF 0x20
+        MOVLW 46
+        BCF 3,0
+        SUBWFB 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 47
+        MOVWF 0x20
+        MOVLW 135
+        BSF 3,0
+        SUBWF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 182
+        MOVWF 0x20
+        MOVLW 231
+        BSF 3,0
+        ADDWF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 15
+        MOVWF 0x20
+        MOVLW 171
+        BSF 3,0
+        INCF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 194
+        MOVWF 0x20
+        MOVLW 248
+        BCF 3,0
+        RRF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 250
+        MOVWF 0x20
+        MOVLW 200
+        BCF 3,0
+        XORWF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 163
+        MOVWF 0x20
+        MOVLW 61
+        BSF 3,0
+        ADDWFC 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 221
+        MOVWF 0x20
+        MOVLW 57
+        BSF 3,0
+        IORWF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 128
+        MOVWF 0x20
+        MOVLW 49
+        BSF 3,0
+        COMF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 230
+        MOVWF 0x20
+        MOVLW 151
+        BSF 3,0
+        SUBWFB 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 173
+        MOVWF 0x20
+        MOVLW 58
+        BSF 3,0
+        IORWF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 180
+        MOVWF 0x20
+        MOVLW 30
+        BSF 3,0
+        SUBLW 180
+        MOVWF 0x20
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 76
+        MOVWF 0x20
+        MOVLW 91
+        BSF 3,0
+        DECF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 63
+        MOVWF 0x20
+        MOVLW 55
+        BCF 3,0
+        ASRF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 215
+        MOVWF 0x20
+        MOVLW 153
+        BCF 3,0
+        DECF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 246
+        MOVWF 0x20
+        MOVLW 159
+        BCF 3,0
+        ADDWFC 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 54
+        MOVWF 0x20
+        MOVLW 92
+        BSF 3,0
+        COMF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 51
+        MOVWF 0x20
+        MOVLW 136
+        BSF 3,0
+        SWAPF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 27
+        MOVWF 0x20
+        MOVLW 69
+        BCF 3,0
+        ANDWF 0x20,F
+        MOVF 3,W
+        MOVWF 0x21
+        MOVF 0x20,W
+        CALL send
+        MOVF 0x21,W
+        ANDLW 7
+        CALL send
+        MOVLW 0x20
+        MOVWF 4
+        MOVLW 0x20
+        MOVWF 5
+        MOVLW 0x5A
+        MOVWI FSR0++
+        MOVLW 0x6B
+        MOVWI FSR0++
+        MOVLW 0x7C
+        MOVWI 2[0]
+        MOVLB 0
+        MOVF 0x40,W
+        CALL send
+        MOVF 0x41,W
+        CALL send
+        MOVF 0x44,W
+        CALL send
+        MOVIW --FSR0
+        CALL send
+        MOVIW FSR0--
+        CALL send
+        MOVIW 0[0]
+        CALL send
+        MOVLW 0x50
+        MOVWF 6
+        MOVLW 0x20
+        MOVWF 7
+        MOVLW 0x99
+        MOVWI 0[1]
+        MOVLB 1
+        MOVF 0x20,W
+        MOVLB 0
+        CALL send
+        MOVLW low(table)
+        MOVWF 4
+        MOVLW 0x80|(table>>8)
+        MOVWF 5
+        MOVIW FSR0++
+        CALL send
+        MOVIW 0[0]
+        CALL send
+        MOVLW 2
+        CALL jt
+        CALL send
+        MOVLP high(ct)
+        MOVLW 1
+        CALL ct
+        MOVLP 0
+        CALL send
+        MOVLP high(cw)
+        MOVLW low(cw)
+        CALLW
+        MOVLP 0
+        CALL send
+        MOVLW 5
+        MOVWF 0x22
+        CLRF 0x23
+lp:
+        INCF 0x23,F
+        DECFSZ 0x22,F
+        BRA lp
+        MOVF 0x23,W
+        CALL send
+        MOVLW 0xFE
+        MOVWF 0x22
+        INCFSZ 0x22,F
+        MOVLW 0x11
+        MOVLW 0x22
+        CALL send
+        INCFSZ 0x22,F
+        MOVLW 0x33
+        IORLW 0
+        CALL send
+        MOVLW 0x04
+        MOVWF 0x22
+        MOVLW 1
+        BTFSC 0x22,2
+        MOVLW 2
+        CALL send
+        MOVLW 1
+        BTFSS 0x22,2
+        MOVLW 2
+        CALL send
+        MOVLP high(far)
+        CALL far
+        MOVLP 0
+        CALL send
+done:
+        GOTO done
+send:
+        MOVLB 0
+w1:
+        BTFSS 0x11,4
+        GOTO w1
+        MOVLB 3
+        MOVWF 0x1A
+        MOVLB 0
+        RETURN
+jt:
+        BRW
+        RETLW 0xA0
+        RETLW 0xA1
+        RETLW 0xA2
+        RETLW 0xA3
+ct:
+        ADDWF 2,F
+        RETLW 0xB0
+        RETLW 0xB1
+        RETLW 0xB2
+table:
+        ADDLW 0x12
+        ADDLW 0x34
+        ORG 0x700
+cw:
+        RETLW 0xC5
+        ORG 0x900
+far:
+        RETLW 0xD7
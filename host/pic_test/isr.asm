@@ -0,0 +1,136 @@
+; Test program for pic_sim: cycle counts and peripherals. Run with the
+; inputs in isr.in (AN2 at 1000, ten falling edges on RA5) and the symbols
+; in isr.sym. Counted by hand, including the 2 cycles to enter the ISR:
+;
+;   TMR0 path   16  entry 2, BTFSS skip 2, 5 x 1, BTFSC skip 2 (or 1 + 1
+;                   for the INCF), BTFSS 1, BRA 2, RETFIE 2
+;   IOC path    16  entry 2, BTFSS 1, BRA 2, BTFSS skip 2, MOVLB 1, BCF 1,
+;                   on_ioc 5, RETFIE 2
+;   on_ioc       5  CALL 2, INCF 1, RETURN 2
+;   work       305  CALL 2, 2 x 1, 99 x (DECFSZ 1, BRA 2), DECFSZ skip 2,
+;                   RETURN 2
+;
+; The UART sends ADRESH for AN2 at 1000 (0xFA), EEPROM address 0 (0x77),
+; TMR1H after the 4ms EEPROM write at 500kHz (0x07) and EEPROM address 5
+; after the write (0x42).
+;
+        ORG 0
+        GOTO start
+        ORG 4
+isr:
+        BTFSS 0x0B,2
+        BRA not_t0
+        MOVLB 0
+        MOVLW 5
+        MOVWF 0x15
+        BCF 0x0B,2
+        INCF 0x70,F
+        BTFSC 3,2
+        INCF 0x71,F
+not_t0:
+        BTFSS 0x0B,0
+        BRA not_ioc
+        MOVLB 7
+        BCF 0x13,5
+        CALL on_ioc
+not_ioc:
+        RETFIE
+on_ioc:
+        INCF 0x72,F
+        RETURN
+start:
+        MOVLB 1
+        MOVLW 0x7A
+        MOVWF 0x19              ; OSCCON 16MHz
+        MOVLW 0x03
+        MOVWF 0x15              ; OPTION_REG prescale 1:16
+        MOVLW 0xEF
+        MOVWF 0x0E              ; TRISC, RC4 output
+        MOVLW 0x20
+        MOVWF 0x1E              ; ADCON1 Fosc/32
+        MOVLW 0x09
+        MOVWF 0x1D              ; ADCON0 AN2, ADON
+        BSF 0x1D,1              ; GO
+adc_wait:
+        BTFSC 0x1D,1
+        BRA adc_wait
+        MOVF 0x1C,W
+        MOVWF 0x73              ; ADRESH
+; eeprom read of address 0 (from hex) and write of 0x42 to address 5
+        MOVLB 3
+        CLRF 0x11
+        BCF 0x15,7
+        BCF 0x15,6
+        BSF 0x15,0
+        MOVF 0x13,W
+        MOVWF 0x74
+        MOVLB 0
+        MOVLW 0x31              ; T1CON: Fosc/4, 1:8, on
+        MOVWF 0x18
+        MOVLB 3
+        MOVLW 5
+        MOVWF 0x11
+        MOVLW 0x42
+        MOVWF 0x13
+        BSF 0x15,2
+        MOVLW 0x55
+        MOVWF 0x16
+        MOVLW 0xAA
+        MOVWF 0x16
+        BSF 0x15,1
+        BCF 0x15,2
+ee_wait:
+        BTFSC 0x15,1
+        BRA ee_wait
+        MOVLB 0
+        MOVF 0x17,W             ; TMR1H
+        MOVWF 0x75
+        MOVLB 3
+        MOVLW 5
+        MOVWF 0x11
+        BSF 0x15,0
+        MOVF 0x13,W
+        MOVWF 0x76
+; uart
+        MOVLW 0
+        MOVWF 0x1B
+        MOVLW 0x24
+        MOVWF 0x1E
+        MOVLW 0x80
+        MOVWF 0x1D
+        MOVF 0x73,W
+        CALL send
+        MOVF 0x74,W
+        CALL send
+        MOVF 0x75,W
+        CALL send
+        MOVF 0x76,W
+        CALL send
+; interrupts
+        MOVLB 7
+        MOVLW 0x20
+        MOVWF 0x12              ; IOCAN RA5
+        MOVLW 0xE8
+        MOVWF 0x0B              ; GIE PEIE T0IE IOCIE
+main_loop:
+        CALL work
+        MOVLB 2
+        MOVLW 0x10
+        XORWF 0x0E,F            ; toggle LATC4
+        GOTO main_loop
+work:
+        MOVLW 100
+        MOVWF 0x20
+work_loop:
+        DECFSZ 0x20,F
+        BRA work_loop
+        RETURN
+send:
+        MOVLB 0
+send_wait:
+        BTFSS 0x11,4
+        BRA send_wait
+        MOVLB 3
+        MOVWF 0x1A
+        RETURN
+        DE 0,0x77
@@ -0,0 +1,491 @@
+/*
+ The firmware built for the host simulator (see fw.h). All the firmware
+ sources are included into this one file, so that the model below can see
+ the state of every module. That is needed to fast forward: fw_idle_ms()
+ works out how many ms ticks would change nothing but counters, timeouts 
+ and (if they are not watched) the output pins, and fw_skip() moves those
+ on as if the ticks had been run. Anything added
+ to the ms ISR or the periodic tasks needs adding to both.
+
+ The peripherals are modelled as far as the firmware uses them:
+
+ - Timer 0 ticks each ms. Its count is set to the time within the ms when
+   an input interrupt is run.
+ - Timer 1 is stopped, as the run time of the firmware is not modelled. The
+   CPU load meter will read 100%.
+ - The ADC finishes one conversion each ms, with the reading of the pot on
+   the selected channel.
+ - Each EEPROM write takes FW_EE_WRITE_MS.
+ - The UART sends one byte each ms (about 9600 baud). What is sent is not
+   kept.
+ */
+#include <string.h>
+#include "fw.h"
+
+void fw_event(unsigned char type, unsigned char data);
+#define TRACE_EVENT_ISR(type, data) fw_event(type, data)
+#define TRACE_EVENT(type, data)     fw_event(type, data)
+
+#include "../../d-ticker.X/bbox.c"
+#include "../../d-ticker.X/clock.c"
+#include "../../d-ticker.X/leds.c"
+#define main fw_main
+#include "../../d-ticker.X/main.c"
+#undef main
+#include "../../d-ticker.X/output.c"
+#include "../../d-ticker.X/pattern.c"
+#include "../../d-ticker.X/pots.c"
+#include "../../d-ticker.X/sched.c"
+#include "../../d-ticker.X/seq.c"
+#include "../../d-ticker.X/stats.c"
+#include "../../d-ticker.X/store.c"
+#include "../../d-ticker.X/timing.c"
+#include "../../d-ticker.X/uart_debug.c"
+#include "../../d-ticker.X/ui.c"
+
+volatile unsigned char PORTA, LATA, LATC, TRISA, TRISC, INTCON, PIR1, PIE1,
+    PIR2, PIE2, IOCAF, OPTION_REG, ADCON0, TXSTA, RCSTA, BAUDCON, EECON1;
+volatile unsigned char PORTC, OSCCON, ANSELA, ANSELC, WPUA, WPUC, IOCAN,
+    IOCAP, ADCON1, ADRESH, TMR0, T1CON, TMR1L, TMR1H, TXREG, RCREG, SPBRG,
+    SPBRGH, EEADRL, EEADRH, EECON2, EEDATH;
+
+enum {
+    FW_TMR0_START = 5,          // timer 0 count at the start of each ms
+    FW_TMR0_PER_TICK = 251,     // counts to the overflow, as on the chip
+    FW_EE_WRITE_MS = 4
+};
+#define FW_NEVER 0x7FFFFFFFL
+
+static struct {
+    unsigned char pot[POTS_COUNT];
+    unsigned char eeprom[FW_EEPROM_SIZE];
+    volatile unsigned char eedatl;
+    int ee_busy_ms;             // ms until the write in progress is done
+    int sub_us;                 // time within the ms of the running code
+    FW_EVENT_HOOK hook;
+    void *hook_ctx;
+} hw;
+
+////////////////////////////////////////////////////////////////////////////////
+volatile unsigned char *sim_eedatl() {
+    if(EECON1bits.RD) {
+        EECON1bits.RD = 0;
+        hw.eedatl = hw.eeprom[EEADRL];
+    }
+    return &hw.eedatl;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void fw_event(unsigned char type, unsigned char data) {
+    if(hw.hook) {
+        hw.hook(hw.hook_ctx, type, data, hw.sub_us);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// start an EEPROM write if the firmware has asked for one
+static void check_eeprom() {
+    if(EECON1bits.WR) {
+        hw.eeprom[EEADRL] = hw.eedatl;
+        EECON1bits.WR = 0;
+        hw.ee_busy_ms = FW_EE_WRITE_MS;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static void interrupt() {
+    ISR();
+    check_eeprom();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// run the main loop until it has nothing to do
+static void run_main() {
+    do {
+        sched_run();
+        check_eeprom();
+    } while(!sched.idle);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// finish the ADC conversion on the selected channel
+static void adc_convert() {
+    static const signed char channel_pot[8] = { -1, -1, 3, -1, 2, 1, 0, -1 };
+    signed char pot = channel_pot[ADCON0bits.CHS & 7];
+    ADRESH = (pot < 0) ? 0 : hw.pot[(int)pot];
+    ADCON0bits.GO_nDONE = 0;
+    PIR1bits.ADIF = 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void fw_set_event_hook(FW_EVENT_HOOK hook, void *ctx) {
+    hw.hook = hook;
+    hw.hook_ctx = ctx;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Start the firmware in the same order as main(). From blank EEPROM the 
+// settings are then applied, otherwise those saved in the EEPROM are used
+void fw_power_on(const FW_SETTINGS *settings) {
+    FW_EVENT_HOOK hook = hw.hook;
+    void *hook_ctx = hw.hook_ctx;
+    memset(&hw, 0, sizeof(hw));
+    if(settings->eeprom) {
+        memcpy(hw.eeprom, settings->eeprom, sizeof(hw.eeprom));
+    }
+    else {
+        memset(hw.eeprom, 0xFF, sizeof(hw.eeprom));
+    }
+    memcpy(hw.pot, settings->pots, sizeof(hw.pot));
+    hw.hook = hook;
+    hw.hook_ctx = hook_ctx;
+    PORTA = 0b00111000;         // button up, no clock or reset
+    LATA = LATC = 0;
+    TRISA = TRIS_A;
+    TRISC = TRIS_C;
+    INTCON = PIR1 = PIE1 = PIR2 = PIE2 = IOCAF = 0;
+    TXSTA = 0b00000010;         // transmit shift register empty
+    RCSTA = 0;
+    TMR0 = FW_TMR0_START;
+    TMR1L = TMR1H = 0;
+
+    stats_init();
+    bbox_init();
+    out_init();
+    leds_init();
+    clk_init();
+    ui_init();
+    pat_init();
+    seq_init();
+    byte restored = store_init();
+    pots_init();
+    if(!restored) {
+        // the first scan of the pots, which main() waits for
+        while(!pots.scan_complete) {
+            adc_convert();
+            interrupt();
+        }
+        pots_wait_scan();
+        pat_recalc();
+    }
+    sched_init();
+    if(settings->eeprom) {
+        return;
+    }
+
+    clk_set_bpm(settings->bpm);
+    clk_set_num_steps(settings->num_steps);
+    clk_set_num_bars((byte)settings->num_bars);
+    seq_set_reset_mode((byte)settings->reset_mode);
+    pat_set_num_trigs(settings->num_trigs);
+    pat_set_curve((byte)settings->curve);
+    pat_recalc();
+
+    // saved as if set from the menus
+    store_set_bpm(settings->bpm);
+    store_set_num_steps((byte)settings->num_steps);
+    store_set_num_bars((byte)settings->num_bars);
+    store_set_reset_mode((byte)settings->reset_mode);
+    store_set_num_trigs((byte)settings->num_trigs);
+    store_set_curve((byte)settings->curve);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// run the next ms
+void fw_tick() {
+    hw.sub_us = 0;
+    TMR0 = FW_TMR0_START;
+    INTCONbits.T0IF = 1;
+    if(ADCON0bits.GO_nDONE) {
+        adc_convert();
+    }
+    if(hw.ee_busy_ms && !--hw.ee_busy_ms) {
+        PIR2bits.EEIF = 1;
+    }
+    PIR1bits.TXIF = 1;
+    interrupt();
+    run_main();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Timer 0 sub_us into the current ms. Ticks here are exactly 1ms, so the 
+// chip's 251 counts per tick are spread over the ms
+static unsigned char tmr0_at(int sub_us) {
+    return (unsigned char)(FW_TMR0_START + sub_us * FW_TMR0_PER_TICK / 1000);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// rising edge at the clock input, sub_us into the current ms
+void fw_clock_edge(int sub_us) {
+    hw.sub_us = sub_us;
+    TMR0 = tmr0_at(sub_us);
+    PORTAbits.RA5 = 0;
+    IOCAFbits.IOCAF5 = 1;
+    INTCONbits.IOCIF = 1;
+    interrupt();
+    PORTAbits.RA5 = 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// change of the reset input (the input pin is inverted)
+void fw_reset_input(int level, int sub_us) {
+    hw.sub_us = sub_us;
+    TMR0 = tmr0_at(sub_us);
+    PORTAbits.RA4 = !level;
+    IOCAFbits.IOCAF4 = 1;
+    INTCONbits.IOCIF = 1;
+    interrupt();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void fw_set_pot(int which, int value) {
+    hw.pot[which] = (unsigned char)value;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void fw_set_button(int pressed) {
+    PORTAbits.RA3 = !pressed;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// the data EEPROM as the firmware has written it so far
+const unsigned char *fw_eeprom() {
+    return hw.eeprom;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+int fw_outputs() {
+    int pos_led = 0;
+    if(!TRISAbits.TRISA0) {
+        if(!TRISCbits.TRISC5) {
+            pos_led = LATCbits.LATC5 ? 1 : 4;
+        }
+        else if(!TRISCbits.TRISC3) {
+            pos_led = LATCbits.LATC3 ? 3 : 2;
+        }
+    }
+    return (LATCbits.LATC4 ? FW_OUT_TRIG : 0) |
+        (LATAbits.LATA1 ? FW_OUT_CLOCK_LED : 0) |
+        (pos_led << FW_OUT_POS_LED_SHIFT);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// the tick on which a periodic task makes its run'th run from now
+static long task_tick(byte task, long run) {
+    return sched.countdown[task] + (run - 1) * task_def[task].period_ms;
+}
+
+// how many times a periodic task runs in the next ms ticks. Skips are made
+// between most external clock edges, so this avoids dividing if it can
+static long task_runs(byte task, long ms) {
+    long countdown = sched.countdown[task];
+    long period = task_def[task].period_ms;
+    if(ms < countdown) {
+        return 0;
+    }
+    return 1 + ((period == 1) ? ms - countdown : (ms - countdown) / period);
+}
+
+static long min_ms(long a, long b) {
+    return (a < b) ? a : b;
+}
+
+static long ceil_div(uint64_t a, uint64_t b) {
+    // a 32 bit division is quicker, and does for all but a phase wrap
+    uint64_t q = (a <= 0xFFFFFFFFU && b <= 0xFFFFFFFFU) ? 
+        (uint32_t)a / (uint32_t)b + ((uint32_t)a % (uint32_t)b != 0) : (a + b - 1) / b;
+    return (q > FW_NEVER) ? FW_NEVER : (long)q;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// ticks the clock can move on for before it is held at the end of the step,
+// up to limit. Most skips end before it is held, which needs no division
+static long clock_moves(long limit) {
+    if(!clk.ticks_per_ms) {
+        return 0;
+    }
+    if(!clk_flags.is_external_clock) {
+        return limit;
+    }
+    phase_t offset = clk.cur_ticks - (clk.ticks_at_next_step - clk.ticks_per_step);
+    if(offset >= clk.ticks_per_step) {
+        return 0;
+    }
+    if((uint64_t)offset + (uint64_t)limit * clk.ticks_per_ms < clk.ticks_per_step) {
+        return limit;
+    }
+    return min_ms(limit, (long)((clk.ticks_per_step - 1 - offset) / clk.ticks_per_ms));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// the first tick on which seq_run() will fire a trig or see the phase wrap,
+// if it is within limit ticks
+static long clock_event(long limit) {
+    uint64_t cur = clk.cur_ticks;
+    if((pos_t)(clk.cur_ticks >> (32 - POS_BITS)) < seq.prev_pos) {
+        // an external clock pulse rolled over, which seq_run() has not seen
+        return 1;
+    }
+    uint64_t trig = 0;
+    if(seq.cur_trig < pat_get_num_trigs()) {
+        trig = (uint64_t)pat_get_trig(seq.cur_trig) << (32 - POS_BITS);
+        if(trig <= cur) {
+            // due now, as after most external clock edges
+            return 1;
+        }
+    }
+    // the clock reaches cur + moves * ticks_per_ms, so only divide for 
+    // what it reaches
+    uint64_t reach = (uint64_t)clock_moves(limit) * clk.ticks_per_ms;
+    long event = FW_NEVER;
+    if(trig && trig - cur <= reach) {
+        event = ceil_div(trig - cur, clk.ticks_per_ms);
+    }
+    if(!clk_flags.is_external_clock && (1ULL << 32) - cur <= reach) {
+        event = min_ms(event, ceil_div((1ULL << 32) - cur, clk.ticks_per_ms));
+    }
+    return event;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// the run of leds_run() on which a timeout ends
+static long led_event(int timeout) {
+    return timeout ? task_tick(SCHED_LEDS, (timeout + LEDS_RUN_MS - 1) / LEDS_RUN_MS) : FW_NEVER;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// How many of the next ticks (up to limit) can be skipped. They must change
+// nothing but counters and timeouts, and no output. When the pins are not
+// watched, the end of a trig pulse, a queued trig and the end of an LED 
+// flash can be skipped too, as fw_skip() makes those changes
+long fw_idle_ms(long limit, int watch_pins) {
+    // the first tick on which something happens. That is often the next
+    // one after an external clock edge, so the clock is looked at first
+    long event = min_ms(limit + 1, clock_event(limit));
+    if(event <= 1 || clk_flags.pending_rate ||
+        (clk_flags.pending_restart && !clk_flags.is_external_clock) ||
+        clk_flags.restart_count != clk_main.restart_seen ||
+        stats_tick.reset_pending || pat_is_busy() || PIE1bits.TXIE ||
+        hw.ee_busy_ms || store.writing || bbox.dumping != BBOX_IDLE ||
+        ui.load_meter || ui.pot_move_done || leds.bar || ui.button_state == P_SWITCH ||
+        !ADCON0bits.GO_nDONE) {
+        return 0;
+    }
+    for(byte i=0; i<POTS_COUNT; ++i) {
+        if(pots.move_count[i] != pots.move_seen[i] ||
+            abs(hw.pot[i] - pots.reading[i]) >= POTS_MOVE_TOLERANCE) {
+            return 0;
+        }
+    }
+
+    event = min_ms(event, sched.load_countdown);
+    if(watch_pins) {
+        if(g_out.timeout > OUTPUT_PULSE_LOW_MS) {
+            event = min_ms(event, g_out.timeout - OUTPUT_PULSE_LOW_MS);
+        }
+        else if(g_out.requested != g_out.started) {
+            event = min_ms(event, g_out.timeout + 1);
+        }
+        event = min_ms(event, led_event(leds.pos_timeout));
+        event = min_ms(event, led_event(leds.clock_timeout));
+    }
+    if(ui.pot_move_timeout) {
+        event = min_ms(event, task_tick(SCHED_UI, ui.pot_move_timeout));
+    }
+    if(ui.button_state && ui.hold_timeout) {
+        event = min_ms(event, task_tick(SCHED_UI, ui.hold_timeout));
+    }
+    if(store.settings_pending || store.pattern_pending) {
+        event = min_ms(event, task_tick(SCHED_STORE,
+            (store.delay + STORE_RUN_MS - 1) / STORE_RUN_MS + 1));
+    }
+    return event - 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static int count_down(int value, long by) {
+    return (value > by) ? value - (int)by : 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Move on by ms ticks, no more than fw_idle_ms() said could be skipped
+void fw_skip(long ms) {
+    if(ms <= 0) {
+        return;
+    }
+    long runs[SCHED_NUM_PERIODIC];
+    for(byte i=0; i<SCHED_NUM_PERIODIC; ++i) {
+        runs[i] = task_runs(i, ms);
+    }
+    long leds_runs = runs[SCHED_LEDS];
+    long ui_runs = runs[SCHED_UI];
+    long store_runs = runs[SCHED_STORE];
+
+    // ISR, in which the trig pulse can end and queued trigs start
+    sched_tick_count += (byte)ms;
+    long out_ms = ms;
+    while(out_ms) {
+        if(g_out.timeout) {
+            long n = min_ms(out_ms, g_out.timeout);
+            g_out.timeout -= (byte)n;
+            out_ms -= n;
+            if(g_out.timeout <= OUTPUT_PULSE_LOW_MS) {
+                P_CLOCKOUT = 0;
+            }
+        }
+        else if(g_out.requested != g_out.started) {
+            start_trig();
+            ++g_out.started;
+            --out_ms;
+        }
+        else {
+            break;
+        }
+    }
+    clk_flags.generation += (byte)ms;
+    clk.cur_ticks += (phase_t)clock_moves(ms) * clk.ticks_per_ms;
+    clk.ms_since_ext_clock += (unsigned int)ms;
+    clk.ms_leading_clock_timeout = (unsigned int)count_down(clk.ms_leading_clock_timeout, ms);
+    if(stats_tick.ext_ticks < STATS_MAX_INTERVAL) {
+        long to_max = ceil_div(STATS_MAX_INTERVAL - stats_tick.ext_ticks, STATS_TMR0_PER_TICK);
+        stats_tick.ext_ticks += STATS_TMR0_PER_TICK * min_ms(ms, to_max);
+    }
+    bbox_isr.ms += (unsigned int)ms;
+
+    // ADC, one conversion each ms
+    if(pots.cur_pot + ms >= POTS_COUNT) {
+        pots.scan_complete = 1;
+    }
+    pots.cur_pot = (byte)((pots.cur_pot + ms) % POTS_COUNT);
+    read_next();
+
+    // main loop
+    sched.ticks_done += (byte)ms;
+    for(byte i=0; i<SCHED_NUM_PERIODIC; ++i) {
+        // the next run is period after the last one
+        sched.countdown[i] = (byte)(sched.countdown[i] + runs[i] * task_def[i].period_ms - ms);
+    }
+    sched.load_countdown -= (byte)ms;
+    seq.prev_pos = clk_get_cur_pos();
+    seq.prev_step = clk_get_cur_step();
+    if(leds.pos_timeout && leds.pos_timeout <= leds_runs * LEDS_RUN_MS) {
+        set_pos_leds(-1);
+    }
+    leds.pos_timeout = count_down(leds.pos_timeout, leds_runs * LEDS_RUN_MS);
+    if(leds.clock_timeout && leds.clock_timeout <= leds_runs * LEDS_RUN_MS) {
+        P_CLOCKLED = 0;
+    }
+    leds.clock_timeout = count_down(leds.clock_timeout, leds_runs * LEDS_RUN_MS);
+    ui.debounce_timeout = count_down(ui.debounce_timeout, ui_runs);
+    ui.double_click_timeout = count_down(ui.double_click_timeout, ui_runs);
+    ui.pot_move_timeout = count_down(ui.pot_move_timeout, ui_runs);
+    if(!ui.button_state) {
+        if(ui_runs) {
+            ui.hold_timeout = DUMP_HOLD_MS/UI_RUN_MS;
+        }
+    }
+    else {
+        ui.hold_timeout = count_down(ui.hold_timeout, ui_runs);
+    }
+    store.delay = (unsigned int)count_down(store.delay, store_runs * STORE_RUN_MS);
+}
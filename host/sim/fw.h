@@ -0,0 +1,53 @@
+/*
+ One instance of the d-ticker firmware running on the host, with a model
+ of the PIC peripherals it uses. Time moves on a ms at a time with
+ fw_tick(), which runs the timer interrupt and then the main loop until it
+ has nothing left to do. Inputs happen at a time within the current ms.
+
+ The firmware's variables are those of the process, so there is one
+ instance per process and fw_power_on() is only called once.
+ */
+#ifndef FW_H
+#define FW_H
+
+enum {
+    FW_OUT_TRIG = 0x01,         // bits of fw_outputs()
+    FW_OUT_CLOCK_LED = 0x02,
+    FW_OUT_POS_LED_SHIFT = 2,   // position LED lit + 1, 0 for none
+    FW_OUT_POS_LED_MASK = 0x1C,
+    FW_EEPROM_SIZE = 256
+};
+
+// settings the firmware can be given on the host (the UI on the module
+// no longer has menus for them)
+typedef struct {
+    int bpm;                    // internal clock, 16..526
+    int num_steps;              // steps per bar, 2..64
+    int num_bars;               // 1..8 (LONG_PHASE)
+    int num_trigs;              // 1..64
+    int reset_mode;             // RESET_MODE_xxx
+    int curve;                  // PAT_CURVE_xxx
+    unsigned char pots[4];
+    // data EEPROM to power on with (FW_EEPROM_SIZE bytes), or NULL for 
+    // blank. The firmware then starts with the settings saved in it, and 
+    // those above are not applied
+    const unsigned char *eeprom;
+} FW_SETTINGS;
+
+// called for each of the firmware's trace events (TRACE_xxx in d-ticker.h)
+// with the time within the current ms
+typedef void (*FW_EVENT_HOOK)(void *ctx, int type, int data, int sub_us);
+
+void fw_set_event_hook(FW_EVENT_HOOK hook, void *ctx);
+void fw_power_on(const FW_SETTINGS *settings);
+void fw_tick(void);
+void fw_clock_edge(int sub_us);
+void fw_reset_input(int level, int sub_us);
+void fw_set_pot(int which, int value);
+void fw_set_button(int pressed);
+int fw_outputs(void);
+const unsigned char *fw_eeprom(void);
+long fw_idle_ms(long limit, int watch_pins);
+void fw_skip(long ms);
+
+#endif
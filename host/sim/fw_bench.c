@@ -0,0 +1,323 @@
+/*
+ Microbenchmarks of the firmware's hot paths, run on the host so that a
+ change can be given a before and after number:
+
+    make -C host bench
+    fw_bench [options] > results.json
+
+ Each benchmark calls one firmware function in a loop, on a firmware
+ powered on with its settings (see the table below). The firmware is built
+ into this file, as fw.c is, so a benchmark can set up the state the
+ function sees: seq_run() is given a clock moved on by one ms per call
+ without running clk_ms_isr(), and clk_ext_pulse_isr() a pulse interval
+ in range so it works out the new rate.
+
+ Timing is made steadier by keeping to one processor, warming up each
+ benchmark before timing it and timing a number of samples, each of
+ enough calls to take a set time. The median, fastest and slowest sample
+ are given per call.
+
+ With -c the host instructions per call are also counted, by single
+ stepping a copy of the benchmark over that many calls. The count is
+ exact and does not change from run to run, so it shows small changes the
+ timing cannot. It is only a proxy for PIC cycles (the PIC takes several
+ instructions for each 16 or 32 bit operation). pic_sim gives the real
+ cycles of an XC8 build.
+
+ Options:
+    -s samples  timed samples of each benchmark (default 11)
+    -t ms       length of each sample (default 20)
+    -w ms       warm up before timing (default 100)
+    -c calls    count instructions over this many calls (default 0, off)
+    -f text     only the benchmarks with text in their names
+    -o file     the results (default stdout)
+    -l          list the benchmarks
+
+ The results are JSON:
+    { "samples": n, "sample_ms": n, "warmup_ms": n, "count_calls": n,
+      "benchmarks": [
+        { "name": "pat_recalc/64/classic", "calls": calls per sample,
+          "ns_median": n, "ns_min": n, "ns_max": n,
+          "instructions": n or null }, ... ] }
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sched.h>
+#include <signal.h>
+#include <sys/ptrace.h>
+#include <sys/wait.h>
+#include "fw.c"
+
+enum {
+    MAX_SAMPLES = 101
+};
+
+typedef struct {
+    const char *name;
+    void (*setup)(const FW_SETTINGS *settings);
+    void (*run)(long calls);
+    FW_SETTINGS settings;       // bpm, steps, bars, trigs, mode, curve, pots
+} BENCH;
+
+////////////////////////////////////////////////////////////////////////////////
+static void setup_power_on(const FW_SETTINGS *settings) {
+    fw_power_on(settings);
+    // the ISR picks up the clock settings on its next tick
+    clk_ms_isr();
+}
+
+static void setup_external(const FW_SETTINGS *settings) {
+    setup_power_on(settings);
+    clk.ms_since_ext_clock = 100;
+    clk_ext_pulse_isr();
+}
+
+static void run_pat_recalc(long calls) {
+    while(calls--) {
+        pat_recalc();
+    }
+}
+
+static void run_seq_run(long calls) {
+    while(calls--) {
+        clk.cur_ticks += clk.ticks_per_ms;
+        ++clk_flags.generation;
+        seq_run();
+    }
+}
+
+static void run_clk_ms_isr(long calls) {
+    while(calls--) {
+        clk_ms_isr();
+    }
+}
+
+static void run_clk_ext_pulse_isr(long calls) {
+    while(calls--) {
+        clk.ms_since_ext_clock = 100;
+        clk_ext_pulse_isr();
+    }
+}
+
+// readings which move the pot on some calls and not on others
+static byte pots_next_reading;
+
+static void setup_pots(const FW_SETTINGS *settings) {
+    setup_power_on(settings);
+    pots_next_reading = 0;
+}
+
+static void run_pots_read_isr(long calls) {
+    byte reading = pots_next_reading;
+    while(calls--) {
+        ADRESH = reading;
+        reading += 37;
+        pots_read_isr();
+    }
+    pots_next_reading = reading;
+}
+
+#define POTS { 40, 200, 90, 160 }
+#define PAT_RECALC(trigs, curve, name) \
+    { "pat_recalc/" #trigs "/" name, setup_power_on, run_pat_recalc, \
+        { 120, 16, 1, trigs, 0, curve, POTS } }
+
+static const BENCH benches[] = {
+    PAT_RECALC(4, PAT_CURVE_CLASSIC, "classic"),
+    PAT_RECALC(8, PAT_CURVE_CLASSIC, "classic"),
+    PAT_RECALC(16, PAT_CURVE_CLASSIC, "classic"),
+    PAT_RECALC(32, PAT_CURVE_CLASSIC, "classic"),
+    PAT_RECALC(64, PAT_CURVE_CLASSIC, "classic"),
+    PAT_RECALC(4, PAT_CURVE_TAN, "tan"),
+    PAT_RECALC(8, PAT_CURVE_TAN, "tan"),
+    PAT_RECALC(16, PAT_CURVE_TAN, "tan"),
+    PAT_RECALC(32, PAT_CURVE_TAN, "tan"),
+    PAT_RECALC(64, PAT_CURVE_TAN, "tan"),
+    // 64 trigs over 2 steps at 526 BPM is a trig every 3.6ms
+    { "seq_run/dense", setup_power_on, run_seq_run, { 526, 2, 1, 64, 0, 0, POTS } },
+    { "seq_run/sparse", setup_power_on, run_seq_run, { 120, 16, 1, 4, 0, 0, POTS } },
+    { "clk_ms_isr/internal", setup_power_on, run_clk_ms_isr, { 120, 16, 1, 16, 0, 0, POTS } },
+    { "clk_ms_isr/external", setup_external, run_clk_ms_isr, { 120, 16, 1, 16, 0, 0, POTS } },
+    { "clk_ext_pulse_isr", setup_external, run_clk_ext_pulse_isr, { 120, 16, 1, 16, 0, 0, POTS } },
+    { "pots_read_isr", setup_pots, run_pots_read_isr, { 120, 16, 1, 16, 0, 0, POTS } }
+};
+#define NUM_BENCHES ((int)(sizeof(benches)/sizeof(benches[0])))
+
+////////////////////////////////////////////////////////////////////////////////
+static double now_ns() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+static int cmp_double(const void *a, const void *b) {
+    double da = *(const double *)a;
+    double db = *(const double *)b;
+    return (da > db) - (da < db);
+}
+
+// Runs the benchmark for the warm up time, finding how many calls fill a
+// sample, then times the samples. Times are per call, sorted
+static long time_bench(const BENCH *b, int samples, double sample_ns, double warmup_ns,
+    double *times)
+{
+    b->setup(&b->settings);
+    long calls = 1;
+    double start = now_ns();
+    double took = 0;
+    for(;;) {
+        double t0 = now_ns();
+        b->run(calls);
+        took = now_ns() - t0;
+        if(now_ns() - start >= warmup_ns && took >= sample_ns / 2) {
+            break;
+        }
+        if(took < sample_ns) {
+            calls *= 2;
+        }
+    }
+    calls = (long)(calls * sample_ns / (took > 0 ? took : 1)) + 1;
+    for(int i=0; i<samples; ++i) {
+        double t0 = now_ns();
+        b->run(calls);
+        times[i] = (now_ns() - t0) / calls;
+    }
+    qsort(times, samples, sizeof(double), cmp_double);
+    return calls;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Counts the instructions the child runs until it stops itself again
+static long long step_to_stop(pid_t pid) {
+    long long count = 0;
+    int status;
+    for(;;) {
+        if(ptrace(PTRACE_SINGLESTEP, pid, 0, 0) < 0 || waitpid(pid, &status, 0) < 0 ||
+            !WIFSTOPPED(status))
+        {
+            return -1;
+        }
+        if(WSTOPSIG(status) == SIGSTOP) {
+            return count;
+        }
+        ++count;
+    }
+}
+
+// Instructions per call over calls calls, less those of a single call,
+// which takes out the cost of stopping. -1 if they could not be counted
+static double count_instructions(const BENCH *b, long calls) {
+    fflush(NULL);
+    pid_t pid = fork();
+    if(pid < 0) {
+        return -1;
+    }
+    if(pid == 0) {
+        b->setup(&b->settings);
+        b->run(1);
+        if(ptrace(PTRACE_TRACEME, 0, 0, 0) < 0) {
+            _exit(1);
+        }
+        raise(SIGSTOP);
+        b->run(1);
+        raise(SIGSTOP);
+        b->run(calls + 1);
+        raise(SIGSTOP);
+        _exit(0);
+    }
+    int status;
+    long long one = -1;
+    long long many = -1;
+    if(waitpid(pid, &status, 0) == pid && WIFSTOPPED(status)) {
+        one = step_to_stop(pid);
+        many = (one >= 0) ? step_to_stop(pid) : -1;
+    }
+    kill(pid, SIGKILL);
+    waitpid(pid, &status, 0);
+    return (one >= 0 && many >= 0) ? (double)(many - one) / calls : -1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+int main(int argc, char *argv[]) {
+    int samples = 11;
+    double sample_ms = 20;
+    double warmup_ms = 100;
+    long count_calls = 0;
+    const char *filter = NULL;
+    const char *out_path = NULL;
+    int opt;
+    while((opt = getopt(argc, argv, "s:t:w:c:f:o:l")) != -1) {
+        switch(opt) {
+            case 's': samples = atoi(optarg); break;
+            case 't': sample_ms = atof(optarg); break;
+            case 'w': warmup_ms = atof(optarg); break;
+            case 'c': count_calls = atol(optarg); break;
+            case 'f': filter = optarg; break;
+            case 'o': out_path = optarg; break;
+            case 'l':
+                for(int i=0; i<NUM_BENCHES; ++i) {
+                    printf("%s\n", benches[i].name);
+                }
+                return 0;
+            default:
+                samples = 0;
+                break;
+        }
+    }
+    if(samples < 1 || samples > MAX_SAMPLES || sample_ms <= 0 || warmup_ms < 0 ||
+        count_calls < 0 || optind != argc)
+    {
+        fprintf(stderr, "usage: fw_bench [-s samples] [-t sample_ms] [-w warmup_ms] "
+            "[-c calls] [-f text] [-o file] [-l]\n");
+        return 1;
+    }
+    FILE *out = out_path ? fopen(out_path, "w") : stdout;
+    if(!out) {
+        perror(out_path);
+        return 1;
+    }
+
+    // stay on one processor
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    int cpu = sched_getcpu();
+    CPU_SET(cpu >= 0 ? cpu : 0, &cpus);
+    sched_setaffinity(0, sizeof(cpus), &cpus);
+
+    fprintf(out, "{ \"samples\": %d, \"sample_ms\": %g, \"warmup_ms\": %g, "
+        "\"count_calls\": %ld,\n  \"benchmarks\": [", samples, sample_ms, warmup_ms,
+        count_calls);
+    int first = 1;
+    for(int i=0; i<NUM_BENCHES; ++i) {
+        const BENCH *b = &benches[i];
+        if(filter && !strstr(b->name, filter)) {
+            continue;
+        }
+        double times[MAX_SAMPLES];
+        long calls = time_bench(b, samples, sample_ms * 1e6, warmup_ms * 1e6, times);
+        fprintf(out, "%s\n    { \"name\": \"%s\", \"calls\": %ld, \"ns_median\": %.2f, "
+            "\"ns_min\": %.2f, \"ns_max\": %.2f, \"instructions\": ", first ? "" : ",",
+            b->name, calls, times[samples / 2], times[0], times[samples - 1]);
+        double instructions = count_calls ? count_instructions(b, count_calls) : -1;
+        if(count_calls && instructions < 0) {
+            fprintf(stderr, "fw_bench: could not count the instructions of %s\n", b->name);
+        }
+        if(instructions >= 0) {
+            fprintf(out, "%.1f }", instructions);
+        }
+        else {
+            fprintf(out, "null }");
+        }
+        first = 0;
+    }
+    fprintf(out, "\n  ]\n}\n");
+    if(out != stdout && fclose(out)) {
+        perror(out_path);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,107 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dlfcn.h>
+#include <link.h>
+#include "fw_lib.h"
+
+////////////////////////////////////////////////////////////////////////////////
+void fw_lib_default_path(char *path, size_t len) {
+    ssize_t n = readlink("/proc/self/exe", path, len - 1);
+    path[(n > 0) ? n : 0] = 0;
+    char *slash = strrchr(path, '/');
+    char *name = slash ? slash + 1 : path;
+    snprintf(name, len - (name - path), "ticker_fw.so");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Finds the writable data of a loaded library: its writable segment less
+// the part made read only after loading (RELRO)
+static int find_data(struct dl_phdr_info *info, size_t size, void *ctx) {
+    FW_LIB *lib = ctx;
+    struct link_map *map;
+    if(dlinfo(lib->handle, RTLD_DI_LINKMAP, &map) || info->dlpi_addr != map->l_addr) {
+        return 0;
+    }
+    uintptr_t start = 0;
+    uintptr_t end = 0;
+    uintptr_t relro_end = 0;
+    for(int i=0; i<info->dlpi_phnum; ++i) {
+        const ElfW(Phdr) *ph = &info->dlpi_phdr[i];
+        if(ph->p_type == PT_LOAD && (ph->p_flags & PF_W)) {
+            start = info->dlpi_addr + ph->p_vaddr;
+            end = start + ph->p_memsz;
+        }
+        else if(ph->p_type == PT_GNU_RELRO) {
+            relro_end = info->dlpi_addr + ph->p_vaddr + ph->p_memsz;
+        }
+    }
+    if(relro_end > start && relro_end <= end) {
+        start = relro_end;
+    }
+    lib->data = (unsigned char *)start;
+    lib->data_len = end - start;
+    return 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// A library opened twice is only loaded once, so each copy is a file of 
+// its own while it is opened
+void fw_lib_load(FW_LIB *lib, const char *path) {
+    FILE *from = fopen(path, "rb");
+    if(!from) {
+        perror(path);
+        exit(1);
+    }
+    char copy[] = "/tmp/fw_libXXXXXX";
+    int fd = mkstemp(copy);
+    FILE *to = (fd < 0) ? NULL : fdopen(fd, "wb");
+    if(!to) {
+        perror("mkstemp");
+        exit(1);
+    }
+    char buf[65536];
+    size_t n;
+    while((n = fread(buf, 1, sizeof(buf), from)) > 0) {
+        if(fwrite(buf, 1, n, to) != n) {
+            perror(copy);
+            exit(1);
+        }
+    }
+    fclose(from);
+    if(fclose(to)) {
+        perror(copy);
+        exit(1);
+    }
+    memset(lib, 0, sizeof(*lib));
+    lib->handle = dlopen(copy, RTLD_NOW | RTLD_LOCAL);
+    unlink(copy);
+    if(!lib->handle) {
+        fprintf(stderr, "%s\n", dlerror());
+        exit(1);
+    }
+    *(void **)&lib->sim_start = dlsym(lib->handle, "sim_start");
+    *(void **)&lib->sim_run = dlsym(lib->handle, "sim_run");
+    if(!lib->sim_start || !lib->sim_run || !dl_iterate_phdr(find_data, lib)) {
+        fprintf(stderr, "%s is not the firmware library\n", path);
+        exit(1);
+    }
+    lib->snapshot = malloc(lib->data_len);
+    memcpy(lib->snapshot, lib->data, lib->data_len);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void fw_lib_restore(FW_LIB *lib) {
+    memcpy(lib->data, lib->snapshot, lib->data_len);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void fw_lib_unload(FW_LIB *lib) {
+    if(lib->handle) {
+        dlclose(lib->handle);
+    }
+    free(lib->snapshot);
+    memset(lib, 0, sizeof(*lib));
+}
@@ -0,0 +1,30 @@
+/*
+ Loads copies of the firmware library (ticker_fw.so, sim/fw.c and 
+ sim/sim.c built to be loaded) for tools that need more than one firmware
+ instance in a process, or a fresh one for each run. Each copy has its 
+ own firmware variables, and fw_lib_restore() puts them back as they were
+ when it was loaded, which is the firmware's RAM at power on.
+ */
+#ifndef FW_LIB_H
+#define FW_LIB_H
+#include <stddef.h>
+#include "sim.h"
+
+typedef struct {
+    void *handle;
+    void (*sim_start)(SIM *sim, const FW_SETTINGS *settings);
+    void (*sim_run)(SIM *sim, long long end_ms);
+    // the library's writable data and a copy of it as loaded
+    unsigned char *data;
+    size_t data_len;
+    unsigned char *snapshot;
+} FW_LIB;
+
+// ticker_fw.so beside the program
+void fw_lib_default_path(char *path, size_t len);
+// loads a copy, or exits with a message on failure
+void fw_lib_load(FW_LIB *lib, const char *path);
+void fw_lib_restore(FW_LIB *lib);
+void fw_lib_unload(FW_LIB *lib);
+
+#endif
@@ -0,0 +1,184 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "pool.h"
+
+typedef struct {
+    pthread_mutex_t lock;
+    int *tasks;
+    int head;                   // next for the owner
+    int tail;                   // one past the next for a thief
+} QUEUE;
+
+struct POOL {
+    int threads;
+    QUEUE *queues;
+    pthread_t *ids;
+    pthread_mutex_t lock;
+    pthread_cond_t start;
+    pthread_cond_t done;
+    unsigned long batch;        // counts pool_run() calls
+    int stop;
+    int pending;                // tasks of the batch not finished
+    int busy;                   // workers in the batch
+    int capacity;               // size of each queue
+    POOL_TASK task;
+    void *ctx;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+static int take(QUEUE *q, int own) {
+    int index = -1;
+    pthread_mutex_lock(&q->lock);
+    if(q->head < q->tail) {
+        index = own ? q->tasks[q->head++] : q->tasks[--q->tail];
+    }
+    pthread_mutex_unlock(&q->lock);
+    return index;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// run tasks until there are none left to take
+static void work(POOL *pool, int self) {
+    int finished = 0;
+    for(;;) {
+        int index = take(&pool->queues[self], 1);
+        for(int i=1; index < 0 && i<pool->threads; ++i) {
+            index = take(&pool->queues[(self + i) % pool->threads], 0);
+        }
+        if(index < 0) {
+            break;
+        }
+        pool->task(pool->ctx, index);
+        ++finished;
+    }
+    pthread_mutex_lock(&pool->lock);
+    pool->pending -= finished;
+    --pool->busy;
+    if(!pool->pending && !pool->busy) {
+        pthread_cond_broadcast(&pool->done);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static void *worker(void *arg) {
+    POOL *pool = ((void **)arg)[0];
+    int self = (int)(long)((void **)arg)[1];
+    free(arg);
+    unsigned long seen = 0;
+    pthread_mutex_lock(&pool->lock);
+    for(;;) {
+        // a batch is only joined while it has tasks left, so none are in 
+        // work() once pool_run() returns
+        while(!pool->stop && (pool->batch == seen || !pool->pending)) {
+            pthread_cond_wait(&pool->start, &pool->lock);
+        }
+        if(pool->stop) {
+            break;
+        }
+        seen = pool->batch;
+        ++pool->busy;
+        pthread_mutex_unlock(&pool->lock);
+        work(pool, self);
+        pthread_mutex_lock(&pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+POOL *pool_create(int threads) {
+    POOL *pool = calloc(1, sizeof(POOL));
+    if(!pool) {
+        return NULL;
+    }
+    pool->threads = (threads < 1) ? 1 : threads;
+    pool->queues = calloc(pool->threads, sizeof(QUEUE));
+    pool->ids = calloc(pool->threads, sizeof(pthread_t));
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->start, NULL);
+    pthread_cond_init(&pool->done, NULL);
+    for(int i=0; i<pool->threads; ++i) {
+        pthread_mutex_init(&pool->queues[i].lock, NULL);
+    }
+    // the caller is worker 0
+    for(int i=1; i<pool->threads; ++i) {
+        void **arg = malloc(2 * sizeof(void *));
+        arg[0] = pool;
+        arg[1] = (void *)(long)i;
+        if(pthread_create(&pool->ids[i], NULL, worker, arg)) {
+            perror("pthread_create");
+            exit(1);
+        }
+    }
+    return pool;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void pool_run(POOL *pool, int count, POOL_TASK task, void *ctx) {
+    if(count <= 0) {
+        return;
+    }
+    if(pool->threads == 1) {
+        for(int i=0; i<count; ++i) {
+            task(ctx, i);
+        }
+        return;
+    }
+    int per_queue = (count + pool->threads - 1) / pool->threads;
+    if(per_queue > pool->capacity) {
+        for(int i=0; i<pool->threads; ++i) {
+            free(pool->queues[i].tasks);
+            pool->queues[i].tasks = malloc(per_queue * sizeof(int));
+        }
+        pool->capacity = per_queue;
+    }
+    for(int i=0; i<pool->threads; ++i) {
+        pool->queues[i].head = 0;
+        pool->queues[i].tail = 0;
+    }
+    for(int i=0; i<count; ++i) {
+        QUEUE *q = &pool->queues[i % pool->threads];
+        q->tasks[q->tail++] = i;
+    }
+    pthread_mutex_lock(&pool->lock);
+    pool->task = task;
+    pool->ctx = ctx;
+    pool->pending = count;
+    pool->busy = 1;
+    ++pool->batch;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    work(pool, 0);
+    pthread_mutex_lock(&pool->lock);
+    while(pool->pending || pool->busy) {
+        pthread_cond_wait(&pool->done, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void pool_destroy(POOL *pool) {
+    if(!pool) {
+        return;
+    }
+    pthread_mutex_lock(&pool->lock);
+    pool->stop = 1;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+    for(int i=1; i<pool->threads; ++i) {
+        pthread_join(pool->ids[i], NULL);
+    }
+    for(int i=0; i<pool->threads; ++i) {
+        pthread_mutex_destroy(&pool->queues[i].lock);
+        free(pool->queues[i].tasks);
+    }
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->start);
+    pthread_cond_destroy(&pool->done);
+    free(pool->queues);
+    free(pool->ids);
+    free(pool);
+}
@@ -0,0 +1,20 @@
+/*
+ A pool of threads that run a batch of tasks and wait for them all. The
+ tasks are dealt out to a queue per thread. A thread takes its next task
+ from the front of its own queue and, when that is empty, steals from the
+ back of another's, so a batch of uneven tasks still keeps every thread 
+ busy. The thread calling pool_run() is one of the workers.
+ */
+#ifndef POOL_H
+#define POOL_H
+
+// runs task number index of the batch
+typedef void (*POOL_TASK)(void *ctx, int index);
+
+typedef struct POOL POOL;
+
+POOL *pool_create(int threads);
+void pool_run(POOL *pool, int count, POOL_TASK task, void *ctx);
+void pool_destroy(POOL *pool);
+
+#endif
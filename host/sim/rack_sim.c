@@ -0,0 +1,827 @@
+/*
+ Runs a rack of d-ticker modules on the host, each its own copy of the
+ firmware, to see how timing errors build up between them. The modules
+ are clocked from a shared master clock (and reset) bus or from the trig
+ output of another module, and each can have its own oscillator error and
+ cable delay.
+
+    make -C host rack_sim
+    rack_sim [options] > report.txt
+
+ Options:
+    -N count    modules in the rack (default 4)
+    -M file     the modules, one per line (instead of -N), with any of
+                    steps=n bars=n trigs=n mode=n curve=n pots=a,b,c,d
+                    bpm=n clock=bus|<module> reset=bus|none ppm=n delay=us
+    -t seconds  time to run for (default 60)
+    -e us       master clock period (default 125000)
+    -j us       master clock jitter, the most each edge is moved by
+    -x n        reset pulse on every n'th master clock, 0 for none (default)
+    -X us       time of the reset pulse from its clock edge (default -1000)
+    -s -b -n -m -c -p -r
+                steps, bars, trigs, reset mode, curve, pots and bpm of every
+                module, as for ticker_sim
+    -P ppm      give each module a fixed oscillator error within +/-ppm
+    -D          daisy chain: each module after the first is clocked by the
+                trig output of the one before
+    -d us       cable delay of each module's clock and reset (default 0)
+    -R module   reference for the timing errors (default 0)
+    -W us       how far a trig can be from the reference's (default 20000)
+    -T threads  worker threads (default: one per processor)
+    -E ms       epoch, the time the modules run between exchanging their
+                outputs (default 1000)
+    -o file     log of every event: <time in us> <module> <name> <data>
+    -B file     the log as a binary trace (tbin/tbin.h), the module as channel
+    -F          run every tick instead of fast forwarding idle ones
+    -C          run with one thread and then with -T threads and check the
+                results are the same
+    -L file     firmware library (default ticker_fw.so beside rack_sim)
+
+ The report has a line per module: its trig count and, for each trig
+ within -W of one of the reference module's trigs, the offset from the
+ nearest of those (mean, sd, min, max and the last one).
+
+ Each module is its own copy of ticker_fw.so (fw_lib.h), as the firmware's
+ variables are globals. The modules run an epoch at a time on a pool of
+ threads, those on the bus first and then, a level at a time, those
+ clocked by them, so each has all its inputs for the epoch before it runs.
+ The inputs of a module are in order of time and then source, so the
+ results do not depend on the number of threads or the length of an epoch.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <math.h>
+#include <limits.h>
+#include "fw_lib.h"
+#include "pool.h"
+#include "tbin.h"
+
+#define CLOCK_BUS       (-1)
+#define RESET_PULSE_US  5000
+
+typedef struct {
+    SIM_INPUT in;
+    int origin;                 // 0 for the bus, 1 for another module
+    unsigned long long seq;
+} ITEM;
+
+typedef struct {
+    ITEM *items;
+    int count;
+    int size;
+    unsigned long long seq;
+} HEAP;
+
+typedef struct {
+    long long time_us;
+    const char *name;
+    int data;
+} EVENT;
+
+typedef struct {
+    unsigned long long matched;
+    unsigned long long unmatched;
+    double sum;
+    double sum_sq;
+    long long min;
+    long long max;
+    long long last;
+} OFFSETS;
+
+typedef struct {
+    // set up
+    FW_SETTINGS settings;
+    int clock;                  // module index or CLOCK_BUS
+    int reset;                  // from the bus
+    long ppm;
+    long long delay_us;
+    int level;
+    FW_LIB lib;
+    SIM sim;
+    // inputs
+    HEAP inputs;
+    ITEM held;                  // the one the SIM has taken
+    // outputs of the epoch
+    EVENT *events;
+    int num_events;
+    int max_events;
+    int keep_all;
+    unsigned long long count;
+    unsigned long long hash;
+    unsigned long long trigs;
+    // trig times not yet compared with the reference
+    long long *pending;
+    int num_pending;
+    int max_pending;
+    OFFSETS offsets;
+} MODULE;
+
+typedef struct {
+    int num_modules;
+    MODULE *modules;
+    int num_levels;
+    int *order;                 // module indexes by level
+    int *level_start;           // of each level in order, and the end
+    long long end_ms;
+    long long epoch_ms;
+    long long epoch_end_us;
+    int level;                  // being run
+    // bus
+    long long period;
+    long long jitter;
+    int reset_every;
+    long long reset_offset;
+    unsigned long rand;
+    long long next_clock;       // count of the next master clock edge
+    HEAP bus;
+    // reference trigs
+    int ref;
+    long long window;
+    long long *ref_trigs;
+    int num_ref;
+    int max_ref;
+    FILE *log;
+    TBIN_WRITER *bin;
+} RACK;
+
+////////////////////////////////////////////////////////////////////////////////
+static void *grow(void *p, int *size, int need, size_t item) {
+    if(need <= *size) {
+        return p;
+    }
+    int size2 = *size ? *size : 64;
+    while(size2 < need) {
+        size2 *= 2;
+    }
+    p = realloc(p, size2 * item);
+    if(!p) {
+        fprintf(stderr, "rack_sim: out of memory\n");
+        exit(1);
+    }
+    *size = size2;
+    return p;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static int before(const ITEM *a, const ITEM *b) {
+    if(a->in.time_us != b->in.time_us) {
+        return a->in.time_us < b->in.time_us;
+    }
+    if(a->origin != b->origin) {
+        return a->origin < b->origin;
+    }
+    return a->seq < b->seq;
+}
+
+static void heap_push(HEAP *h, const ITEM *item) {
+    h->items = grow(h->items, &h->size, h->count + 1, sizeof(ITEM));
+    int i = h->count++;
+    while(i > 0 && before(item, &h->items[(i - 1) / 2])) {
+        h->items[i] = h->items[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    h->items[i] = *item;
+}
+
+static void heap_add(HEAP *h, const SIM_INPUT *in, int origin) {
+    ITEM item = { *in, origin, h->seq++ };
+    heap_push(h, &item);
+}
+
+static int heap_pop(HEAP *h, ITEM *item) {
+    if(!h->count) {
+        return 0;
+    }
+    *item = h->items[0];
+    ITEM last = h->items[--h->count];
+    int i = 0;
+    for(;;) {
+        int child = 2 * i + 1;
+        if(child >= h->count) {
+            break;
+        }
+        if(child + 1 < h->count && before(&h->items[child + 1], &h->items[child])) {
+            ++child;
+        }
+        if(!before(&h->items[child], &last)) {
+            break;
+        }
+        h->items[i] = h->items[child];
+        i = child;
+    }
+    h->items[i] = last;
+    return 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static int next_input(void *ctx, SIM_INPUT *input) {
+    MODULE *m = ctx;
+    if(!heap_pop(&m->inputs, &m->held)) {
+        return 0;
+    }
+    *input = m->held.in;
+    return 1;
+}
+
+static void hash_bytes(MODULE *m, const void *data, size_t len) {
+    for(size_t i=0; i<len; ++i) {
+        m->hash = (m->hash ^ ((const unsigned char *)data)[i]) * 0x100000001B3ULL;
+    }
+}
+
+static void module_event(void *ctx, long long time_us, const char *name, int data) {
+    MODULE *m = ctx;
+    hash_bytes(m, &time_us, sizeof(time_us));
+    hash_bytes(m, name, strlen(name));
+    hash_bytes(m, &data, sizeof(data));
+    ++m->count;
+    int rising_out = !strcmp(name, "out") && data;
+    if(rising_out) {
+        ++m->trigs;
+    }
+    if(m->keep_all || rising_out) {
+        m->events = grow(m->events, &m->max_events, m->num_events + 1, sizeof(EVENT));
+        EVENT *e = &m->events[m->num_events++];
+        e->time_us = time_us;
+        e->name = name;
+        e->data = data;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Puts the module's clock and reset from the bus of the epoch on its inputs
+static void bus_to_modules(RACK *rack) {
+    long long early = rack->jitter + ((rack->reset_offset < 0) ? -rack->reset_offset : 0);
+    while(rack->next_clock * rack->period - early < rack->epoch_end_us) {
+        long long k = rack->next_clock++;
+        SIM_INPUT in = { k * rack->period, SIM_IN_CLOCK, 0, 0 };
+        if(rack->jitter) {
+            rack->rand = rack->rand * 1103515245UL + 12345UL;
+            in.time_us += (long long)((rack->rand >> 8) % (unsigned long)(2 * rack->jitter + 1))
+                - rack->jitter;
+        }
+        heap_add(&rack->bus, &in, 0);
+        if(rack->reset_every && !(k % rack->reset_every)) {
+            SIM_INPUT rst = { in.time_us + rack->reset_offset, SIM_IN_RESET, 0, 1 };
+            if(rst.time_us < 0) {
+                rst.time_us = 0;
+            }
+            heap_add(&rack->bus, &rst, 0);
+            rst.time_us += RESET_PULSE_US;
+            rst.value = 0;
+            heap_add(&rack->bus, &rst, 0);
+        }
+    }
+    ITEM item;
+    while(rack->bus.count && rack->bus.items[0].in.time_us < rack->epoch_end_us) {
+        heap_pop(&rack->bus, &item);
+        for(int i=0; i<rack->num_modules; ++i) {
+            MODULE *m = &rack->modules[i];
+            if(item.in.type == SIM_IN_CLOCK ? (m->clock == CLOCK_BUS) : m->reset) {
+                SIM_INPUT in = item.in;
+                in.time_us += m->delay_us;
+                heap_add(&m->inputs, &in, 0);
+            }
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Runs a module to the end of the epoch in its own time. It takes no input
+// from after the end of the epoch, as not all of those are known yet
+static void run_module(void *ctx, int index) {
+    RACK *rack = ctx;
+    MODULE *m = &rack->modules[rack->order[rack->level_start[rack->level] + index]];
+    long long end_ms = m->ppm ?
+        rack->epoch_end_us * (1000000 + m->ppm) / 1000000 / 1000 : rack->epoch_end_us / 1000;
+    m->lib.sim_run(&m->sim, end_ms);
+    if(m->sim.have_next) {
+        // put it back for the next epoch, as others may come before it
+        heap_push(&m->inputs, &m->held);
+        m->sim.have_next = 0;
+    }
+}
+
+// trig outputs of a module to those clocked by it
+static void outputs_to_modules(RACK *rack, int from) {
+    MODULE *src = &rack->modules[from];
+    for(int i=0; i<rack->num_modules; ++i) {
+        MODULE *m = &rack->modules[i];
+        if(m->clock != from) {
+            continue;
+        }
+        for(int e=0; e<src->num_events; ++e) {
+            if(src->events[e].data && !strcmp(src->events[e].name, "out")) {
+                SIM_INPUT in = { src->events[e].time_us + m->delay_us, SIM_IN_CLOCK, 0, 0 };
+                heap_add(&m->inputs, &in, 1);
+            }
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static void add_offset(OFFSETS *o, long long offset) {
+    if(!o->matched || offset < o->min) {
+        o->min = offset;
+    }
+    if(!o->matched || offset > o->max) {
+        o->max = offset;
+    }
+    ++o->matched;
+    o->sum += offset;
+    o->sum_sq += (double)offset * offset;
+    o->last = offset;
+}
+
+// Compares the trigs of each module up to the given time with the nearest
+// of the reference module's. These must be known up to time + window
+static void compare_trigs(RACK *rack, long long upto_us) {
+    long long oldest = upto_us;
+    for(int i=0; i<rack->num_modules; ++i) {
+        MODULE *m = &rack->modules[i];
+        int done = 0;
+        while(done < m->num_pending && m->pending[done] <= upto_us) {
+            long long t = m->pending[done++];
+            // first reference trig at or after t
+            int lo = 0;
+            int hi = rack->num_ref;
+            while(lo < hi) {
+                int mid = (lo + hi) / 2;
+                if(rack->ref_trigs[mid] < t) {
+                    lo = mid + 1;
+                }
+                else {
+                    hi = mid;
+                }
+            }
+            // + for late
+            long long offset = LLONG_MAX;
+            if(lo < rack->num_ref) {
+                offset = t - rack->ref_trigs[lo];
+            }
+            if(lo > 0 && (offset == LLONG_MAX || t - rack->ref_trigs[lo - 1] <= -offset)) {
+                offset = t - rack->ref_trigs[lo - 1];
+            }
+            if(offset != LLONG_MAX && llabs(offset) <= rack->window) {
+                add_offset(&m->offsets, offset);
+            }
+            else {
+                ++m->offsets.unmatched;
+            }
+        }
+        memmove(m->pending, m->pending + done, (m->num_pending - done) * sizeof(long long));
+        m->num_pending -= done;
+        if(m->num_pending && m->pending[0] < oldest) {
+            oldest = m->pending[0];
+        }
+    }
+    // forget the reference trigs no longer needed
+    int keep = 0;
+    while(keep < rack->num_ref && rack->ref_trigs[keep] < oldest - rack->window) {
+        ++keep;
+    }
+    memmove(rack->ref_trigs, rack->ref_trigs + keep, (rack->num_ref - keep) * sizeof(long long));
+    rack->num_ref -= keep;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// the epoch's events of all the modules, in order of time and then module
+typedef struct {
+    long long time_us;
+    int module;
+    int index;
+} LOG_REF;
+
+static int log_order(const void *a, const void *b) {
+    const LOG_REF *x = a;
+    const LOG_REF *y = b;
+    if(x->time_us != y->time_us) {
+        return (x->time_us < y->time_us) ? -1 : 1;
+    }
+    if(x->module != y->module) {
+        return x->module - y->module;
+    }
+    return x->index - y->index;
+}
+
+static void write_log(RACK *rack) {
+    static LOG_REF *refs;
+    static int max_refs;
+    int count = 0;
+    for(int i=0; i<rack->num_modules; ++i) {
+        MODULE *m = &rack->modules[i];
+        refs = grow(refs, &max_refs, count + m->num_events, sizeof(LOG_REF));
+        for(int e=0; e<m->num_events; ++e) {
+            refs[count].time_us = m->events[e].time_us;
+            refs[count].module = i;
+            refs[count].index = e;
+            ++count;
+        }
+    }
+    qsort(refs, count, sizeof(LOG_REF), log_order);
+    for(int i=0; i<count; ++i) {
+        const EVENT *e = &rack->modules[refs[i].module].events[refs[i].index];
+        if(rack->log) {
+            fprintf(rack->log, "%lld %d %s %d\n", e->time_us, refs[i].module, e->name, e->data);
+        }
+        if(rack->bin) {
+            tbin_write(rack->bin, e->time_us, tbin_type(rack->bin, e->name), 
+                refs[i].module, e->data);
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static void end_of_epoch(RACK *rack) {
+    if(rack->log || rack->bin) {
+        write_log(rack);
+    }
+    for(int i=0; i<rack->num_modules; ++i) {
+        MODULE *m = &rack->modules[i];
+        for(int e=0; e<m->num_events; ++e) {
+            if(!m->events[e].data || strcmp(m->events[e].name, "out")) {
+                continue;
+            }
+            if(i == rack->ref) {
+                rack->ref_trigs = grow(rack->ref_trigs, &rack->max_ref,
+                    rack->num_ref + 1, sizeof(long long));
+                rack->ref_trigs[rack->num_ref++] = m->events[e].time_us;
+            }
+            else {
+                m->pending = grow(m->pending, &m->max_pending,
+                    m->num_pending + 1, sizeof(long long));
+                m->pending[m->num_pending++] = m->events[e].time_us;
+            }
+        }
+        m->num_events = 0;
+    }
+    compare_trigs(rack, rack->epoch_end_us - rack->window);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static double run(RACK *rack, const char *lib_path, int threads, int fast) {
+    for(int i=0; i<rack->num_modules; ++i) {
+        fw_lib_load(&rack->modules[i].lib, lib_path);
+    }
+    rack->bus.count = 0;
+    rack->bus.seq = 0;
+    rack->rand = 1;
+    rack->next_clock = 1;
+    rack->num_ref = 0;
+    for(int i=0; i<rack->num_modules; ++i) {
+        MODULE *m = &rack->modules[i];
+        m->inputs.count = 0;
+        m->inputs.seq = 0;
+        m->num_events = 0;
+        m->num_pending = 0;
+        m->keep_all = (rack->log || rack->bin);
+        m->count = 0;
+        m->hash = 0xCBF29CE484222325ULL;
+        m->trigs = 0;
+        memset(&m->offsets, 0, sizeof(m->offsets));
+        memset(&m->sim, 0, sizeof(m->sim));
+        m->sim.source = next_input;
+        m->sim.source_ctx = m;
+        m->sim.sink = module_event;
+        m->sim.sink_ctx = m;
+        m->sim.fast = fast;
+        m->sim.log_pins = 1;
+        m->sim.ppm = m->ppm;
+        m->lib.sim_start(&m->sim, &m->settings);
+    }
+
+    POOL *pool = pool_create(threads);
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for(long long ms = 0; ms < rack->end_ms; ms += rack->epoch_ms) {
+        long long end_ms = ms + rack->epoch_ms;
+        if(end_ms > rack->end_ms) {
+            end_ms = rack->end_ms;
+        }
+        rack->epoch_end_us = end_ms * 1000;
+        bus_to_modules(rack);
+        for(rack->level = 0; rack->level < rack->num_levels; ++rack->level) {
+            int first = rack->level_start[rack->level];
+            int last = rack->level_start[rack->level + 1];
+            pool_run(pool, last - first, run_module, rack);
+            for(int i=first; i<last; ++i) {
+                outputs_to_modules(rack, rack->order[i]);
+            }
+        }
+        end_of_epoch(rack);
+    }
+    compare_trigs(rack, LLONG_MAX);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    pool_destroy(pool);
+    for(int i=0; i<rack->num_modules; ++i) {
+        fw_lib_unload(&rack->modules[i].lib);
+    }
+    return (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) * 1e-9;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static unsigned long long rack_hash(const RACK *rack) {
+    unsigned long long hash = 0xCBF29CE484222325ULL;
+    for(int i=0; i<rack->num_modules; ++i) {
+        hash = (hash ^ rack->modules[i].hash) * 0x100000001B3ULL;
+    }
+    return hash;
+}
+
+static void summary(const char *name, const RACK *rack, int threads, double secs) {
+    unsigned long long events = 0;
+    unsigned long long ticks_run = 0;
+    unsigned long long ticks_skipped = 0;
+    for(int i=0; i<rack->num_modules; ++i) {
+        events += rack->modules[i].count;
+        ticks_run += rack->modules[i].sim.ticks_run;
+        ticks_skipped += rack->modules[i].sim.ticks_skipped;
+    }
+    fprintf(stderr, "%s: %d modules, %d threads, %llu events, %llu ticks run, "
+        "%llu skipped, %.3fs, hash %016llx\n", name, rack->num_modules, threads,
+        events, ticks_run, ticks_skipped, secs, rack_hash(rack));
+}
+
+static void report(const RACK *rack) {
+    printf("module clock    ppm   trigs matched unmatched    mean_us      sd_us"
+        "  min_us  max_us last_us\n");
+    for(int i=0; i<rack->num_modules; ++i) {
+        const MODULE *m = &rack->modules[i];
+        const OFFSETS *o = &m->offsets;
+        char clock[16];
+        if(m->clock == CLOCK_BUS) {
+            strcpy(clock, "bus");
+        }
+        else {
+            snprintf(clock, sizeof(clock), "%d", m->clock);
+        }
+        printf("%6d %5s %6ld %7llu ", i, clock, m->ppm, m->trigs);
+        if(i == rack->ref) {
+            printf("(reference)\n");
+        }
+        else if(!o->matched) {
+            printf("%7d %9llu\n", 0, o->unmatched);
+        }
+        else {
+            double mean = o->sum / o->matched;
+            double var = o->sum_sq / o->matched - mean * mean;
+            printf("%7llu %9llu %10.1f %10.1f %7lld %7lld %7lld\n", o->matched,
+                o->unmatched, mean, (var > 0) ? sqrt(var) : 0.0, o->min, o->max, o->last);
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static int read_pots(const char *text, FW_SETTINGS *settings) {
+    int p[4];
+    if(sscanf(text, "%d,%d,%d,%d", &p[0], &p[1], &p[2], &p[3]) != 4) {
+        return 0;
+    }
+    for(int i=0; i<4; ++i) {
+        settings->pots[i] = (unsigned char)p[i];
+    }
+    return 1;
+}
+
+static int module_setting(MODULE *m, const char *key, const char *value) {
+    FW_SETTINGS *s = &m->settings;
+    if(!strcmp(key, "steps")) s->num_steps = atoi(value);
+    else if(!strcmp(key, "bars")) s->num_bars = atoi(value);
+    else if(!strcmp(key, "trigs")) s->num_trigs = atoi(value);
+    else if(!strcmp(key, "mode")) s->reset_mode = atoi(value);
+    else if(!strcmp(key, "curve")) s->curve = atoi(value);
+    else if(!strcmp(key, "bpm")) s->bpm = atoi(value);
+    else if(!strcmp(key, "pots")) return read_pots(value, s);
+    else if(!strcmp(key, "clock")) m->clock = strcmp(value, "bus") ? atoi(value) : CLOCK_BUS;
+    else if(!strcmp(key, "reset")) m->reset = !strcmp(value, "bus");
+    else if(!strcmp(key, "ppm")) m->ppm = atol(value);
+    else if(!strcmp(key, "delay")) m->delay_us = atoll(value);
+    else return 0;
+    return 1;
+}
+
+static int read_modules(const char *path, const MODULE *defaults, MODULE **modules) {
+    FILE *f = fopen(path, "r");
+    if(!f) {
+        perror(path);
+        exit(1);
+    }
+    char line[512];
+    int count = 0;
+    int size = 0;
+    int line_no = 0;
+    while(fgets(line, sizeof(line), f)) {
+        ++line_no;
+        char *tok = strtok(line, " \t\r\n");
+        if(!tok || tok[0] == '#') {
+            continue;
+        }
+        *modules = grow(*modules, &size, count + 1, sizeof(MODULE));
+        MODULE *m = &(*modules)[count++];
+        *m = *defaults;
+        for(; tok; tok = strtok(NULL, " \t\r\n")) {
+            char *eq = strchr(tok, '=');
+            if(eq) {
+                *eq = 0;
+            }
+            if(!eq || !module_setting(m, tok, eq + 1)) {
+                fprintf(stderr, "%s:%d: bad setting %s\n", path, line_no, tok);
+                exit(1);
+            }
+        }
+    }
+    fclose(f);
+    return count;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Orders the modules by level: 0 for those on the bus, else one more than
+// the module clocking it
+static int set_levels(RACK *rack) {
+    int n = rack->num_modules;
+    for(int i=0; i<n; ++i) {
+        int level = 0;
+        int at = i;
+        while(rack->modules[at].clock != CLOCK_BUS) {
+            at = rack->modules[at].clock;
+            if(++level > n) {
+                return 0;
+            }
+        }
+        rack->modules[i].level = level;
+        if(level + 1 > rack->num_levels) {
+            rack->num_levels = level + 1;
+        }
+    }
+    rack->order = malloc(n * sizeof(int));
+    rack->level_start = calloc(rack->num_levels + 1, sizeof(int));
+    int count = 0;
+    for(int level = 0; level < rack->num_levels; ++level) {
+        rack->level_start[level] = count;
+        for(int i=0; i<n; ++i) {
+            if(rack->modules[i].level == level) {
+                rack->order[count++] = i;
+            }
+        }
+    }
+    rack->level_start[rack->num_levels] = count;
+    return 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static long spread_ppm(int module, long spread) {
+    unsigned long r = (unsigned long)module * 2654435761UL + 12345UL;
+    r = r * 1103515245UL + 12345UL;
+    return (long)((r >> 8) % (unsigned long)(2 * spread + 1)) - spread;
+}
+
+int main(int argc, char *argv[]) {
+    MODULE defaults;
+    memset(&defaults, 0, sizeof(defaults));
+    FW_SETTINGS settings = {
+        120, 16, 1, 16, 0, 0, { 128, 128, 128, 128 }
+    };
+    defaults.settings = settings;
+    defaults.clock = CLOCK_BUS;
+    defaults.reset = 1;
+    RACK rack;
+    memset(&rack, 0, sizeof(rack));
+    rack.num_modules = 4;
+    rack.period = 125000;
+    rack.reset_offset = -1000;
+    rack.window = 20000;
+    rack.epoch_ms = 1000;
+    const char *modules_path = NULL;
+    const char *log_path = NULL;
+    const char *bin_path = NULL;
+    char lib_path[PATH_MAX] = "";
+    double seconds = 60;
+    long spread = 0;
+    int chain = 0;
+    int fast = 1;
+    int compare = 0;
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int threads = (cpus > 0) ? (int)cpus : 1;
+    int opt;
+    while((opt = getopt(argc, argv, "N:M:t:e:j:x:X:s:b:n:m:c:p:r:P:Dd:R:W:T:E:o:B:FCL:")) != -1) {
+        switch(opt) {
+            case 'N': rack.num_modules = atoi(optarg); break;
+            case 'M': modules_path = optarg; break;
+            case 't': seconds = atof(optarg); break;
+            case 'e': rack.period = atoll(optarg); break;
+            case 'j': rack.jitter = atoll(optarg); break;
+            case 'x': rack.reset_every = atoi(optarg); break;
+            case 'X': rack.reset_offset = atoll(optarg); break;
+            case 's': defaults.settings.num_steps = atoi(optarg); break;
+            case 'b': defaults.settings.num_bars = atoi(optarg); break;
+            case 'n': defaults.settings.num_trigs = atoi(optarg); break;
+            case 'm': defaults.settings.reset_mode = atoi(optarg); break;
+            case 'c': defaults.settings.curve = atoi(optarg); break;
+            case 'r': defaults.settings.bpm = atoi(optarg); break;
+            case 'p':
+                if(!read_pots(optarg, &defaults.settings)) {
+                    fprintf(stderr, "rack_sim: -p needs 4 readings\n");
+                    return 1;
+                }
+                break;
+            case 'P': spread = atol(optarg); break;
+            case 'D': chain = 1; break;
+            case 'd': defaults.delay_us = atoll(optarg); break;
+            case 'R': rack.ref = atoi(optarg); break;
+            case 'W': rack.window = atoll(optarg); break;
+            case 'T': threads = atoi(optarg); break;
+            case 'E': rack.epoch_ms = atoll(optarg); break;
+            case 'o': log_path = optarg; break;
+            case 'B': bin_path = optarg; break;
+            case 'F': fast = 0; break;
+            case 'C': compare = 1; break;
+            case 'L': snprintf(lib_path, sizeof(lib_path), "%s", optarg); break;
+            default:
+                fprintf(stderr, "usage: rack_sim [-N count] [-M modules] [-t seconds] "
+                    "[-e period_us] [-j jitter_us] [-x n] [-X us] [-s steps] [-b bars] "
+                    "[-n trigs] [-m mode] [-c curve] [-p a,b,c,d] [-r bpm] [-P ppm] "
+                    "[-D] [-d us] [-R module] [-W us] [-T threads] [-E ms] [-o log] "
+                    "[-B binary_log] [-F] [-C] [-L library]\n");
+                return 1;
+        }
+    }
+    if(modules_path) {
+        rack.num_modules = read_modules(modules_path, &defaults, &rack.modules);
+    }
+    else if(rack.num_modules > 0) {
+        rack.modules = malloc(rack.num_modules * sizeof(MODULE));
+        for(int i=0; i<rack.num_modules; ++i) {
+            rack.modules[i] = defaults;
+            rack.modules[i].ppm = spread ? spread_ppm(i, spread) : 0;
+            if(chain && i) {
+                rack.modules[i].clock = i - 1;
+            }
+        }
+    }
+    for(int i=0; i<rack.num_modules; ++i) {
+        const MODULE *m = &rack.modules[i];
+        if(m->settings.num_trigs < 1 || m->settings.num_trigs > 64 ||
+            m->settings.reset_mode < 0 || m->settings.reset_mode > 3 ||
+            m->settings.curve < 0 || m->settings.curve > 3 ||
+            m->clock < CLOCK_BUS || m->clock >= rack.num_modules || m->clock == i ||
+            m->ppm <= -500000 || m->ppm >= 500000 || m->delay_us < 0) {
+            fprintf(stderr, "rack_sim: bad setting for module %d\n", i);
+            return 1;
+        }
+    }
+    if(rack.num_modules < 1 || rack.ref < 0 || rack.ref >= rack.num_modules ||
+        rack.period <= 0 || rack.jitter < 0 || rack.jitter >= rack.period ||
+        rack.reset_every < 0 || rack.window < 0 || rack.epoch_ms < 1 ||
+        threads < 1 || spread < 0 || spread >= 500000) {
+        fprintf(stderr, "rack_sim: bad setting\n");
+        return 1;
+    }
+    if(!set_levels(&rack)) {
+        fprintf(stderr, "rack_sim: the modules clock each other in a loop\n");
+        return 1;
+    }
+    if(!lib_path[0]) {
+        fw_lib_default_path(lib_path, sizeof(lib_path));
+    }
+    if(log_path && !compare) {
+        rack.log = fopen(log_path, "w");
+        if(!rack.log) {
+            perror(log_path);
+            return 1;
+        }
+    }
+    if(bin_path && !compare) {
+        rack.bin = tbin_create(bin_path);
+        if(!rack.bin) {
+            return 1;
+        }
+    }
+    rack.end_ms = (long long)(seconds * 1000);
+
+    if(compare) {
+        double secs = run(&rack, lib_path, 1, fast);
+        unsigned long long hash = rack_hash(&rack);
+        summary("1 thread", &rack, 1, secs);
+        secs = run(&rack, lib_path, threads, fast);
+        summary("threads", &rack, threads, secs);
+        if(hash != rack_hash(&rack)) {
+            fprintf(stderr, "rack_sim: the output is different\n");
+            return 1;
+        }
+    }
+    else {
+        double secs = run(&rack, lib_path, threads, fast);
+        summary(fast ? "fast forward" : "every tick", &rack, threads, secs);
+        if(rack.log) {
+            fclose(rack.log);
+        }
+        if(rack.bin && !tbin_finish(rack.bin)) {
+            return 1;
+        }
+    }
+    report(&rack);
+    return 0;
+}
@@ -0,0 +1,126 @@
+#include <stdio.h>
+#include "sim.h"
+
+static const char *event_name[] = {
+    "clock", "reset", "trig", "pattern", "drops", "restart", "rollover", "dump"
+};
+
+////////////////////////////////////////////////////////////////////////////////
+const char *sim_event_name(int type) {
+    return (type >= 0 && type < (int)(sizeof(event_name)/sizeof(event_name[0]))) ? 
+        event_name[type] : "event";
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// real time to the firmware's time, and back
+static long long to_local(const SIM *sim, long long time_us) {
+    return sim->ppm ? time_us * (1000000 + sim->ppm) / 1000000 : time_us;
+}
+
+static long long to_real(const SIM *sim, long long local_us) {
+    return sim->ppm ? local_us * 1000000 / (1000000 + sim->ppm) : local_us;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static void fw_event_hook(void *ctx, int type, int data, int sub_us) {
+    SIM *sim = ctx;
+    sim->sink(sim->sink_ctx, to_real(sim, sim->ms * 1000 + sub_us), 
+        sim_event_name(type), data);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static void check_outputs(SIM *sim, long long local_us) {
+    long long time_us = to_real(sim, local_us);
+    int outputs = fw_outputs();
+    int changed = outputs ^ sim->outputs;
+    sim->outputs = outputs;
+    if(!changed || !sim->log_pins) {
+        return;
+    }
+    if(changed & FW_OUT_TRIG) {
+        sim->sink(sim->sink_ctx, time_us, "out", !!(outputs & FW_OUT_TRIG));
+    }
+    if(changed & FW_OUT_CLOCK_LED) {
+        sim->sink(sim->sink_ctx, time_us, "clockled", !!(outputs & FW_OUT_CLOCK_LED));
+    }
+    if(changed & FW_OUT_POS_LED_MASK) {
+        sim->sink(sim->sink_ctx, time_us, "led", 
+            ((outputs & FW_OUT_POS_LED_MASK) >> FW_OUT_POS_LED_SHIFT) - 1);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static void fetch(SIM *sim) {
+    sim->have_next = sim->source && sim->source(sim->source_ctx, &sim->next);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static void apply(SIM *sim, const SIM_INPUT *in, long long local_us) {
+    int sub_us = (int)(local_us - sim->ms * 1000);
+    switch(in->type) {
+        case SIM_IN_CLOCK:
+            fw_clock_edge(sub_us);
+            break;
+        case SIM_IN_RESET:
+            fw_reset_input(in->value, sub_us);
+            break;
+        case SIM_IN_POT:
+            fw_set_pot(in->which, in->value);
+            break;
+        case SIM_IN_BUTTON:
+            fw_set_button(in->value);
+            break;
+    }
+    check_outputs(sim, local_us);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void sim_start(SIM *sim, const FW_SETTINGS *settings) {
+    sim->ms = 0;
+    sim->ticks_run = 0;
+    sim->ticks_skipped = 0;
+    fw_set_event_hook(fw_event_hook, sim);
+    fw_power_on(settings);
+    sim->outputs = fw_outputs();
+    fetch(sim);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Run until the firmware's ms count reaches end_ms. Inputs are applied 
+// after the tick of the ms they fall in, which in fast mode can be skipped
+// like any other. If the source had no more inputs, it is asked again
+void sim_run(SIM *sim, long long end_ms) {
+    if(!sim->have_next) {
+        fetch(sim);
+    }
+    while(sim->ms < end_ms) {
+        long long next_us = sim->have_next ? to_local(sim, sim->next.time_us) : 0;
+        while(sim->have_next && next_us < (sim->ms + 1) * 1000) {
+            // inputs in the past happen now
+            apply(sim, &sim->next, (next_us < sim->ms * 1000) ? sim->ms * 1000 : next_us);
+            fetch(sim);
+            next_us = sim->have_next ? to_local(sim, sim->next.time_us) : 0;
+        }
+        if(sim->fast) {
+            // skip up to the tick of the ms of the next input
+            long long limit = end_ms - sim->ms;
+            if(sim->have_next && next_us / 1000 - sim->ms < limit) {
+                limit = next_us / 1000 - sim->ms;
+            }
+            if(limit > 0x7FFFFFFFLL) {
+                limit = 0x7FFFFFFFLL;
+            }
+            long skip = fw_idle_ms((long)limit, sim->log_pins);
+            if(skip > 0) {
+                fw_skip(skip);
+                sim->ms += skip;
+                sim->ticks_skipped += skip;
+                continue;
+            }
+        }
+        ++sim->ms;
+        ++sim->ticks_run;
+        fw_tick();
+        check_outputs(sim, sim->ms * 1000);
+    }
+}
@@ -0,0 +1,57 @@
+/*
+ Runs one firmware instance (fw.h) against a stream of timed inputs and
+ reports what it does: the firmware's trace events and, optionally, the 
+ changes of its output pins. In fast mode the ticks on which nothing can 
+ happen are skipped (see fw_idle_ms()), which gives the same output as 
+ running every tick.
+
+ Input and output times are real time. The firmware's ms ticks can be made
+ faster or slower than that by ppm, as its oscillator would be.
+ */
+#ifndef SIM_H
+#define SIM_H
+#include "fw.h"
+
+enum {
+    SIM_IN_CLOCK,               // clock edge
+    SIM_IN_RESET,               // reset input goes to value
+    SIM_IN_POT,                 // pot which moves to value
+    SIM_IN_BUTTON               // button pressed (value 1) or released
+};
+
+typedef struct {
+    long long time_us;
+    int type;                   // SIM_IN_xxx
+    int which;
+    int value;
+} SIM_INPUT;
+
+// fills in the next input, in time order. Returns 0 when there are no more
+// for now (the next sim_run() asks again)
+typedef int (*SIM_SOURCE)(void *ctx, SIM_INPUT *input);
+
+// called for each event, with the name used by host/trace_analyse -t
+typedef void (*SIM_SINK)(void *ctx, long long time_us, const char *name, int data);
+
+typedef struct {
+    SIM_SOURCE source;
+    void *source_ctx;
+    SIM_SINK sink;
+    void *sink_ctx;
+    int fast;                   // skip idle ticks
+    int log_pins;               // report output pin changes too
+    long ppm;                   // error of the firmware's clock, + is fast
+    
+    long long ms;               // ticks run or skipped since power on
+    SIM_INPUT next;
+    int have_next;
+    int outputs;                // fw_outputs() last seen
+    unsigned long long ticks_run;
+    unsigned long long ticks_skipped;
+} SIM;
+
+void sim_start(SIM *sim, const FW_SETTINGS *settings);
+void sim_run(SIM *sim, long long end_ms);
+const char *sim_event_name(int type);
+
+#endif
@@ -0,0 +1,375 @@
+/*
+ Runs the d-ticker firmware on the host and writes what it does in the
+ text format read by host/trace_analyse -t.
+
+    make -C host ticker_sim
+    ticker_sim [options] > log.txt
+
+ Options:
+    -t seconds  time to run for (default 60)
+    -r bpm      internal clock BPM (default 120)
+    -s steps    steps per bar (default 16)
+    -b bars     bars in the pattern (default 1)
+    -n trigs    trigs in the pattern (default 16)
+    -m mode     reset mode, 0 to 3 (RESET_MODE_xxx, default 0)
+    -c curve    pattern curve, 0 to 3 (PAT_CURVE_xxx, default 0)
+    -p a,b,c,d  pot readings (default 128,128,128,128)
+    -e us       external clock period, none by default
+    -j us       external clock jitter, the most each edge is moved by
+    -i file     inputs, one per line in time order:
+                    <time in us> clock
+                    <time in us> reset 0|1
+                    <time in us> pot <0..3> <0..255>
+                    <time in us> button 0|1
+    -l          also log the output pins: out, clockled and led (-1 for off)
+    -f          fast forward over the ticks where nothing happens
+    -C          run both ways and check the output is the same
+    -q          no log, just a summary on stderr
+    -B file     also write the log as a binary trace (tbin/tbin.h), or only
+                that with -q
+    -E file     power on with the data EEPROM saved in file by an earlier 
+                run, if there is one, and save it there at the end. The 
+                module then starts with the settings saved in the EEPROM
+                rather than those given here, as after a power cut
+
+ External clock edges from -e and -i are merged.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/wait.h>
+#include "sim.h"
+#include "tbin.h"
+
+typedef struct {
+    // generated external clock
+    long long period;
+    long long jitter;
+    long long next_edge;
+    unsigned long rand;
+    // input file
+    FILE *file;
+    const char *path;
+    int line;
+    SIM_INPUT file_next;
+    int have_file;
+    int have_edge;
+    const char *ee_path;        // EEPROM saved between runs, or NULL
+} INPUTS;
+
+typedef struct {
+    FILE *out;                  // or NULL for none
+    TBIN_WRITER *bin;           // or NULL for none
+    unsigned long long count;
+    unsigned long long hash;    // FNV-1a of the events, by words
+} LOG;
+
+////////////////////////////////////////////////////////////////////////////////
+static int read_input(INPUTS *in) {
+    char line[256];
+    char name[32];
+    while(fgets(line, sizeof(line), in->file)) {
+        ++in->line;
+        SIM_INPUT *i = &in->file_next;
+        int a = 0;
+        int b = 0;
+        if(line[0] == '#' || line[strspn(line, " \t\r\n")] == 0) {
+            continue;
+        }
+        if(sscanf(line, "%lld %31s %d %d", &i->time_us, name, &a, &b) < 2) {
+            fprintf(stderr, "%s:%d: bad input\n", in->path, in->line);
+            exit(1);
+        }
+        i->which = 0;
+        i->value = a;
+        if(!strcmp(name, "clock")) {
+            i->type = SIM_IN_CLOCK;
+        }
+        else if(!strcmp(name, "reset")) {
+            i->type = SIM_IN_RESET;
+        }
+        else if(!strcmp(name, "pot") && a >= 0 && a < 4) {
+            i->type = SIM_IN_POT;
+            i->which = a;
+            i->value = b;
+        }
+        else if(!strcmp(name, "button")) {
+            i->type = SIM_IN_BUTTON;
+        }
+        else {
+            fprintf(stderr, "%s:%d: bad input\n", in->path, in->line);
+            exit(1);
+        }
+        return 1;
+    }
+    return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static long long next_jitter(INPUTS *in) {
+    if(!in->jitter) {
+        return 0;
+    }
+    in->rand = in->rand * 1103515245UL + 12345UL;
+    return (long long)((in->rand >> 8) % (unsigned long)(2 * in->jitter + 1)) - in->jitter;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static int next_input(void *ctx, SIM_INPUT *input) {
+    INPUTS *in = ctx;
+    if(in->have_edge && (!in->have_file || in->next_edge <= in->file_next.time_us)) {
+        input->time_us = in->next_edge + next_jitter(in);
+        input->type = SIM_IN_CLOCK;
+        input->which = 0;
+        input->value = 0;
+        in->next_edge += in->period;
+        return 1;
+    }
+    if(in->have_file) {
+        *input = in->file_next;
+        in->have_file = read_input(in);
+        return 1;
+    }
+    return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// FNV-1a a 64 bit word at a time rather than a byte, as a long run hashes
+// tens of millions of events
+static void hash_word(LOG *log, unsigned long long word) {
+    log->hash = (log->hash ^ word) * 0x100000001B3ULL;
+}
+
+static void log_event(void *ctx, long long time_us, const char *name, int data) {
+    LOG *log = ctx;
+    hash_word(log, (unsigned long long)time_us);
+    for(const char *p = name; *p; ) {
+        unsigned long long word = 0;
+        for(int i=0; i<8 && *p; ++i) {
+            word |= (unsigned long long)(unsigned char)*p++ << (8 * i);
+        }
+        hash_word(log, word);
+    }
+    hash_word(log, (unsigned)data);
+    ++log->count;
+    if(log->out) {
+        fprintf(log->out, "%lld %s %d\n", time_us, name, data);
+    }
+    if(log->bin) {
+        tbin_write(log->bin, time_us, tbin_type(log->bin, name), 0, data);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// returns 0 if there is no EEPROM saved in the file
+static int load_eeprom(const char *path, unsigned char *eeprom) {
+    FILE *f = fopen(path, "rb");
+    if(!f) {
+        return 0;
+    }
+    size_t got = fread(eeprom, 1, FW_EEPROM_SIZE, f);
+    fclose(f);
+    if(got != FW_EEPROM_SIZE) {
+        fprintf(stderr, "%s: not a saved EEPROM\n", path);
+        exit(1);
+    }
+    return 1;
+}
+
+static void save_eeprom(const char *path) {
+    FILE *f = fopen(path, "wb");
+    if(!f || fwrite(fw_eeprom(), 1, FW_EEPROM_SIZE, f) != FW_EEPROM_SIZE || fclose(f)) {
+        perror(path);
+        exit(1);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static double run(const FW_SETTINGS *settings, INPUTS *in, LOG *log,
+    int fast, int log_pins, long long end_ms, SIM *sim)
+{
+    if(in->path) {
+        rewind(in->file);
+        in->line = 0;
+        in->have_file = read_input(in);
+    }
+    in->have_edge = (in->period > 0);
+    in->next_edge = in->period;
+    in->rand = 1;
+    log->count = 0;
+    log->hash = 0xCBF29CE484222325ULL;
+
+    memset(sim, 0, sizeof(*sim));
+    sim->source = next_input;
+    sim->source_ctx = in;
+    sim->sink = log_event;
+    sim->sink_ctx = log;
+    sim->fast = fast;
+    sim->log_pins = log_pins;
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    sim_start(sim, settings);
+    sim_run(sim, end_ms);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    if(in->ee_path) {
+        save_eeprom(in->ee_path);
+    }
+    return (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) * 1e-9;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// The firmware's variables (some of them static in functions) are only 
+// cleared when the program starts, as the PIC's RAM is at power on. So a 
+// second run in the same process would not start the same as the first. 
+// This does the run in a child process and passes back the results
+static double run_apart(const FW_SETTINGS *settings, INPUTS *in, LOG *log,
+    int fast, int log_pins, long long end_ms, SIM *sim)
+{
+    struct {
+        LOG log;
+        SIM sim;
+        double secs;
+    } result;
+    int fds[2];
+    fflush(NULL);
+    if(pipe(fds)) {
+        perror("pipe");
+        exit(1);
+    }
+    pid_t pid = fork();
+    if(pid < 0) {
+        perror("fork");
+        exit(1);
+    }
+    if(!pid) {
+        close(fds[0]);
+        result.secs = run(settings, in, log, fast, log_pins, end_ms, &result.sim);
+        result.log = *log;
+        _exit(write(fds[1], &result, sizeof(result)) != sizeof(result));
+    }
+    close(fds[1]);
+    size_t got = 0;
+    while(got < sizeof(result)) {
+        ssize_t n = read(fds[0], (char *)&result + got, sizeof(result) - got);
+        if(n <= 0) {
+            fprintf(stderr, "ticker_sim: the run failed\n");
+            exit(1);
+        }
+        got += n;
+    }
+    close(fds[0]);
+    waitpid(pid, NULL, 0);
+    *log = result.log;
+    *sim = result.sim;
+    return result.secs;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static void summary(const char *name, const SIM *sim, const LOG *log, double secs) {
+    fprintf(stderr, "%s: %llu events, %llu ticks run, %llu skipped, %.3fs, "
+        "log hash %016llx\n", name, log->count, sim->ticks_run,
+        sim->ticks_skipped, secs, log->hash);
+}
+
+int main(int argc, char *argv[]) {
+    FW_SETTINGS settings = {
+        120, 16, 1, 16, 0, 0, { 128, 128, 128, 128 }
+    };
+    INPUTS in;
+    memset(&in, 0, sizeof(in));
+    double seconds = 60;
+    int fast = 0;
+    int compare = 0;
+    int quiet = 0;
+    int log_pins = 0;
+    const char *bin_path = NULL;
+    unsigned char eeprom[FW_EEPROM_SIZE];
+    int opt;
+    while((opt = getopt(argc, argv, "t:r:s:b:n:m:c:p:e:j:i:lfCqB:E:")) != -1) {
+        switch(opt) {
+            case 't': seconds = atof(optarg); break;
+            case 'r': settings.bpm = atoi(optarg); break;
+            case 's': settings.num_steps = atoi(optarg); break;
+            case 'b': settings.num_bars = atoi(optarg); break;
+            case 'n': settings.num_trigs = atoi(optarg); break;
+            case 'm': settings.reset_mode = atoi(optarg); break;
+            case 'c': settings.curve = atoi(optarg); break;
+            case 'p': {
+                int p[4];
+                if(sscanf(optarg, "%d,%d,%d,%d", &p[0], &p[1], &p[2], &p[3]) != 4) {
+                    fprintf(stderr, "ticker_sim: -p needs 4 readings\n");
+                    return 1;
+                }
+                for(int i=0; i<4; ++i) {
+                    settings.pots[i] = (unsigned char)p[i];
+                }
+                break;
+            }
+            case 'e': in.period = atoll(optarg); break;
+            case 'j': in.jitter = atoll(optarg); break;
+            case 'i': in.path = optarg; break;
+            case 'l': log_pins = 1; break;
+            case 'f': fast = 1; break;
+            case 'C': compare = 1; break;
+            case 'q': quiet = 1; break;
+            case 'B': bin_path = optarg; break;
+            case 'E': in.ee_path = optarg; break;
+            default:
+                fprintf(stderr, "usage: ticker_sim [-t seconds] [-r bpm] "
+                    "[-s steps] [-b bars] [-n trigs] [-m mode] [-c curve] "
+                    "[-p a,b,c,d] [-e period_us] [-j jitter_us] [-i inputs] "
+                    "[-l] [-f] [-C] [-q] [-B binary_log] [-E eeprom]\n");
+                return 1;
+        }
+    }
+    if(settings.num_trigs < 1 || settings.num_trigs > 64 ||
+        settings.reset_mode < 0 || settings.reset_mode > 3 ||
+        settings.curve < 0 || settings.curve > 3 ||
+        in.period < 0 || in.jitter < 0 || (in.period && in.jitter >= in.period)) {
+        fprintf(stderr, "ticker_sim: bad setting\n");
+        return 1;
+    }
+    if(in.path) {
+        in.file = fopen(in.path, "r");
+        if(!in.file) {
+            perror(in.path);
+            return 1;
+        }
+    }
+    if(in.ee_path && load_eeprom(in.ee_path, eeprom)) {
+        settings.eeprom = eeprom;
+    }
+    long long end_ms = (long long)(seconds * 1000);
+
+    SIM sim;
+    LOG log = { (quiet || compare) ? NULL : stdout, NULL, 0, 0 };
+    if(compare) {
+        LOG fast_log = log;
+        SIM fast_sim;
+        double secs = run_apart(&settings, &in, &log, 0, log_pins, end_ms, &sim);
+        double fast_secs = run_apart(&settings, &in, &fast_log, 1, log_pins, end_ms, &fast_sim);
+        summary("every tick", &sim, &log, secs);
+        summary("fast forward", &fast_sim, &fast_log, fast_secs);
+        if(log.count != fast_log.count || log.hash != fast_log.hash) {
+            fprintf(stderr, "ticker_sim: the output is different\n");
+            return 1;
+        }
+        return 0;
+    }
+    if(bin_path) {
+        log.bin = tbin_create(bin_path);
+        if(!log.bin) {
+            return 1;
+        }
+    }
+    double secs = run(&settings, &in, &log, fast, log_pins, end_ms, &sim);
+    if(log.bin && !tbin_finish(log.bin)) {
+        return 1;
+    }
+    if(quiet) {
+        summary(fast ? "fast forward" : "every tick", &sim, &log, secs);
+    }
+    return 0;
+}
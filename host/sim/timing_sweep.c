@@ -0,0 +1,525 @@
+/*
+ Runs the d-ticker firmware over a grid of clock rates, steps and trig
+ counts and measures how well it keeps time at each point, giving a heat
+ map of where the module keeps time and where it falls apart. Running it
+ with -L on two firmware builds gives maps that can be compared line by
+ line.
+
+    make -C host timing_sweep
+    timing_sweep [options] > map.csv
+
+ The grid is every internal clock BPM (-r) and every external clock period
+ (-e), each with every count of steps (-s) and trigs (-n). A list is a
+ comma separated list of values or ranges first-last or first-last/step,
+ and an empty list leaves that clock out. The firmware only offers even
+ BPMs and steps which are a power of two, and rounds other settings (see
+ clock.c). The ideal times here use the settings as asked for, so the map
+ shows what a rounded setting does to the timing.
+
+ Each point is run from power on for -C cycles of the pattern, or -t
+ seconds if that is shorter. The external clock is a steady clock starting
+ at 10ms. Timing is only counted from the second step after the clock
+ starts (by the trigs' ideal times), since the first step runs at the
+ internal tempo until the second edge sets the rate.
+
+ The map is CSV, a line per point in grid order:
+    clock       int or ext
+    rate        BPM for int, period in us for ext
+    steps, trigs
+    cycles      pattern cycles counted
+    fired       trigs fired by the sequencer
+    dropped     trigs skipped (the sequencer moves to the next cycle
+                before they fire)
+    coalesced   trigs fired which never got a pulse of their own: the
+                output queue (out_trig()) holds 255 and more are lost
+    late_min_us, late_mean_us, late_max_us
+                when each trig fired against its ideal time: a grid at the
+                nominal tempo from power on (int) or from the first clock
+                edge (ext), with the positions of the firmware's trig table
+    out_late_max_us
+                latest start of a trig's output pulse against its ideal
+                time, which includes waiting in the output queue
+    queue_max   most trigs waiting for the output at once
+    out_load    trigs per second times the 15ms a pulse takes; over 1 the
+                output is saturated and the queue only grows
+
+ Options:
+    -r list     internal clock BPMs (default 16-526/10)
+    -e list     external clock periods in ms
+                (default 10,15,20,30,50,100,200,500,1000,2000,3000)
+    -s list     steps per bar (default 2,4,8,16,32,64)
+    -n list     trigs (default 1,2,3,4,6,8,12,16,24,32,48,64)
+    -b bars     bars in the pattern (default 1)
+    -c curve    pattern curve (default 0)
+    -p a,b,c,d  pot readings (default 128,128,128,128, evenly spaced trigs)
+    -C cycles   pattern cycles to run each point for (default 4)
+    -t seconds  longest run of a point (default 60)
+    -o file     the map (default stdout)
+    -T threads  (default one per processor)
+    -q          no progress on stderr
+    -L file     firmware library (default ticker_fw.so beside timing_sweep)
+
+ A summary of the points which drop, coalesce or saturate goes to stderr.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <limits.h>
+#include <pthread.h>
+#include <dlfcn.h>
+#include "fw_lib.h"
+#include "pool.h"
+
+enum {
+    MAX_VALUES = 1024,          // in a grid list
+    EXT_START_US = 10000,       // first external clock edge
+    OUT_QUEUE = 256,            // trigs out_trig() can count
+    OUT_PULSE_US = 15000,       // a trig pulse, high and low (output.c)
+    POS_SCALE = 65536,          // trig positions run over the pattern
+    MAX_TICK_TRIGS = 64         // trigs fired in a tick
+};
+
+typedef struct {
+    int external;
+    int rate;                   // BPM or period in us
+    int steps;
+    int trigs;
+} POINT;
+
+typedef struct {
+    long long cycles;
+    long long fired;
+    long long dropped;
+    long long coalesced;
+    long long late_min;
+    long long late_max;
+    double late_total;
+    long long late_count;
+    long long out_late_max;
+    int queue_max;
+    double out_load;
+} RESULT;
+
+// a thread's copy of the firmware
+typedef struct {
+    FW_LIB lib;
+    unsigned (*get_trig)(int pos);
+} THREAD_FW;
+
+// one run of a point
+typedef struct {
+    const POINT *point;
+    THREAD_FW *fw;
+    RESULT *res;
+    long long end_us;
+    long long next_edge;
+    double cycle_us;
+    long long start_us;         // time of phase 0 of the first cycle
+    long long count_from;       // timing is counted from here
+    int last_trig;              // since the clock started
+    long long cycle;
+    long long queue[OUT_QUEUE]; // ideal times of the trigs waiting to output
+    int queue_head;
+    int queue_len;
+    int out_high;
+    long long started_us;       // pulse not yet matched to its trig, or -1
+    struct {
+        long long time_us;
+        int trig;
+    } tick_trigs[MAX_TICK_TRIGS];
+    int num_tick_trigs;
+} RUN;
+
+static struct {
+    POINT *points;
+    RESULT *results;
+    int num_points;
+    FW_SETTINGS settings;
+    double cycles;
+    long long max_us;
+    char lib_path[PATH_MAX];
+    int quiet;
+    int done;
+    pthread_mutex_t lock;
+    THREAD_FW *fws[256];
+    int num_fws;
+} sw;
+
+static __thread THREAD_FW *thread_fw;
+
+////////////////////////////////////////////////////////////////////////////////
+// Parses a list such as 16-526/10,600. Returns the count, 0 if it is bad
+static int parse_list(const char *text, int *values, int lo, int hi) {
+    int count = 0;
+    const char *p = text;
+    while(*p) {
+        char *end;
+        long first = strtol(p, &end, 10);
+        long last = first;
+        long step = 1;
+        if(end == p) {
+            return 0;
+        }
+        if(*end == '-') {
+            p = end + 1;
+            last = strtol(p, &end, 10);
+            if(end == p) {
+                return 0;
+            }
+            if(*end == '/') {
+                p = end + 1;
+                step = strtol(p, &end, 10);
+                if(end == p || step < 1) {
+                    return 0;
+                }
+            }
+        }
+        if(first < lo || last > hi || last < first) {
+            return 0;
+        }
+        for(long v = first; v <= last; v += step) {
+            if(count == MAX_VALUES) {
+                return 0;
+            }
+            values[count++] = (int)v;
+        }
+        if(*end && *end != ',') {
+            return 0;
+        }
+        p = *end ? end + 1 : end;
+    }
+    return count;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static THREAD_FW *get_thread_fw() {
+    if(!thread_fw) {
+        THREAD_FW *fw = calloc(1, sizeof(THREAD_FW));
+        fw_lib_load(&fw->lib, sw.lib_path);
+        fw->get_trig = (unsigned (*)(int))dlsym(fw->lib.handle, "pat_get_trig");
+        if(!fw->get_trig) {
+            fprintf(stderr, "timing_sweep: %s has no pat_get_trig\n", sw.lib_path);
+            exit(1);
+        }
+        pthread_mutex_lock(&sw.lock);
+        sw.fws[sw.num_fws++] = fw;
+        pthread_mutex_unlock(&sw.lock);
+        thread_fw = fw;
+    }
+    return thread_fw;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static int next_edge(void *ctx, SIM_INPUT *input) {
+    RUN *run = ctx;
+    if(!run->point->external || run->next_edge >= run->end_us) {
+        return 0;
+    }
+    input->time_us = run->next_edge;
+    input->type = SIM_IN_CLOCK;
+    input->which = 0;
+    input->value = 0;
+    run->next_edge += run->point->rate;
+    return 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// The cycle of the pattern moves on when the trig number goes back, which
+// holds however late the trigs are. Trigs before the clock starts (the
+// internal clock runs until the first external edge) are not timed
+static void fired(RUN *run, long long time_us, int trig) {
+    RESULT *res = run->res;
+    int n = run->point->trigs;
+    long long ideal = LLONG_MIN;
+    if(time_us >= run->start_us) {
+        if(run->last_trig < 0) {
+            run->cycle = 0;
+        }
+        else if(trig <= run->last_trig) {
+            ++run->cycle;
+        }
+        double pos = (double)run->fw->get_trig(trig) / POS_SCALE;
+        ideal = run->start_us + (long long)((run->cycle + pos) * run->cycle_us + 0.5);
+    }
+    int counting = ideal >= run->count_from;
+    int expected = (run->last_trig + 1) % n;
+    if(counting && trig != expected) {
+        res->dropped += (trig > expected) ? trig - expected : n - expected + trig;
+    }
+    if(counting && trig <= run->last_trig) {
+        ++res->cycles;
+    }
+    if(time_us >= run->start_us) {
+        run->last_trig = trig;
+    }
+
+    if(counting) {
+        long long late = time_us - ideal;
+        if(!res->late_count || late < res->late_min) {
+            res->late_min = late;
+        }
+        if(!res->late_count || late > res->late_max) {
+            res->late_max = late;
+        }
+        res->late_total += late;
+        ++res->late_count;
+        ++res->fired;
+    }
+
+    // a pulse started by out_trig() itself, with nothing running or queued
+    if(run->started_us >= 0) {
+        if(counting && run->started_us - ideal > res->out_late_max) {
+            res->out_late_max = run->started_us - ideal;
+        }
+        run->started_us = -1;
+        return;
+    }
+    // the output queue holds 255 trigs. With one more it looks empty and
+    // the queued trigs are lost
+    if(run->queue_len == OUT_QUEUE - 1) {
+        if(counting) {
+            res->coalesced += OUT_QUEUE;
+        }
+        run->queue_len = 0;
+        return;
+    }
+    run->queue[(run->queue_head + run->queue_len++) % OUT_QUEUE] = counting ? ideal : LLONG_MIN;
+    if(run->queue_len > res->queue_max && counting) {
+        res->queue_max = run->queue_len;
+    }
+}
+
+static void flush_trigs(RUN *run) {
+    for(int i=0; i<run->num_tick_trigs; ++i) {
+        fired(run, run->tick_trigs[i].time_us, run->tick_trigs[i].trig);
+    }
+    run->num_tick_trigs = 0;
+}
+
+// A pulse which starts when there are queued trigs was started by the ISR
+// for the first of them. Otherwise it is for the first trig of this tick
+static void output(RUN *run, long long time_us, int level) {
+    if(level && !run->out_high) {
+        if(run->queue_len) {
+            long long ideal = run->queue[run->queue_head];
+            run->queue_head = (run->queue_head + 1) % OUT_QUEUE;
+            --run->queue_len;
+            if(ideal != LLONG_MIN && time_us - ideal > run->res->out_late_max) {
+                run->res->out_late_max = time_us - ideal;
+            }
+        }
+        else {
+            run->started_us = time_us;
+        }
+    }
+    run->out_high = level;
+}
+
+// The pins are seen at the end of each tick, after the trigs the main loop
+// fired in it, but the ISR changed them first. So the trigs of a tick are
+// held until its pins have been seen
+static void sweep_event(void *ctx, long long time_us, const char *name, int data) {
+    RUN *run = ctx;
+    if(run->num_tick_trigs && run->tick_trigs[0].time_us / 1000 != time_us / 1000) {
+        flush_trigs(run);
+    }
+    if(!strcmp(name, "trig") && run->num_tick_trigs < MAX_TICK_TRIGS) {
+        run->tick_trigs[run->num_tick_trigs].time_us = time_us;
+        run->tick_trigs[run->num_tick_trigs++].trig = data;
+    }
+    else if(!strcmp(name, "out")) {
+        output(run, time_us, data);
+        flush_trigs(run);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static void run_point(void *ctx, int index) {
+    (void)ctx;
+    const POINT *p = &sw.points[index];
+    RESULT *res = &sw.results[index];
+    RUN run;
+    memset(&run, 0, sizeof(run));
+    run.point = p;
+    run.fw = get_thread_fw();
+    run.res = res;
+    run.last_trig = -1;
+    run.started_us = -1;
+    double step_us = p->external ? p->rate : 60e6 / p->rate;
+    run.cycle_us = step_us * p->steps * sw.settings.num_bars;
+    run.start_us = p->external ? EXT_START_US : 0;
+    run.count_from = run.start_us + (long long)step_us;
+    run.next_edge = EXT_START_US;
+    long long length = (long long)(sw.cycles * run.cycle_us);
+    run.end_us = run.start_us + (length < sw.max_us ? length : sw.max_us);
+    memset(res, 0, sizeof(*res));
+
+    FW_SETTINGS settings = sw.settings;
+    settings.bpm = p->external ? 120 : p->rate;
+    settings.num_steps = p->steps;
+    settings.num_trigs = p->trigs;
+    SIM sim;
+    memset(&sim, 0, sizeof(sim));
+    sim.source = next_edge;
+    sim.source_ctx = &run;
+    sim.sink = sweep_event;
+    sim.sink_ctx = &run;
+    sim.fast = 1;
+    sim.log_pins = 1;
+    fw_lib_restore(&run.fw->lib);
+    run.fw->lib.sim_start(&sim, &settings);
+    run.fw->lib.sim_run(&sim, (run.end_us + 999) / 1000);
+    flush_trigs(&run);
+
+    long long counted_us = run.end_us - run.count_from;
+    res->out_load = (counted_us > 0) ? (double)res->fired * OUT_PULSE_US / counted_us : 0;
+
+    int done = __atomic_add_fetch(&sw.done, 1, __ATOMIC_RELAXED);
+    if(!sw.quiet && done * 20 / sw.num_points != (done - 1) * 20 / sw.num_points) {
+        fprintf(stderr, "\r%d of %d points", done, sw.num_points);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static void add_points(int external, const int *rates, int num_rates, const int *steps,
+    int num_steps, const int *trigs, int num_trigs)
+{
+    for(int r=0; r<num_rates; ++r) {
+        for(int s=0; s<num_steps; ++s) {
+            for(int t=0; t<num_trigs; ++t) {
+                POINT *p = &sw.points[sw.num_points++];
+                p->external = external;
+                p->rate = external ? rates[r] * 1000 : rates[r];
+                p->steps = steps[s];
+                p->trigs = trigs[t];
+            }
+        }
+    }
+}
+
+static int read_pots(const char *text, FW_SETTINGS *settings) {
+    int p[4];
+    if(sscanf(text, "%d,%d,%d,%d", &p[0], &p[1], &p[2], &p[3]) != 4) {
+        return 0;
+    }
+    for(int i=0; i<4; ++i) {
+        settings->pots[i] = (unsigned char)p[i];
+    }
+    return 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+int main(int argc, char *argv[]) {
+    static int bpms[MAX_VALUES], periods[MAX_VALUES], steps[MAX_VALUES], trigs[MAX_VALUES];
+    int num_bpms = parse_list("16-526/10", bpms, 16, 526);
+    int num_periods = parse_list("10,15,20,30,50,100,200,500,1000,2000,3000", periods, 10, 3000);
+    int num_steps = parse_list("2,4,8,16,32,64", steps, 2, 64);
+    int num_trigs = parse_list("1,2,3,4,6,8,12,16,24,32,48,64", trigs, 1, 64);
+    FW_SETTINGS settings = {
+        120, 16, 1, 16, 0, 0, { 128, 128, 128, 128 }
+    };
+    sw.settings = settings;
+    sw.cycles = 4;
+    double max_seconds = 60;
+    const char *out_path = NULL;
+    int threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int opt;
+    int ok = 1;
+    while(ok && (opt = getopt(argc, argv, "r:e:s:n:b:c:p:C:t:o:T:qL:")) != -1) {
+        switch(opt) {
+            case 'r': num_bpms = parse_list(optarg, bpms, 16, 526); ok = num_bpms || !*optarg; break;
+            case 'e':
+                num_periods = parse_list(optarg, periods, 10, 3000);
+                ok = num_periods || !*optarg;
+                break;
+            case 's': ok = num_steps = parse_list(optarg, steps, 2, 64); break;
+            case 'n': ok = num_trigs = parse_list(optarg, trigs, 1, 64); break;
+            case 'b': sw.settings.num_bars = atoi(optarg); break;
+            case 'c': sw.settings.curve = atoi(optarg); break;
+            case 'p': ok = read_pots(optarg, &sw.settings); break;
+            case 'C': sw.cycles = atof(optarg); break;
+            case 't': max_seconds = atof(optarg); break;
+            case 'o': out_path = optarg; break;
+            case 'T': threads = atoi(optarg); break;
+            case 'q': sw.quiet = 1; break;
+            case 'L': snprintf(sw.lib_path, sizeof(sw.lib_path), "%s", optarg); break;
+            default: ok = 0; break;
+        }
+    }
+    if(!ok || optind != argc) {
+        fprintf(stderr, "usage: timing_sweep [-r bpms] [-e periods_ms] [-s steps] [-n trigs] "
+            "[-b bars] [-c curve] [-p a,b,c,d] [-C cycles] [-t seconds] [-o map] "
+            "[-T threads] [-q] [-L library]\n");
+        return 1;
+    }
+    if(sw.settings.num_bars < 1 || sw.settings.num_bars > 8 || sw.settings.curve < 0 ||
+        sw.settings.curve > 3 || sw.cycles <= 0 || max_seconds <= 0 ||
+        threads < 1 || threads > 256)
+    {
+        fprintf(stderr, "timing_sweep: bad setting\n");
+        return 1;
+    }
+    sw.max_us = (long long)(max_seconds * 1e6);
+    if(!sw.lib_path[0]) {
+        fw_lib_default_path(sw.lib_path, sizeof(sw.lib_path));
+    }
+
+    int max_points = (num_bpms + num_periods) * num_steps * num_trigs;
+    sw.points = calloc(max_points ? max_points : 1, sizeof(POINT));
+    sw.results = calloc(max_points ? max_points : 1, sizeof(RESULT));
+    add_points(0, bpms, num_bpms, steps, num_steps, trigs, num_trigs);
+    add_points(1, periods, num_periods, steps, num_steps, trigs, num_trigs);
+    pthread_mutex_init(&sw.lock, NULL);
+
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    POOL *pool = pool_create(threads);
+    pool_run(pool, sw.num_points, run_point, NULL);
+    pool_destroy(pool);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double secs = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) * 1e-9;
+
+    FILE *out = out_path ? fopen(out_path, "w") : stdout;
+    if(!out) {
+        perror(out_path);
+        return 1;
+    }
+    fprintf(out, "clock,rate,steps,trigs,cycles,fired,dropped,coalesced,late_min_us,"
+        "late_mean_us,late_max_us,out_late_max_us,queue_max,out_load\n");
+    int dropping = 0, coalescing = 0, saturated = 0;
+    long long worst_late = 0;
+    for(int i=0; i<sw.num_points; ++i) {
+        const POINT *p = &sw.points[i];
+        const RESULT *r = &sw.results[i];
+        fprintf(out, "%s,%d,%d,%d,%lld,%lld,%lld,%lld,%lld,%.0f,%lld,%lld,%d,%.3f\n",
+            p->external ? "ext" : "int", p->rate, p->steps, p->trigs, r->cycles, r->fired,
+            r->dropped, r->coalesced, r->late_min,
+            r->late_count ? r->late_total / r->late_count : 0.0, r->late_max,
+            r->out_late_max, r->queue_max, r->out_load);
+        dropping += r->dropped > 0;
+        coalescing += r->coalesced > 0;
+        saturated += r->out_load > 1;
+        if(r->late_max > worst_late) {
+            worst_late = r->late_max;
+        }
+    }
+    if(out != stdout && fclose(out)) {
+        perror(out_path);
+        return 1;
+    }
+    if(!sw.quiet) {
+        fprintf(stderr, "\n");
+    }
+    fprintf(stderr, "%d points in %.2fs on %d threads, %.0f points/s\n"
+        "%d drop trigs, %d coalesce, %d saturate the output, latest trig %lldus\n",
+        sw.num_points, secs, threads, sw.num_points / secs, dropping, coalescing,
+        saturated, worst_late);
+    for(int i=0; i<sw.num_fws; ++i) {
+        fw_lib_unload(&sw.fws[i]->lib);
+        free(sw.fws[i]);
+    }
+    return 0;
+}
@@ -0,0 +1,407 @@
+/*
+ Renders the trig output of the d-ticker firmware for a batch of settings
+ by running it on the host, so curves and settings can be tried out
+ without a module. The trigs are written as CSV or the gate as a WAV file.
+
+    make -C host trig_render
+    trig_render [options] [settings file]
+
+ Each line of the settings file is a render, with any of
+    bpm=n steps=n bars=n trigs=n mode=n curve=n pots=a,b,c,d
+    clock=file resets=file
+ in place of those from the options. Without a file there is one render,
+ of the options.
+
+ Options:
+    -t seconds  length of each render (default 8)
+    -r -s -b -n -m -c -p
+                bpm, steps, bars, trigs, reset mode, curve and pots, as for
+                ticker_sim
+    -e file     external clock edges, a time in us per line
+    -x file     reset input, <time in us> 0|1 per line
+    -o file     the trigs as CSV (default stdout), a line per trig of
+                    <render>,<trig>,<time in us>,<gate length in us>
+                with a gate length of -1 if it is still open at the end
+    -w file     the gate as a 16 bit mono WAV instead, with a %d in the
+                name for the render number when there is more than one
+    -R rate     sample rate of the WAV (default 48000)
+    -q          no output, just the time taken on stderr
+    -L file     firmware library (default ticker_fw.so beside trig_render)
+
+ Renders are numbered from 0 in the order of the settings file. Each one
+ starts from the firmware's power on state (see fw_lib.h), with the idle
+ ticks fast forwarded.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <limits.h>
+#include "fw_lib.h"
+
+// the inputs in a file, read once
+typedef struct {
+    char *path;
+    long long *times;
+    int *values;
+    int count;
+} INPUT_FILE;
+
+typedef struct {
+    FW_SETTINGS settings;
+    const INPUT_FILE *clock;
+    const INPUT_FILE *resets;
+} RENDER;
+
+typedef struct {
+    const RENDER *render;
+    int next_clock;
+    int next_reset;
+} INPUTS;
+
+typedef struct {
+    long long *times;           // edges of the trig output, rising first
+    int count;
+    int size;
+} GATE;
+
+static INPUT_FILE **files;
+static int num_files;
+
+////////////////////////////////////////////////////////////////////////////////
+static void *grow(void *p, int *size, int need, size_t item) {
+    if(need <= *size) {
+        return p;
+    }
+    int size2 = *size ? *size : 64;
+    while(size2 < need) {
+        size2 *= 2;
+    }
+    p = realloc(p, size2 * item);
+    if(!p) {
+        fprintf(stderr, "trig_render: out of memory\n");
+        exit(1);
+    }
+    *size = size2;
+    return p;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Reads a file of clock edges (a time each) or of reset levels (a time
+// and 0 or 1 each)
+static const INPUT_FILE *read_inputs(const char *path, int levels) {
+    for(int i=0; i<num_files; ++i) {
+        if(!strcmp(files[i]->path, path)) {
+            return files[i];
+        }
+    }
+    FILE *f = fopen(path, "r");
+    if(!f) {
+        perror(path);
+        exit(1);
+    }
+    INPUT_FILE *in = calloc(1, sizeof(INPUT_FILE));
+    files = realloc(files, (num_files + 1) * sizeof(INPUT_FILE *));
+    files[num_files++] = in;
+    in->path = strdup(path);
+    int size = 0;
+    int values_size = 0;
+    char line[256];
+    int line_no = 0;
+    while(fgets(line, sizeof(line), f)) {
+        ++line_no;
+        long long time_us;
+        int value = 0;
+        if(line[0] == '#' || line[strspn(line, " \t\r\n")] == 0) {
+            continue;
+        }
+        if(sscanf(line, "%lld %d", &time_us, &value) < 1 + levels ||
+            (in->count && time_us < in->times[in->count - 1])) {
+            fprintf(stderr, "%s:%d: bad input\n", path, line_no);
+            exit(1);
+        }
+        in->times = grow(in->times, &size, in->count + 1, sizeof(long long));
+        in->values = grow(in->values, &values_size, in->count + 1, sizeof(int));
+        in->times[in->count] = time_us;
+        in->values[in->count] = value;
+        ++in->count;
+    }
+    fclose(f);
+    return in;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static int next_input(void *ctx, SIM_INPUT *input) {
+    INPUTS *in = ctx;
+    const INPUT_FILE *clock = in->render->clock;
+    const INPUT_FILE *resets = in->render->resets;
+    int have_clock = clock && in->next_clock < clock->count;
+    int have_reset = resets && in->next_reset < resets->count;
+    if(have_reset && (!have_clock || resets->times[in->next_reset] <= clock->times[in->next_clock])) {
+        input->time_us = resets->times[in->next_reset];
+        input->type = SIM_IN_RESET;
+        input->which = 0;
+        input->value = resets->values[in->next_reset++];
+        return 1;
+    }
+    if(have_clock) {
+        input->time_us = clock->times[in->next_clock++];
+        input->type = SIM_IN_CLOCK;
+        input->which = 0;
+        input->value = 0;
+        return 1;
+    }
+    return 0;
+}
+
+static void gate_event(void *ctx, long long time_us, const char *name, int data) {
+    GATE *gate = ctx;
+    if(!strcmp(name, "out")) {
+        // the output is low at power on, so the edges go rising, falling...
+        gate->times = grow(gate->times, &gate->size, gate->count + 1, sizeof(long long));
+        gate->times[gate->count++] = time_us;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static void render(FW_LIB *lib, const RENDER *r, long long end_ms, GATE *gate) {
+    INPUTS in = { r, 0, 0 };
+    SIM sim;
+    memset(&sim, 0, sizeof(sim));
+    sim.source = next_input;
+    sim.source_ctx = &in;
+    sim.sink = gate_event;
+    sim.sink_ctx = gate;
+    sim.fast = 1;
+    sim.log_pins = 1;
+    gate->count = 0;
+    fw_lib_restore(lib);
+    lib->sim_start(&sim, &r->settings);
+    lib->sim_run(&sim, end_ms);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static void write_csv(FILE *out, int number, const GATE *gate) {
+    for(int i=0; i<gate->count; i += 2) {
+        fprintf(out, "%d,%d,%lld,%lld\n", number, i / 2, gate->times[i],
+            (i + 1 < gate->count) ? gate->times[i + 1] - gate->times[i] : -1LL);
+    }
+}
+
+static void put_le(FILE *out, unsigned long value, int bytes) {
+    for(int i=0; i<bytes; ++i) {
+        fputc((int)((value >> (8 * i)) & 0xFF), out);
+    }
+}
+
+static void write_wav(const char *path, long rate, long long end_ms, const GATE *gate) {
+    FILE *out = fopen(path, "wb");
+    if(!out) {
+        perror(path);
+        exit(1);
+    }
+    unsigned long samples = (unsigned long)(end_ms * rate / 1000);
+    fputs("RIFF", out);
+    put_le(out, 36 + 2 * samples, 4);
+    fputs("WAVEfmt ", out);
+    put_le(out, 16, 4);
+    put_le(out, 1, 2);          // PCM
+    put_le(out, 1, 2);          // mono
+    put_le(out, rate, 4);
+    put_le(out, 2 * rate, 4);
+    put_le(out, 2, 2);
+    put_le(out, 16, 2);
+    fputs("data", out);
+    put_le(out, 2 * samples, 4);
+    int edge = 0;
+    for(unsigned long i=0; i<samples; ++i) {
+        long long time_us = (long long)i * 1000000 / rate;
+        while(edge < gate->count && gate->times[edge] <= time_us) {
+            ++edge;
+        }
+        put_le(out, (edge & 1) ? 32767 : 0, 2);
+    }
+    if(fclose(out)) {
+        perror(path);
+        exit(1);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static int read_pots(const char *text, FW_SETTINGS *settings) {
+    int p[4];
+    if(sscanf(text, "%d,%d,%d,%d", &p[0], &p[1], &p[2], &p[3]) != 4) {
+        return 0;
+    }
+    for(int i=0; i<4; ++i) {
+        settings->pots[i] = (unsigned char)p[i];
+    }
+    return 1;
+}
+
+static int render_setting(RENDER *r, const char *key, const char *value) {
+    FW_SETTINGS *s = &r->settings;
+    if(!strcmp(key, "steps")) s->num_steps = atoi(value);
+    else if(!strcmp(key, "bars")) s->num_bars = atoi(value);
+    else if(!strcmp(key, "trigs")) s->num_trigs = atoi(value);
+    else if(!strcmp(key, "mode")) s->reset_mode = atoi(value);
+    else if(!strcmp(key, "curve")) s->curve = atoi(value);
+    else if(!strcmp(key, "bpm")) s->bpm = atoi(value);
+    else if(!strcmp(key, "pots")) return read_pots(value, s);
+    else if(!strcmp(key, "clock")) r->clock = read_inputs(value, 0);
+    else if(!strcmp(key, "resets")) r->resets = read_inputs(value, 1);
+    else return 0;
+    return 1;
+}
+
+static int bad_settings(const FW_SETTINGS *s) {
+    return s->num_trigs < 1 || s->num_trigs > 64 ||
+        s->reset_mode < 0 || s->reset_mode > 3 ||
+        s->curve < 0 || s->curve > 3;
+}
+
+static int read_renders(const char *path, const RENDER *defaults, RENDER **renders) {
+    FILE *f = fopen(path, "r");
+    if(!f) {
+        perror(path);
+        exit(1);
+    }
+    char line[512];
+    int count = 0;
+    int size = 0;
+    int line_no = 0;
+    while(fgets(line, sizeof(line), f)) {
+        ++line_no;
+        char *tok = strtok(line, " \t\r\n");
+        if(!tok || tok[0] == '#') {
+            continue;
+        }
+        *renders = grow(*renders, &size, count + 1, sizeof(RENDER));
+        RENDER *r = &(*renders)[count++];
+        *r = *defaults;
+        for(; tok; tok = strtok(NULL, " \t\r\n")) {
+            char *eq = strchr(tok, '=');
+            if(eq) {
+                *eq = 0;
+            }
+            if(!eq || !render_setting(r, tok, eq + 1)) {
+                fprintf(stderr, "%s:%d: bad setting %s\n", path, line_no, tok);
+                exit(1);
+            }
+        }
+        if(bad_settings(&r->settings)) {
+            fprintf(stderr, "%s:%d: bad setting\n", path, line_no);
+            exit(1);
+        }
+    }
+    fclose(f);
+    return count;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+int main(int argc, char *argv[]) {
+    RENDER defaults;
+    memset(&defaults, 0, sizeof(defaults));
+    FW_SETTINGS settings = {
+        120, 16, 1, 16, 0, 0, { 128, 128, 128, 128 }
+    };
+    defaults.settings = settings;
+    const char *csv_path = NULL;
+    const char *wav_path = NULL;
+    char lib_path[PATH_MAX] = "";
+    double seconds = 8;
+    long rate = 48000;
+    int quiet = 0;
+    int opt;
+    while((opt = getopt(argc, argv, "t:r:s:b:n:m:c:p:e:x:o:w:R:qL:")) != -1) {
+        switch(opt) {
+            case 't': seconds = atof(optarg); break;
+            case 'r': defaults.settings.bpm = atoi(optarg); break;
+            case 's': defaults.settings.num_steps = atoi(optarg); break;
+            case 'b': defaults.settings.num_bars = atoi(optarg); break;
+            case 'n': defaults.settings.num_trigs = atoi(optarg); break;
+            case 'm': defaults.settings.reset_mode = atoi(optarg); break;
+            case 'c': defaults.settings.curve = atoi(optarg); break;
+            case 'p':
+                if(!read_pots(optarg, &defaults.settings)) {
+                    fprintf(stderr, "trig_render: -p needs 4 readings\n");
+                    return 1;
+                }
+                break;
+            case 'e': defaults.clock = read_inputs(optarg, 0); break;
+            case 'x': defaults.resets = read_inputs(optarg, 1); break;
+            case 'o': csv_path = optarg; break;
+            case 'w': wav_path = optarg; break;
+            case 'R': rate = atol(optarg); break;
+            case 'q': quiet = 1; break;
+            case 'L': snprintf(lib_path, sizeof(lib_path), "%s", optarg); break;
+            default:
+                fprintf(stderr, "usage: trig_render [-t seconds] [-r bpm] [-s steps] "
+                    "[-b bars] [-n trigs] [-m mode] [-c curve] [-p a,b,c,d] "
+                    "[-e clock_file] [-x reset_file] [-o csv | -w wav] [-R rate] "
+                    "[-q] [-L library] [settings file]\n");
+                return 1;
+        }
+    }
+    if(bad_settings(&defaults.settings) || rate < 1 || seconds < 0 ||
+        optind < argc - 1 || (csv_path && wav_path)) {
+        fprintf(stderr, "trig_render: bad setting\n");
+        return 1;
+    }
+    RENDER *renders = &defaults;
+    int num_renders = 1;
+    if(optind < argc) {
+        renders = NULL;
+        num_renders = read_renders(argv[optind], &defaults, &renders);
+    }
+    if(wav_path && num_renders > 1 && !strstr(wav_path, "%d")) {
+        fprintf(stderr, "trig_render: -w needs a %%d for more than one render\n");
+        return 1;
+    }
+    FILE *csv = NULL;
+    if(!quiet && !wav_path) {
+        csv = csv_path ? fopen(csv_path, "w") : stdout;
+        if(!csv) {
+            perror(csv_path);
+            return 1;
+        }
+        fprintf(csv, "render,trig,time_us,gate_us\n");
+    }
+    if(!lib_path[0]) {
+        fw_lib_default_path(lib_path, sizeof(lib_path));
+    }
+    FW_LIB lib;
+    fw_lib_load(&lib, lib_path);
+    long long end_ms = (long long)(seconds * 1000);
+
+    GATE gate;
+    memset(&gate, 0, sizeof(gate));
+    unsigned long long trigs = 0;
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for(int i=0; i<num_renders; ++i) {
+        render(&lib, &renders[i], end_ms, &gate);
+        trigs += (gate.count + 1) / 2;
+        if(csv) {
+            write_csv(csv, i, &gate);
+        }
+        else if(wav_path && !quiet) {
+            char path[PATH_MAX];
+            snprintf(path, sizeof(path), wav_path, i);
+            write_wav(path, rate, end_ms, &gate);
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    if(csv && csv != stdout && fclose(csv)) {
+        perror(csv_path);
+        return 1;
+    }
+    if(quiet) {
+        double secs = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) * 1e-9;
+        fprintf(stderr, "%d renders, %llu trigs, %.3fs, %.0f renders/s\n",
+            num_renders, trigs, secs, num_renders / secs);
+    }
+    fw_lib_unload(&lib);
+    return 0;
+}
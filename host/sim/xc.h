@@ -0,0 +1,94 @@
+/*
+ Stand-in for the XC8 <xc.h> when the firmware is built into the host 
+ simulator. The special function registers the firmware uses are plain
+ variables, defined by fw.c, with the bit fields laid over the byte 
+ registers as on the PIC. fw.c looks at and sets them to model the 
+ peripherals.
+ */
+#ifndef SIM_XC_H
+#define SIM_XC_H
+#include <stdint.h>
+#include <stdlib.h>
+
+#define __interrupt(...)
+#define __near
+#define __bank(x)
+#define di()
+#define ei()
+#define NOP()
+typedef uint32_t __uint24;      // only the low 24 bits are used
+
+#define SIM_BITS(reg, ...) \
+    typedef struct { unsigned char __VA_ARGS__; } reg##bits_t; \
+    extern volatile unsigned char reg;
+#define SIM_REG(reg) \
+    extern volatile unsigned char reg;
+
+SIM_BITS(PORTA, RA0:1, RA1:1, RA2:1, RA3:1, RA4:1, RA5:1)
+SIM_BITS(LATA, LATA0:1, LATA1:1, LATA2:1, LATA3:1, LATA4:1, LATA5:1)
+SIM_BITS(LATC, LATC0:1, LATC1:1, LATC2:1, LATC3:1, LATC4:1, LATC5:1)
+SIM_BITS(TRISA, TRISA0:1, TRISA1:1, TRISA2:1, TRISA3:1, TRISA4:1, TRISA5:1)
+SIM_BITS(TRISC, TRISC0:1, TRISC1:1, TRISC2:1, TRISC3:1, TRISC4:1, TRISC5:1)
+SIM_BITS(INTCON, IOCIF:1, INTF:1, T0IF:1, IOCIE:1, INTE:1, T0IE:1, PEIE:1, GIE:1)
+SIM_BITS(PIR1, TMR1IF:1, TMR2IF:1, CCP1IF:1, SSP1IF:1, TXIF:1, RCIF:1, ADIF:1, TMR1GIF:1)
+SIM_BITS(PIE1, TMR1IE:1, TMR2IE:1, CCP1IE:1, SSP1IE:1, TXIE:1, RCIE:1, ADIE:1, TMR1GIE:1)
+SIM_BITS(PIR2, CCP2IF:1, pad0:2, BCL1IF:1, EEIF:1, C1IF:1, C2IF:1, OSFIF:1)
+SIM_BITS(PIE2, CCP2IE:1, pad0:2, BCL1IE:1, EEIE:1, C1IE:1, C2IE:1, OSFIE:1)
+SIM_BITS(IOCAF, IOCAF0:1, IOCAF1:1, IOCAF2:1, IOCAF3:1, IOCAF4:1, IOCAF5:1)
+SIM_BITS(OPTION_REG, PS:3, PSA:1, TMR0SE:1, TMR0CS:1, INTEDG:1, nWPUEN:1)
+SIM_BITS(ADCON0, ADON:1, GO_nDONE:1, CHS:5)
+SIM_BITS(TXSTA, TX9D:1, TRMT:1, BRGH:1, SENDB:1, SYNC:1, TXEN:1, TX9:1, CSRC:1)
+SIM_BITS(RCSTA, RX9D:1, OERR:1, FERR:1, ADDEN:1, CREN:1, SREN:1, RX9:1, SPEN:1)
+SIM_BITS(BAUDCON, ABDEN:1, WUE:1, pad0:1, BRG16:1, SCKP:1, pad1:1, RCIDL:1, ABDOVF:1)
+SIM_BITS(EECON1, RD:1, WR:1, WREN:1, WRERR:1, FREE:1, LWLO:1, CFGS:1, EEPGD:1)
+
+// the bit fields share the byte register's storage
+#define PORTAbits       (*(volatile PORTAbits_t *)&PORTA)
+#define LATAbits        (*(volatile LATAbits_t *)&LATA)
+#define LATCbits        (*(volatile LATCbits_t *)&LATC)
+#define TRISAbits       (*(volatile TRISAbits_t *)&TRISA)
+#define TRISCbits       (*(volatile TRISCbits_t *)&TRISC)
+#define INTCONbits      (*(volatile INTCONbits_t *)&INTCON)
+#define PIR1bits        (*(volatile PIR1bits_t *)&PIR1)
+#define PIE1bits        (*(volatile PIE1bits_t *)&PIE1)
+#define PIR2bits        (*(volatile PIR2bits_t *)&PIR2)
+#define PIE2bits        (*(volatile PIE2bits_t *)&PIE2)
+#define IOCAFbits       (*(volatile IOCAFbits_t *)&IOCAF)
+#define OPTION_REGbits  (*(volatile OPTION_REGbits_t *)&OPTION_REG)
+#define ADCON0bits      (*(volatile ADCON0bits_t *)&ADCON0)
+#define TXSTAbits       (*(volatile TXSTAbits_t *)&TXSTA)
+#define RCSTAbits       (*(volatile RCSTAbits_t *)&RCSTA)
+#define BAUDCONbits     (*(volatile BAUDCONbits_t *)&BAUDCON)
+#define EECON1bits      (*(volatile EECON1bits_t *)&EECON1)
+
+SIM_REG(PORTC)
+SIM_REG(OSCCON)
+SIM_REG(ANSELA)
+SIM_REG(ANSELC)
+SIM_REG(WPUA)
+SIM_REG(WPUC)
+SIM_REG(IOCAN)
+SIM_REG(IOCAP)
+SIM_REG(ADCON1)
+SIM_REG(ADRESH)
+SIM_REG(TMR0)
+SIM_REG(T1CON)
+SIM_REG(TMR1L)
+SIM_REG(TMR1H)
+SIM_REG(TXREG)
+SIM_REG(RCREG)
+SIM_REG(SPBRG)
+SIM_REG(SPBRGH)
+SIM_REG(EEADRL)
+SIM_REG(EEADRH)
+SIM_REG(EECON2)
+SIM_REG(EEDATH)
+
+// timer 1 is stopped, the simulator does not model run time
+#define TMR1            ((unsigned int)(TMR1L | (TMR1H << 8)))
+
+// reading EEDATL after setting RD fetches the EEPROM byte
+extern volatile unsigned char *sim_eedatl(void);
+#define EEDATL          (*sim_eedatl())
+
+#endif
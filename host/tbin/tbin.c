@@ -0,0 +1,437 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "tbin.h"
+
+#define MAGIC           "DTKTBIN1"
+#define INDEX_MAGIC     "DTKTBIX1"
+#define BLOCK_HEADER    24
+#define FOOTER          24
+#define MAX_VARINT      10
+
+struct TBIN_WRITER {
+    FILE *f;
+    const char *path;
+    unsigned long long offset;
+    unsigned long long events;
+    int failed;
+    int num_types;
+    char *type_names[TBIN_MAX_TYPES];
+    int last_type;
+    // the block being filled
+    int count;
+    long long first_time;
+    long long last_time;
+    long long max_time;
+    unsigned char *time_col;
+    unsigned char *type_col;
+    unsigned char *channel_col;
+    unsigned char *data_col;
+    size_t time_len;
+    size_t channel_len;
+    size_t data_len;
+    TBIN_INDEX *index;
+    int num_blocks;
+    int max_blocks;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+static size_t put_varint(unsigned char *p, unsigned long long value) {
+    size_t n = 0;
+    while(value >= 0x80) {
+        p[n++] = (unsigned char)(value | 0x80);
+        value >>= 7;
+    }
+    p[n++] = (unsigned char)value;
+    return n;
+}
+
+static unsigned long long zigzag(long long value) {
+    return ((unsigned long long)value << 1) ^ (unsigned long long)(value >> 63);
+}
+
+static long long unzigzag(unsigned long long value) {
+    return (long long)(value >> 1) ^ -(long long)(value & 1);
+}
+
+static void put_le(unsigned char *p, unsigned long long value, int bytes) {
+    for(int i=0; i<bytes; ++i) {
+        p[i] = (unsigned char)(value >> (8 * i));
+    }
+}
+
+static unsigned long long get_le(const unsigned char *p, int bytes) {
+    unsigned long long value = 0;
+    for(int i=0; i<bytes; ++i) {
+        value |= (unsigned long long)p[i] << (8 * i);
+    }
+    return value;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static int put(TBIN_WRITER *w, const void *data, size_t len) {
+    if(fwrite(data, 1, len, w->f) != len) {
+        return 0;
+    }
+    w->offset += len;
+    return 1;
+}
+
+TBIN_WRITER *tbin_create(const char *path) {
+    TBIN_WRITER *w = calloc(1, sizeof(TBIN_WRITER));
+    if(!w) {
+        fprintf(stderr, "%s: out of memory\n", path);
+        return NULL;
+    }
+    w->path = path;
+    w->time_col = malloc(TBIN_BLOCK_EVENTS * MAX_VARINT);
+    w->type_col = malloc(TBIN_BLOCK_EVENTS);
+    w->channel_col = malloc(TBIN_BLOCK_EVENTS * 5);
+    w->data_col = malloc(TBIN_BLOCK_EVENTS * 5);
+    w->f = fopen(path, "wb");
+    if(!w->f || !w->time_col || !w->type_col || !w->channel_col || !w->data_col ||
+        !put(w, MAGIC, 8)) {
+        perror(path);
+        if(w->f) {
+            fclose(w->f);
+        }
+        free(w->time_col);
+        free(w->type_col);
+        free(w->channel_col);
+        free(w->data_col);
+        free(w);
+        return NULL;
+    }
+    return w;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+int tbin_type(TBIN_WRITER *w, const char *name) {
+    if(w->num_types && !strcmp(w->type_names[w->last_type], name)) {
+        return w->last_type;
+    }
+    for(int i=0; i<w->num_types; ++i) {
+        if(!strcmp(w->type_names[i], name)) {
+            return w->last_type = i;
+        }
+    }
+    if(w->num_types == TBIN_MAX_TYPES) {
+        return -1;
+    }
+    w->type_names[w->num_types] = strndup(name, 255);
+    return w->last_type = w->num_types++;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static int flush_block(TBIN_WRITER *w) {
+    if(!w->count) {
+        return 1;
+    }
+    if(w->num_blocks == w->max_blocks) {
+        w->max_blocks = w->max_blocks ? 2 * w->max_blocks : 64;
+        w->index = realloc(w->index, w->max_blocks * sizeof(TBIN_INDEX));
+        if(!w->index) {
+            return 0;
+        }
+    }
+    TBIN_INDEX *ix = &w->index[w->num_blocks++];
+    ix->first_time = w->first_time;
+    ix->max_time = w->max_time;
+    ix->offset = w->offset;
+    ix->first = w->events - w->count;
+
+    unsigned char header[BLOCK_HEADER];
+    put_le(header, w->count, 4);
+    put_le(header + 4, w->time_len, 4);
+    put_le(header + 8, w->channel_len, 4);
+    put_le(header + 12, w->data_len, 4);
+    put_le(header + 16, (unsigned long long)w->first_time, 8);
+    int ok = put(w, header, sizeof(header)) &&
+        put(w, w->time_col, w->time_len) &&
+        put(w, w->type_col, w->count) &&
+        put(w, w->channel_col, w->channel_len) &&
+        put(w, w->data_col, w->data_len);
+    w->count = 0;
+    w->time_len = w->channel_len = w->data_len = 0;
+    return ok;
+}
+
+void tbin_write(TBIN_WRITER *w, long long time_us, int type, unsigned channel, int data) {
+    if(!w->count) {
+        w->first_time = time_us;
+        w->last_time = time_us;
+    }
+    if(!w->events || time_us > w->max_time) {
+        w->max_time = time_us;
+    }
+    w->time_len += put_varint(w->time_col + w->time_len, zigzag(time_us - w->last_time));
+    w->last_time = time_us;
+    w->type_col[w->count] = (unsigned char)type;
+    w->channel_len += put_varint(w->channel_col + w->channel_len, channel);
+    w->data_len += put_varint(w->data_col + w->data_len, zigzag(data));
+    ++w->events;
+    if(++w->count == TBIN_BLOCK_EVENTS && !flush_block(w)) {
+        // reported by tbin_finish()
+        w->failed = 1;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+int tbin_finish(TBIN_WRITER *w) {
+    int ok = !w->failed && flush_block(w);
+    static const unsigned char zeros[8];
+    if(ok && (w->offset & 7)) {
+        ok = put(w, zeros, 8 - (w->offset & 7));
+    }
+    unsigned long long index_offset = w->offset;
+    for(int i=0; ok && i<w->num_blocks; ++i) {
+        unsigned char entry[sizeof(TBIN_INDEX)];
+        put_le(entry, (unsigned long long)w->index[i].first_time, 8);
+        put_le(entry + 8, (unsigned long long)w->index[i].max_time, 8);
+        put_le(entry + 16, w->index[i].offset, 8);
+        put_le(entry + 24, w->index[i].first, 8);
+        ok = put(w, entry, sizeof(entry));
+    }
+    for(int i=0; ok && i<w->num_types; ++i) {
+        unsigned char len = (unsigned char)strlen(w->type_names[i]);
+        ok = put(w, &len, 1) && put(w, w->type_names[i], len);
+    }
+    unsigned char footer[FOOTER];
+    put_le(footer, index_offset, 8);
+    put_le(footer + 8, w->num_blocks, 4);
+    put_le(footer + 12, w->num_types, 4);
+    memcpy(footer + 16, INDEX_MAGIC, 8);
+    ok = ok && put(w, footer, sizeof(footer)) && !ferror(w->f);
+    if(fclose(w->f)) {
+        ok = 0;
+    }
+    if(!ok) {
+        perror(w->path);
+    }
+    for(int i=0; i<w->num_types; ++i) {
+        free(w->type_names[i]);
+    }
+    free(w->time_col);
+    free(w->type_col);
+    free(w->channel_col);
+    free(w->data_col);
+    free(w->index);
+    free(w);
+    return ok;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static int bad_file(TBIN_READER *r, const char *path) {
+    fprintf(stderr, "%s: not a good binary trace\n", path);
+    tbin_close(r);
+    return 0;
+}
+
+int tbin_open(TBIN_READER *r, const char *path) {
+    memset(r, 0, sizeof(*r));
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if(fd < 0 || fstat(fd, &st)) {
+        perror(path);
+        if(fd >= 0) {
+            close(fd);
+        }
+        return 0;
+    }
+    r->len = st.st_size;
+    if(r->len < 8 + FOOTER) {
+        close(fd);
+        return bad_file(r, path);
+    }
+    void *map = mmap(NULL, r->len, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(map == MAP_FAILED) {
+        perror(path);
+        return 0;
+    }
+    r->map = map;
+    madvise(map, r->len, MADV_SEQUENTIAL);
+    const unsigned char *footer = r->map + r->len - FOOTER;
+    unsigned long long index_offset = get_le(footer, 8);
+    r->num_blocks = (int)get_le(footer + 8, 4);
+    r->num_types = (int)get_le(footer + 12, 4);
+    if(memcmp(r->map, MAGIC, 8) || memcmp(footer + 16, INDEX_MAGIC, 8) ||
+        (index_offset & 7) || r->num_types > TBIN_MAX_TYPES ||
+        index_offset + (unsigned long long)r->num_blocks * sizeof(TBIN_INDEX) > r->len - FOOTER) {
+        return bad_file(r, path);
+    }
+    // the index is used where it is, which needs a little endian host
+    r->index = (const TBIN_INDEX *)(r->map + index_offset);
+    const unsigned char *p = r->map + index_offset + r->num_blocks * sizeof(TBIN_INDEX);
+    r->names = malloc(footer - p + r->num_types);
+    char *name = r->names;
+    for(int i=0; i<r->num_types; ++i) {
+        if(p >= footer || p + 1 + *p > footer) {
+            return bad_file(r, path);
+        }
+        memcpy(name, p + 1, *p);
+        name[*p] = 0;
+        r->type_names[i] = name;
+        name += *p + 1;
+        p += 1 + *p;
+    }
+    // tbin_read_block() goes straight to a block's header, so every one 
+    // must be before the index
+    for(int i=0; i<r->num_blocks; ++i) {
+        unsigned long long offset = r->index[i].offset;
+        if(offset > index_offset || index_offset - offset < BLOCK_HEADER) {
+            return bad_file(r, path);
+        }
+    }
+    if(r->num_blocks) {
+        const TBIN_INDEX *last = &r->index[r->num_blocks - 1];
+        r->num_events = last->first + get_le(r->map + last->offset, 4);
+    }
+    return 1;
+}
+
+void tbin_close(TBIN_READER *r) {
+    if(r->map) {
+        munmap((void *)r->map, r->len);
+    }
+    free(r->names);
+    memset(r, 0, sizeof(*r));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+int tbin_find_type(const TBIN_READER *r, const char *name) {
+    for(int i=0; i<r->num_types; ++i) {
+        if(!strcmp(r->type_names[i], name)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int tbin_find_block(const TBIN_READER *r, long long time_us) {
+    int lo = 0;
+    int hi = r->num_blocks;
+    while(lo < hi) {
+        int mid = (lo + hi) / 2;
+        if(r->index[mid].max_time < time_us) {
+            lo = mid + 1;
+        }
+        else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Decodes a column of count varints, returning its end or NULL if they 
+// overrun it. Most are a byte, and while there are MAX_VARINT bytes left
+// no varint can overrun
+static const unsigned char *get_column(const unsigned char *p, const unsigned char *end,
+    unsigned long long *out, int count)
+{
+    int i = 0;
+    for(; i<count && end - p >= MAX_VARINT; ++i) {
+        unsigned long long value = *p++;
+        if(value >= 0x80) {
+            value &= 0x7F;
+            for(int shift = 7; ; shift += 7) {
+                unsigned char b = *p++;
+                value |= (unsigned long long)(b & 0x7F) << shift;
+                if(b < 0x80 || shift == 63) {
+                    break;
+                }
+            }
+        }
+        out[i] = value;
+    }
+    for(; i<count; ++i) {
+        unsigned long long value = 0;
+        for(int shift = 0; ; shift += 7) {
+            if(p == end || shift > 63) {
+                return NULL;
+            }
+            unsigned char b = *p++;
+            value |= (unsigned long long)(b & 0x7F) << shift;
+            if(b < 0x80) {
+                break;
+            }
+        }
+        out[i] = value;
+    }
+    return p;
+}
+
+int tbin_read_block(const TBIN_READER *r, int block, TBIN_EVENTS *events) {
+    if(block < 0 || block >= r->num_blocks) {
+        return 0;
+    }
+    const unsigned char *p = r->map + r->index[block].offset;
+    const unsigned char *end = r->map + r->len - FOOTER;
+    int count = (int)get_le(p, 4);
+    size_t time_len = get_le(p + 4, 4);
+    size_t channel_len = get_le(p + 8, 4);
+    size_t data_len = get_le(p + 12, 4);
+    long long time_us = (long long)get_le(p + 16, 8);
+    p += BLOCK_HEADER;
+    if(count < 0 || count > TBIN_BLOCK_EVENTS ||
+        (size_t)(end - p) < time_len + count + channel_len + data_len) {
+        goto damaged;
+    }
+    if(!events->time_us) {
+        events->time_us = malloc(TBIN_BLOCK_EVENTS * sizeof(long long));
+        events->channel = malloc(TBIN_BLOCK_EVENTS * sizeof(unsigned));
+        events->data = malloc(TBIN_BLOCK_EVENTS * sizeof(int));
+        if(!events->time_us || !events->channel || !events->data) {
+            fprintf(stderr, "binary trace: out of memory\n");
+            exit(1);
+        }
+    }
+    const unsigned char *types = p + time_len;
+    const unsigned char *channels = types + count;
+    const unsigned char *data = channels + channel_len;
+    // the channel and data columns go through the decoded times, which 
+    // are done last
+    unsigned long long *values = (unsigned long long *)events->time_us;
+    if(get_column(channels, data, values, count) != data) {
+        goto damaged;
+    }
+    for(int i=0; i<count; ++i) {
+        events->channel[i] = (unsigned)values[i];
+    }
+    if(get_column(data, data + data_len, values, count) != data + data_len) {
+        goto damaged;
+    }
+    for(int i=0; i<count; ++i) {
+        events->data[i] = (int)unzigzag(values[i]);
+    }
+    if(get_column(p, types, values, count) != types) {
+        goto damaged;
+    }
+    for(int i=0; i<count; ++i) {
+        time_us += unzigzag(values[i]);
+        events->time_us[i] = time_us;
+    }
+    for(int i=0; i<count; ++i) {
+        if(types[i] >= r->num_types) {
+            goto damaged;
+        }
+    }
+    events->count = count;
+    events->type = types;
+    return 1;
+damaged:
+    fprintf(stderr, "binary trace: block %d is damaged\n", block);
+    return 0;
+}
+
+void tbin_free_events(TBIN_EVENTS *events) {
+    free(events->time_us);
+    free(events->channel);
+    free(events->data);
+    memset(events, 0, sizeof(*events));
+}
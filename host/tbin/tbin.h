@@ -0,0 +1,86 @@
+/*
+ A compact binary file of timed events, for traces too long to keep as
+ text: those of the simulators (sim/) and captures from the module. Each
+ event has a time in us, a type (named in the file), a channel (a module
+ of rack_sim, a pot...) and a data value.
+
+ The events are stored in blocks of up to TBIN_BLOCK_EVENTS, column by
+ column, with times as the change from the event before and every number
+ as a varint, so a typical event takes 4 or 5 bytes. An index at the end
+ gives the time and file offset of each block so a reader can go straight
+ to the block holding a time. The reader maps the file and decodes the
+ columns of a block straight from the mapping.
+
+ Layout (integers little endian):
+    "DTKTBIN1"
+    blocks, each
+        u32 events, u32 bytes of the time, channel and data columns,
+        i64 time of the first event, then the columns:
+            time        zigzag varint of the change from the event before
+            type        a byte each
+            channel     varint
+            data        zigzag varint
+    zero bytes up to a multiple of 8
+    index, a TBIN_INDEX for each block
+    type names, each a byte of length and the name
+    u64 offset of the index, u32 blocks, u32 types, "DTKTBIX1"
+ */
+#ifndef TBIN_H
+#define TBIN_H
+#include <stddef.h>
+
+#define TBIN_BLOCK_EVENTS   65536
+#define TBIN_MAX_TYPES      256
+
+typedef struct {
+    long long first_time;       // of the block's first event
+    long long max_time;         // latest time of this and the blocks before
+    unsigned long long offset;  // of the block in the file
+    unsigned long long first;   // event number of the block's first event
+} TBIN_INDEX;
+
+////////////////////////////////////////////////////////////////////////////////
+typedef struct TBIN_WRITER TBIN_WRITER;
+
+// returns NULL with a message on stderr on failure
+TBIN_WRITER *tbin_create(const char *path);
+// the type number for a name, added if it is new (-1 if there are too many)
+int tbin_type(TBIN_WRITER *w, const char *name);
+void tbin_write(TBIN_WRITER *w, long long time_us, int type, unsigned channel, int data);
+// writes the index and closes the file. Returns 0 with a message on failure
+int tbin_finish(TBIN_WRITER *w);
+
+////////////////////////////////////////////////////////////////////////////////
+typedef struct {
+    const unsigned char *map;
+    size_t len;
+    int num_blocks;
+    const TBIN_INDEX *index;    // in the mapping
+    int num_types;
+    const char *type_names[TBIN_MAX_TYPES];
+    char *names;
+    unsigned long long num_events;
+} TBIN_READER;
+
+// the events of a block. The types are in the mapping, the rest are decoded
+// into arrays kept from one tbin_read_block() to the next
+typedef struct {
+    int count;
+    long long *time_us;
+    const unsigned char *type;
+    unsigned *channel;
+    int *data;
+} TBIN_EVENTS;
+
+// returns 0 with a message on stderr on failure
+int tbin_open(TBIN_READER *r, const char *path);
+void tbin_close(TBIN_READER *r);
+// the type number of a name, -1 if there are no events of it
+int tbin_find_type(const TBIN_READER *r, const char *name);
+// the first block which can hold events at or after a time, or num_blocks
+int tbin_find_block(const TBIN_READER *r, long long time_us);
+// returns 0 with a message if the block is damaged
+int tbin_read_block(const TBIN_READER *r, int block, TBIN_EVENTS *events);
+void tbin_free_events(TBIN_EVENTS *events);
+
+#endif
@@ -0,0 +1,727 @@
+/*
+ Analyses a capture of the event trace sent by a TRACE build (see
+ d-ticker.X/trace.c) and prints a report of the timing:
+
+ - external clock intervals, a histogram of their jitter (the change from
+   one interval to the next) and their drift from an ideal grid
+ - trig lateness. With the external clock, this is against the time each
+   trig would have if the clock kept the interval before it. With the
+   internal clock, it is against a grid at the nominal tempo.
+ - tempo tracking error. With the external clock, this is against the time
+   each trig would have knowing the actual interval of its step. With the
+   internal clock it is the drift of the trigs from the nominal tempo.
+
+    make trace_analyse
+    trace_analyse [options] [capture]
+
+ The capture is the raw bytes from the UART (9600 baud) and may have the
+ text report mixed in.
+ It is read from stdin if no file is given. With -t the input is text
+ instead, one event per line:
+
+    <time in us> clock|reset|trig|pattern|drops|restart|rollover [data]
+
+ so test captures can be written by hand or by a simulator. Blank lines
+ and lines starting with # are skipped.
+
+ Options:
+    -s steps    steps per bar (default 16)
+    -b bars     bars in the pattern (default 1)
+    -n trigs    trigs in the pattern (default 16)
+    -p file     trig positions, one per line as a fraction of the pattern
+                (0 to 1). The default is evenly spaced trigs
+    -r bpm      internal clock BPM (default 120)
+    -P us       nominal external clock period, to report drift against
+    -w us       histogram bucket width (default 100)
+    -t          input is text
+    -B          input is a binary trace (tbin/tbin.h), which must be a file
+    -k channel  with -B, only the events of this channel (a rack_sim module)
+
+ Memory use does not depend on the length of the capture, so multi-hour
+ captures can be streamed straight in. The 16 bit ms timestamps of the
+ frames are unwrapped on the assumption there are never 32 seconds without
+ an event. Black box dumps in the capture are skipped.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <math.h>
+#include "tbin/tbin.h"
+
+// keep in step with d-ticker.h and uart_debug.c
+enum {
+    TRACE_CLOCK,
+    TRACE_RESET,
+    TRACE_TRIG,
+    TRACE_PATTERN,
+    TRACE_DROPS,
+    TRACE_RESTART,
+    TRACE_ROLLOVER,
+    TRACE_DUMP,
+    TRACE_TYPES
+};
+static const char *type_name[TRACE_TYPES] = {
+    "clock", "reset", "trig", "pattern", "drops", "restart", "rollover", "dump"
+};
+#define FRAME_SYNC      0xA5
+#define FRAME_SIZE      7
+#define US_PER_SUB_MS   4.0         // timer 0 count within the ms
+#define MAX_TRIGS       64
+#define MAX_EXT_PERIOD  3000000.0   // longer gaps are a stopped clock (us)
+#define REORDER_US      4000.0      // how far out of order events can be
+#define REORDER_SIZE    64
+#define HIST_BUCKETS    16
+#define EARLY_STEPS     0.25        // how early a trig can fire in its step
+
+////////////////////////////////////////////////////////////////////////////////
+// running mean, standard deviation and range
+typedef struct {
+    unsigned long long count;
+    double mean;
+    double m2;
+    double min;
+    double max;
+} STATS;
+
+static void stats_add(STATS *s, double x) {
+    if(!s->count || x < s->min) {
+        s->min = x;
+    }
+    if(!s->count || x > s->max) {
+        s->max = x;
+    }
+    ++s->count;
+    double delta = x - s->mean;
+    s->mean += delta / s->count;
+    s->m2 += delta * (x - s->mean);
+}
+
+static double stats_sd(const STATS *s) {
+    return (s->count > 1) ? sqrt(s->m2 / (s->count - 1)) : 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// histogram of fixed width buckets, counting values off either end
+typedef struct {
+    double lo;
+    double width;
+    unsigned long long bucket[HIST_BUCKETS];
+    unsigned long long under;
+    unsigned long long over;
+} HIST;
+
+static void hist_add(HIST *h, double x) {
+    double b = floor((x - h->lo) / h->width);
+    if(b < 0) {
+        ++h->under;
+    }
+    else if(b >= HIST_BUCKETS) {
+        ++h->over;
+    }
+    else {
+        ++h->bucket[(int)b];
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// least squares fit of a line, slope only
+typedef struct {
+    double n;
+    double mean_x;
+    double mean_y;
+    double cov;
+    double var_x;
+} FIT;
+
+static void fit_add(FIT *f, double x, double y) {
+    f->n += 1;
+    double dx = x - f->mean_x;
+    f->mean_x += dx / f->n;
+    f->mean_y += (y - f->mean_y) / f->n;
+    f->cov += dx * (y - f->mean_y);
+    f->var_x += dx * (x - f->mean_x);
+}
+
+static double fit_slope(const FIT *f) {
+    return (f->var_x > 0) ? f->cov / f->var_x : 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+typedef struct {
+    double time;                // us
+    int type;
+    int data;
+} EVENT;
+
+typedef struct {
+    double time;                // when the trig fired
+    double base;                // time of the edge at the start of its step
+    double frac;                // position within the step
+    int early;                  // fired before the edge starting its step
+} PENDING_TRIG;
+
+static struct {
+    // settings
+    int steps;                  // external clock edges per pattern
+    int num_trigs;
+    double pos[MAX_TRIGS];      // trig positions as fraction of the pattern
+    double bpm;
+    double nominal_period;      // us, 0 if not given
+
+    // input
+    unsigned long long frames;
+    unsigned long long bad_bytes;
+    unsigned long long count[TRACE_TYPES];
+    unsigned long long dropped;
+    unsigned long long bad_lines;
+    int in_dump;
+    int have_ms;
+    long long ms;               // unwrapped ms of the last frame
+    int last_ms16;
+    EVENT reorder[REORDER_SIZE];
+    int reorder_count;
+
+    // external clock
+    double edge[3];             // times of the last 3 edges, newest first
+    int edges_valid;            // how many of them follow on without a gap
+    long long edge_index;       // edges since the first
+    double first_edge;
+    double prev_interval;
+    STATS interval;
+    STATS jitter;
+    HIST jitter_hist;
+    FIT edge_fit;               // edge time against edge number
+    STATS wander;               // offset from the nominal grid
+    int step;                   // step of the pattern since the last edge
+    int step_known;
+    unsigned long long clock_stops;
+
+    // trigs
+    int last_trig;
+    unsigned long long unknown_trigs;
+    unsigned long long resyncs;
+    STATS late;
+    HIST late_hist;
+    STATS track;
+    HIST track_hist;
+    PENDING_TRIG pending[MAX_TRIGS];
+    int num_pending;
+    unsigned long long pending_lost;
+
+    // internal clock grid
+    int anchored;
+    double cycle_start;
+    double cycle_us;
+    long long cycles;
+    FIT drift_fit;              // lateness against time
+    double last_event;
+} an;
+
+////////////////////////////////////////////////////////////////////////////////
+static int is_external() {
+    return an.edges_valid && an.last_event - an.edge[0] <= MAX_EXT_PERIOD;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static void clock_edge(double t) {
+    if(an.edges_valid && t - an.edge[0] > MAX_EXT_PERIOD) {
+        // the clock stopped, start again
+        ++an.clock_stops;
+        an.edges_valid = 0;
+        an.step_known = 0;
+        an.num_pending = 0;
+    }
+    an.edge[2] = an.edge[1];
+    an.edge[1] = an.edge[0];
+    an.edge[0] = t;
+    if(an.edges_valid < 3) {
+        ++an.edges_valid;
+    }
+    if(!an.edge_index) {
+        an.first_edge = t;
+    }
+    fit_add(&an.edge_fit, (double)an.edge_index, t - an.first_edge);
+    if(an.nominal_period > 0) {
+        stats_add(&an.wander,
+            t - an.first_edge - an.edge_index * an.nominal_period);
+    }
+    ++an.edge_index;
+
+    if(an.edges_valid >= 2) {
+        double interval = an.edge[0] - an.edge[1];
+        stats_add(&an.interval, interval);
+        if(an.edges_valid >= 3) {
+            double jitter = interval - an.prev_interval;
+            stats_add(&an.jitter, jitter);
+            hist_add(&an.jitter_hist, jitter);
+        }
+        an.prev_interval = interval;
+
+        // the trigs of the last step now have their ideal times
+        for(int i=0; i<an.num_pending; ++i) {
+            PENDING_TRIG *p = &an.pending[i];
+            if(p->early) {
+                continue;
+            }
+            double error = p->time - (p->base + p->frac * interval);
+            stats_add(&an.track, error);
+            hist_add(&an.track_hist, error);
+        }
+    }
+    // trigs which fired just before this edge belong to the step it starts
+    int early = 0;
+    for(int i=0; i<an.num_pending; ++i) {
+        if(an.pending[i].early) {
+            an.pending[early] = an.pending[i];
+            an.pending[early].base = t;
+            an.pending[early].early = 0;
+            ++early;
+        }
+    }
+    an.num_pending = early;
+    if(an.step_known) {
+        an.step = (an.step + 1) % an.steps;
+    }
+    else {
+        // the firmware restarts the pattern when the external clock starts
+        an.step = 0;
+        an.step_known = 1;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// A trig on the external clock is timed from the edge at the start of its
+// step. The firmware holds at the end of a step until the next edge, so a
+// trig can also fire just after the edge ending its step. It runs on at the
+// rate of the last interval, so with jitter a trig at the start of a step 
+// can also fire a little before the edge starting it
+static void trig_external(double t, double pos) {
+    int step = (int)(pos * an.steps);
+    double frac = pos * an.steps - step;
+    if(!an.step_known) {
+        an.step = step;
+        an.step_known = 1;
+    }
+    int e;
+    if(step == an.step) {
+        e = 0;
+    }
+    else if(step == (an.step + an.steps - 1) % an.steps && an.edges_valid >= 2) {
+        e = 1;
+    }
+    else if(step == (an.step + 1) % an.steps && an.edges_valid >= 2 &&
+        t >= an.edge[0] + (1 - EARLY_STEPS) * (an.edge[0] - an.edge[1]))
+    {
+        e = -1;
+    }
+    else {
+        ++an.resyncs;
+        an.step = step;
+        e = 0;
+    }
+    if(e < 0) {
+        // against the edge the last interval gives for the start of its step
+        double interval = an.edge[0] - an.edge[1];
+        double late = t - (an.edge[0] + (1 + frac) * interval);
+        stats_add(&an.late, late);
+        hist_add(&an.late_hist, late);
+    }
+    else if(an.edges_valid >= e + 2) {
+        double late = t - (an.edge[e] + frac * (an.edge[e] - an.edge[e+1]));
+        stats_add(&an.late, late);
+        hist_add(&an.late_hist, late);
+    }
+    if(e > 0) {
+        double error = t - (an.edge[1] + frac * (an.edge[0] - an.edge[1]));
+        stats_add(&an.track, error);
+        hist_add(&an.track_hist, error);
+    }
+    else if(an.num_pending < MAX_TRIGS) {
+        PENDING_TRIG *p = &an.pending[an.num_pending++];
+        p->time = t;
+        p->base = an.edge[0];
+        p->frac = frac;
+        p->early = (e < 0);
+    }
+    else {
+        ++an.pending_lost;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// A trig on the internal clock is timed against a grid at the nominal tempo,
+// lined up with the first trig after a reset
+static void trig_internal(double t, double pos, int trig) {
+    if(an.anchored && trig <= an.last_trig) {
+        ++an.cycles;
+    }
+    double late = 0;
+    if(an.anchored) {
+        late = t - (an.cycle_start + (an.cycles + pos) * an.cycle_us);
+        if(fabs(late) > an.cycle_us / 4) {
+            ++an.resyncs;
+            an.anchored = 0;
+        }
+    }
+    if(!an.anchored) {
+        an.anchored = 1;
+        an.cycles = 0;
+        an.cycle_start = t - pos * an.cycle_us;
+        return;
+    }
+    stats_add(&an.late, late);
+    hist_add(&an.late_hist, late);
+    fit_add(&an.drift_fit, t, late);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static void process(const EVENT *ev) {
+    an.last_event = ev->time;
+    switch(ev->type) {
+        case TRACE_CLOCK:
+            clock_edge(ev->time);
+            break;
+        case TRACE_RESET:
+            if(ev->data) {
+                // the pattern restarts
+                an.anchored = 0;
+            }
+            break;
+        case TRACE_TRIG:
+            if(ev->data >= an.num_trigs) {
+                ++an.unknown_trigs;
+            }
+            else if(is_external()) {
+                trig_external(ev->time, an.pos[ev->data]);
+            }
+            else {
+                trig_internal(ev->time, an.pos[ev->data], ev->data);
+            }
+            an.last_trig = ev->data;
+            break;
+        case TRACE_DROPS:
+            an.dropped += ev->data;
+            break;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Events from the ISR are queued and can be sent after main loop events
+// which happened later, so events are held back in time order until they
+// are REORDER_US older than the newest one
+static void add_event(double time, int type, int data) {
+    if(type < 0 || type >= TRACE_TYPES) {
+        return;
+    }
+    ++an.count[type];
+    int i = an.reorder_count;
+    if(i == REORDER_SIZE) {
+        process(&an.reorder[0]);
+        memmove(&an.reorder[0], &an.reorder[1], (REORDER_SIZE-1) * sizeof(EVENT));
+        --i;
+    }
+    // an edge and a trig in the same ms are taken in that order, since the
+    // firmware fires the trig starting a step on the edge
+    while(i > 0 && (an.reorder[i-1].time > time || (an.reorder[i-1].time == time &&
+        type == TRACE_CLOCK && an.reorder[i-1].type == TRACE_TRIG)))
+    {
+        an.reorder[i] = an.reorder[i-1];
+        --i;
+    }
+    an.reorder[i].time = time;
+    an.reorder[i].type = type;
+    an.reorder[i].data = data;
+    ++an.reorder_count;
+
+    double newest = an.reorder[an.reorder_count-1].time;
+    int done = 0;
+    while(done < an.reorder_count && an.reorder[done].time < newest - REORDER_US) {
+        process(&an.reorder[done++]);
+    }
+    if(done) {
+        an.reorder_count -= done;
+        memmove(&an.reorder[0], &an.reorder[done], an.reorder_count * sizeof(EVENT));
+    }
+}
+
+static void flush_events() {
+    for(int i=0; i<an.reorder_count; ++i) {
+        process(&an.reorder[i]);
+    }
+    an.reorder_count = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static void frame(const unsigned char *f) {
+    int type = f[1];
+    int ms16 = f[2] | (f[3] << 8);
+    ++an.frames;
+    if(type == TRACE_DUMP) {
+        // black box entries have their own 13 bit timestamps
+        an.in_dump = f[5];
+        return;
+    }
+    if(an.in_dump) {
+        return;
+    }
+    if(!an.have_ms) {
+        an.ms = ms16;
+        an.have_ms = 1;
+    }
+    else {
+        an.ms += (int16_t)(ms16 - an.last_ms16);
+    }
+    an.last_ms16 = ms16;
+    add_event(an.ms * 1000.0 + f[4] * US_PER_SUB_MS, type, f[5]);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// find the frames in the byte stream, skipping anything else
+static void read_binary(FILE *in) {
+    static unsigned char buf[65536];
+    unsigned char win[FRAME_SIZE];
+    int len = 0;
+    size_t n;
+    while((n = fread(buf, 1, sizeof(buf), in)) > 0) {
+        for(size_t i=0; i<n; ++i) {
+            win[len++] = buf[i];
+            while(len) {
+                if(win[0] == FRAME_SYNC) {
+                    if(len < FRAME_SIZE) {
+                        break;
+                    }
+                    if((unsigned char)(win[1] + win[2] + win[3] + win[4] + win[5]) == win[6]) {
+                        frame(win);
+                        len = 0;
+                        break;
+                    }
+                }
+                ++an.bad_bytes;
+                memmove(win, win + 1, --len);
+            }
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static void read_text(FILE *in) {
+    char line[256];
+    char name[32];
+    while(fgets(line, sizeof(line), in)) {
+        double time;
+        int data = 0;
+        if(line[0] == '#' || line[strspn(line, " \t\r\n")] == 0) {
+            continue;
+        }
+        if(sscanf(line, "%lf %31s %d", &time, name, &data) < 2) {
+            ++an.bad_lines;
+            continue;
+        }
+        int type = 0;
+        while(type < TRACE_TYPES && strcmp(name, type_name[type])) {
+            ++type;
+        }
+        if(type == TRACE_TYPES) {
+            ++an.bad_lines;
+            continue;
+        }
+        add_event(time, type, data);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static void read_tbin(const char *path, long channel) {
+    TBIN_READER r;
+    if(!tbin_open(&r, path)) {
+        exit(1);
+    }
+    // trace types by the file's type numbers
+    int types[TBIN_MAX_TYPES];
+    for(int i=0; i<r.num_types; ++i) {
+        types[i] = 0;
+        while(types[i] < TRACE_TYPES && strcmp(r.type_names[i], type_name[types[i]])) {
+            ++types[i];
+        }
+    }
+    TBIN_EVENTS ev;
+    memset(&ev, 0, sizeof(ev));
+    for(int block = 0; block < r.num_blocks; ++block) {
+        if(!tbin_read_block(&r, block, &ev)) {
+            exit(1);
+        }
+        for(int i=0; i<ev.count; ++i) {
+            if(channel < 0 || ev.channel[i] == (unsigned)channel) {
+                // out and the other pins are not trace events
+                add_event(ev.time_us[i], types[ev.type[i]], ev.data[i]);
+            }
+        }
+    }
+    tbin_free_events(&ev);
+    tbin_close(&r);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static void print_stats(const char *name, const STATS *s) {
+    if(!s->count) {
+        printf("%-20s none\n", name);
+        return;
+    }
+    printf("%-20s n %llu  min %.1f  max %.1f  mean %.1f  sd %.1f us\n",
+        name, s->count, s->min, s->max, s->mean, stats_sd(s));
+}
+
+static void print_hist(const char *name, const HIST *h) {
+    unsigned long long total = h->under + h->over;
+    for(int i=0; i<HIST_BUCKETS; ++i) {
+        total += h->bucket[i];
+    }
+    if(!total) {
+        return;
+    }
+    printf("%s histogram (us):\n", name);
+    printf("  %8s < %8.0f  %llu\n", "", h->lo, h->under);
+    for(int i=0; i<HIST_BUCKETS; ++i) {
+        double lo = h->lo + i * h->width;
+        int bar = (int)(50 * h->bucket[i] / total);
+        printf("  %8.0f .. %8.0f  %-10llu %.*s\n", lo, lo + h->width,
+            h->bucket[i], bar, "##################################################");
+    }
+    printf("  %8s >= %7.0f  %llu\n", "", h->lo + HIST_BUCKETS * h->width, h->over);
+}
+
+static void report() {
+    printf("frames %llu, skipped bytes %llu, bad lines %llu, dropped events %llu\n",
+        an.frames, an.bad_bytes, an.bad_lines, an.dropped);
+    for(int i=0; i<TRACE_TYPES; ++i) {
+        printf("%s %llu%s", type_name[i], an.count[i],
+            (i < TRACE_TYPES-1) ? ", " : "\n");
+    }
+
+    printf("\nexternal clock\n");
+    print_stats("interval", &an.interval);
+    print_stats("jitter", &an.jitter);
+    print_hist("jitter", &an.jitter_hist);
+    if(an.edge_fit.n > 1) {
+        double period = fit_slope(&an.edge_fit);
+        printf("%-20s %.3f us (%.2f BPM per step)\n", "fitted period",
+            period, 60e6 / period);
+        if(an.nominal_period > 0) {
+            printf("%-20s %.1f ppm\n", "drift",
+                1e6 * (period - an.nominal_period) / an.nominal_period);
+            print_stats("offset from grid", &an.wander);
+        }
+    }
+    printf("%-20s %llu\n", "clock stops", an.clock_stops);
+
+    printf("\ntrigs\n");
+    print_stats("lateness", &an.late);
+    print_hist("lateness", &an.late_hist);
+    print_stats("tracking error", &an.track);
+    print_hist("tracking error", &an.track_hist);
+    if(an.drift_fit.n > 1) {
+        printf("%-20s %.1f ppm against %.1f BPM\n", "internal drift",
+            1e6 * fit_slope(&an.drift_fit), an.bpm);
+    }
+    printf("%-20s %llu\n", "resyncs", an.resyncs);
+    printf("%-20s %llu\n", "unknown trigs", an.unknown_trigs);
+    if(an.pending_lost) {
+        printf("%-20s %llu\n", "untracked trigs", an.pending_lost);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static void read_positions(const char *path) {
+    FILE *f = fopen(path, "r");
+    if(!f) {
+        perror(path);
+        exit(1);
+    }
+    an.num_trigs = 0;
+    while(an.num_trigs < MAX_TRIGS && fscanf(f, "%lf", &an.pos[an.num_trigs]) == 1) {
+        ++an.num_trigs;
+    }
+    fclose(f);
+}
+
+int main(int argc, char *argv[]) {
+    int steps = 16;
+    int bars = 1;
+    int text = 0;
+    int tbin = 0;
+    long channel = -1;
+    double width = 100;
+    const char *pos_file = NULL;
+    an.num_trigs = 16;
+    an.bpm = 120;
+    int opt;
+    while((opt = getopt(argc, argv, "s:b:n:p:r:P:w:tBk:")) != -1) {
+        switch(opt) {
+            case 's': steps = atoi(optarg); break;
+            case 'b': bars = atoi(optarg); break;
+            case 'n': an.num_trigs = atoi(optarg); break;
+            case 'p': pos_file = optarg; break;
+            case 'r': an.bpm = atof(optarg); break;
+            case 'P': an.nominal_period = atof(optarg); break;
+            case 'w': width = atof(optarg); break;
+            case 't': text = 1; break;
+            case 'B': tbin = 1; break;
+            case 'k': channel = atol(optarg); break;
+            default:
+                fprintf(stderr, "usage: trace_analyse [-s steps] [-b bars] "
+                    "[-n trigs] [-p positions] [-r bpm] [-P period_us] "
+                    "[-w bucket_us] [-t] [-B] [-k channel] [capture]\n");
+                return 1;
+        }
+    }
+    if(steps < 1 || bars < 1 || an.num_trigs < 1 || an.num_trigs > MAX_TRIGS ||
+        an.bpm <= 0 || width <= 0) {
+        fprintf(stderr, "trace_analyse: bad setting\n");
+        return 1;
+    }
+    an.steps = steps * bars;
+    an.cycle_us = an.steps * 60e6 / an.bpm;
+    if(pos_file) {
+        read_positions(pos_file);
+    }
+    else {
+        for(int i=0; i<an.num_trigs; ++i) {
+            an.pos[i] = (double)i / an.num_trigs;
+        }
+    }
+    an.jitter_hist.lo = -HIST_BUCKETS/2 * width;
+    an.jitter_hist.width = width;
+    an.late_hist.lo = -2 * width;
+    an.late_hist.width = width;
+    an.track_hist.lo = -HIST_BUCKETS/2 * width;
+    an.track_hist.width = width;
+
+    if(tbin) {
+        if(optind >= argc) {
+            fprintf(stderr, "trace_analyse: -B needs a file\n");
+            return 1;
+        }
+        read_tbin(argv[optind], channel);
+        flush_events();
+        report();
+        return 0;
+    }
+    FILE *in = stdin;
+    if(optind < argc) {
+        in = fopen(argv[optind], text ? "r" : "rb");
+        if(!in) {
+            perror(argv[optind]);
+            return 1;
+        }
+    }
+    if(text) {
+        read_text(in);
+    }
+    else {
+        read_binary(in);
+    }
+    flush_events();
+    report();
+    return 0;
+}
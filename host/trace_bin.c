@@ -0,0 +1,165 @@
+/*
+ Converts event traces from text to the binary format of tbin/tbin.h, and
+ prints or scans binary traces.
+
+    make trace_bin
+    trace_bin -c text binary        convert text to binary
+    trace_bin [options] binary      print as text
+    trace_bin -s [options] binary   count the events of each type
+
+ The text is an event per line, as written by ticker_sim (and read by
+ trace_analyse -t) or, with the channel, by rack_sim -o:
+
+    <time in us> <name> [data]
+    <time in us> <channel> <name> <data>
+
+ Blank lines and lines starting with # are skipped.
+
+ Options:
+    -f us       from this time, found with the index
+    -u us       up to (not including) this time
+    -k channel  only the events of this channel
+    -m          print the channel of each event, as rack_sim -o
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <limits.h>
+#include <unistd.h>
+#include <time.h>
+#include "tbin/tbin.h"
+
+////////////////////////////////////////////////////////////////////////////////
+static int convert(const char *in_path, const char *out_path) {
+    FILE *in = fopen(in_path, "r");
+    if(!in) {
+        perror(in_path);
+        return 1;
+    }
+    TBIN_WRITER *w = tbin_create(out_path);
+    if(!w) {
+        return 1;
+    }
+    char line[256];
+    int line_no = 0;
+    unsigned long long count = 0;
+    while(fgets(line, sizeof(line), in)) {
+        ++line_no;
+        char f[4][64];
+        if(line[0] == '#' || line[strspn(line, " \t\r\n")] == 0) {
+            continue;
+        }
+        int n = sscanf(line, "%63s %63s %63s %63s", f[0], f[1], f[2], f[3]);
+        long long time_us = atoll(f[0]);
+        unsigned channel = 0;
+        const char *name = f[1];
+        int data = (n > 2) ? atoi(f[2]) : 0;
+        if(n == 4 && isdigit((unsigned char)f[1][0])) {
+            channel = (unsigned)atol(f[1]);
+            name = f[2];
+            data = atoi(f[3]);
+        }
+        int type = (n >= 2) ? tbin_type(w, name) : -1;
+        if(type < 0) {
+            fprintf(stderr, "%s:%d: bad event\n", in_path, line_no);
+            tbin_finish(w);
+            return 1;
+        }
+        tbin_write(w, time_us, type, channel, data);
+        ++count;
+    }
+    fclose(in);
+    if(!tbin_finish(w)) {
+        return 1;
+    }
+    fprintf(stderr, "%llu events\n", count);
+    return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static int dump(const char *path, long long from, long long until, long channel,
+    int show_channel, int scan)
+{
+    TBIN_READER r;
+    if(!tbin_open(&r, path)) {
+        return 1;
+    }
+    TBIN_EVENTS ev;
+    memset(&ev, 0, sizeof(ev));
+    unsigned long long counts[TBIN_MAX_TYPES] = { 0 };
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    int block = tbin_find_block(&r, from);
+    for(; block < r.num_blocks && r.index[block].first_time < until; ++block) {
+        if(!tbin_read_block(&r, block, &ev)) {
+            tbin_close(&r);
+            return 1;
+        }
+        for(int i=0; i<ev.count; ++i) {
+            if(ev.time_us[i] < from || ev.time_us[i] >= until ||
+                (channel >= 0 && ev.channel[i] != (unsigned)channel)) {
+                continue;
+            }
+            if(scan) {
+                ++counts[ev.type[i]];
+            }
+            else if(show_channel) {
+                printf("%lld %u %s %d\n", ev.time_us[i], ev.channel[i],
+                    r.type_names[ev.type[i]], ev.data[i]);
+            }
+            else {
+                printf("%lld %s %d\n", ev.time_us[i], r.type_names[ev.type[i]], ev.data[i]);
+            }
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    if(scan) {
+        double secs = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) * 1e-9;
+        unsigned long long total = 0;
+        for(int i=0; i<r.num_types; ++i) {
+            printf("%-12s %llu\n", r.type_names[i], counts[i]);
+            total += counts[i];
+        }
+        printf("%llu of %llu events in %d blocks, %.1f bytes each, scanned in "
+            "%.3fs (%.0fM events/s)\n", total, r.num_events, r.num_blocks,
+            r.num_events ? (double)r.len / r.num_events : 0.0, secs,
+            secs > 0 ? total / secs * 1e-6 : 0.0);
+    }
+    tbin_free_events(&ev);
+    tbin_close(&r);
+    return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+int main(int argc, char *argv[]) {
+    int to_binary = 0;
+    int scan = 0;
+    int show_channel = 0;
+    long long from = LLONG_MIN;
+    long long until = LLONG_MAX;
+    long channel = -1;
+    int opt;
+    while((opt = getopt(argc, argv, "csf:u:k:m")) != -1) {
+        switch(opt) {
+            case 'c': to_binary = 1; break;
+            case 's': scan = 1; break;
+            case 'f': from = atoll(optarg); break;
+            case 'u': until = atoll(optarg); break;
+            case 'k': channel = atol(optarg); break;
+            case 'm': show_channel = 1; break;
+            default:
+                optind = argc + 1;
+                break;
+        }
+    }
+    if(to_binary ? (optind != argc - 2) : (optind != argc - 1)) {
+        fprintf(stderr, "usage: trace_bin -c text binary\n"
+            "       trace_bin [-s] [-f us] [-u us] [-k channel] [-m] binary\n");
+        return 1;
+    }
+    if(to_binary) {
+        return convert(argv[optind], argv[optind + 1]);
+    }
+    return dump(argv[optind], from, until, channel, show_channel, scan);
+}